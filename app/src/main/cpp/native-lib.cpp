@@ -3,6 +3,7 @@
 #include "android/bitmap.h"
 #include <opencv2/opencv.hpp>
 #include "scanner.h"
+#include "resultPacker.h"
 #include <android/log.h>
 
 // TODO: declare JNI function in a base class like CameraApplication
@@ -10,6 +11,75 @@
 #include <Eigen/Geometry>
 
 Scanner *sc;
+ResultPacker resultPacker;
+
+// The classes, methods and fields used by the JNI functions, looked up once in JNI_OnLoad
+struct JniCache
+{
+    jclass exceptionClass = NULL, bitmapClass = NULL, doubleArrayClass = NULL;
+    jclass mainGroundLocationClass = NULL, aircraftGroundLocationClass = NULL;
+    jmethodID createBitmap = NULL;
+    jobject argb8888 = NULL;
+    jfieldID mainElev = NULL, aircraftElev = NULL;
+} jni;
+
+static jclass globalClass(JNIEnv* env, const char* name)
+{
+    jclass local = env->FindClass(name);
+    if (local == NULL)
+    {
+        env->ExceptionClear();
+        return NULL;
+    }
+    jclass global = (jclass) env->NewGlobalRef(local);
+    env->DeleteLocalRef(local);
+    return global;
+}
+
+extern "C" JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void* reserved)
+{
+    JNIEnv* env;
+    if (vm->GetEnv((void**) &env, JNI_VERSION_1_6) != JNI_OK)
+        return JNI_ERR;
+
+    jni.exceptionClass = globalClass(env, "java/lang/Exception");
+    jni.bitmapClass = globalClass(env, "android/graphics/Bitmap");
+    jni.doubleArrayClass = globalClass(env, "[D");
+    jni.createBitmap = env->GetStaticMethodID(jni.bitmapClass, "createBitmap", "(IILandroid/graphics/Bitmap$Config;)Landroid/graphics/Bitmap;");
+
+    jclass configClass = env->FindClass("android/graphics/Bitmap$Config");
+    jfieldID argbField = env->GetStaticFieldID(configClass, "ARGB_8888", "Landroid/graphics/Bitmap$Config;");
+    jobject argb = env->GetStaticObjectField(configClass, argbField);
+    jni.argb8888 = env->NewGlobalRef(argb);
+    env->DeleteLocalRef(argb);
+    env->DeleteLocalRef(configClass);
+
+    jni.mainGroundLocationClass = globalClass(env, "com/example/android_scanner/MainActivity$GroundLocation");
+    if (jni.mainGroundLocationClass)
+        jni.mainElev = env->GetFieldID(jni.mainGroundLocationClass, "elev", "D");
+    jni.aircraftGroundLocationClass = globalClass(env, "com/example/android_scanner/AircraftActivity$GroundLocation");
+    if (jni.aircraftGroundLocationClass)
+        jni.aircraftElev = env->GetFieldID(jni.aircraftGroundLocationClass, "elev", "D");
+
+    return JNI_VERSION_1_6;
+}
+
+// Sets the elevation field of a GroundLocation instance of either activity
+void setElevation(JNIEnv* env, jobject outElev, double elev)
+{
+    jfieldID field;
+    if (jni.aircraftElev && env->IsInstanceOf(outElev, jni.aircraftGroundLocationClass))
+        field = jni.aircraftElev;
+    else if (jni.mainElev && env->IsInstanceOf(outElev, jni.mainGroundLocationClass))
+        field = jni.mainElev;
+    else
+    {
+        jclass clazz = env->GetObjectClass(outElev);
+        field = env->GetFieldID(clazz, "elev", "D");
+        env->DeleteLocalRef(clazz);
+    }
+    env->SetDoubleField(outElev, field, elev);
+}
 
 void bitmapToMat(JNIEnv *env, jobject bitmap, Mat& dst, jboolean needUnPremultiplyAlpha)
 {
@@ -41,13 +111,11 @@ void bitmapToMat(JNIEnv *env, jobject bitmap, Mat& dst, jboolean needUnPremultip
         return;
     } catch(const cv::Exception& e) {
         AndroidBitmap_unlockPixels(env, bitmap);
-        jclass je = env->FindClass("java/lang/Exception");
-        env->ThrowNew(je, e.what());
+        env->ThrowNew(jni.exceptionClass, e.what());
         return;
     } catch (...) {
         AndroidBitmap_unlockPixels(env, bitmap);
-        jclass je = env->FindClass("java/lang/Exception");
-        env->ThrowNew(je, "Unknown exception in JNI code {nBitmapToMat}");
+        env->ThrowNew(jni.exceptionClass, "Unknown exception in JNI code {nBitmapToMat}");
         return;
     }
 }
@@ -96,35 +164,95 @@ void matToBitmap(JNIEnv* env, Mat src, jobject bitmap, jboolean needPremultiplyA
         return;
     } catch(const cv::Exception& e) {
         AndroidBitmap_unlockPixels(env, bitmap);
-        jclass je = env->FindClass("java/lang/Exception");
-        env->ThrowNew(je, e.what());
+        env->ThrowNew(jni.exceptionClass, e.what());
         return;
     } catch (...) {
         AndroidBitmap_unlockPixels(env, bitmap);
-        jclass je = env->FindClass("java/lang/Exception");
-        env->ThrowNew(je, "Unknown exception in JNI code {nMatToBitmap}");
+        env->ThrowNew(jni.exceptionClass, "Unknown exception in JNI code {nMatToBitmap}");
         return;
     }
 }
 
+// Converts a BGR image straight into an RGBA bitmap of the same size, in one pass and without modifying the
+// image, which may be the camera frame itself
+void bgrToBitmap(JNIEnv* env, const Mat &src, jobject bitmap)
+{
+    AndroidBitmapInfo  info;
+    void*              pixels = 0;
+
+    if (src.type() != CV_8UC3 || AndroidBitmap_getInfo(env, bitmap, &info) < 0 || info.format != ANDROID_BITMAP_FORMAT_RGBA_8888 ||
+        info.width != (uint32_t) src.cols || info.height != (uint32_t) src.rows)
+    {
+        Mat rgb;
+        if (src.type() == CV_8UC3)
+            cvtColor(src, rgb, COLOR_BGR2RGB);
+        else
+            rgb = src;
+        matToBitmap(env, rgb, bitmap, false);
+        return;
+    }
+
+    if (AndroidBitmap_lockPixels(env, bitmap, &pixels) < 0 || !pixels)
+    {
+        env->ThrowNew(jni.exceptionClass, "Cannot lock the bitmap pixels {bgrToBitmap}");
+        return;
+    }
+    try {
+        Mat dst(info.height, info.width, CV_8UC4, pixels, info.stride);
+        cvtColor(src, dst, COLOR_BGR2RGBA);
+    } catch(const cv::Exception& e) {
+        AndroidBitmap_unlockPixels(env, bitmap);
+        env->ThrowNew(jni.exceptionClass, e.what());
+        return;
+    }
+    AndroidBitmap_unlockPixels(env, bitmap);
+}
+
+// Passes a bitmap to the logger as the camera image. The locked pixels are wrapped, and copied once by the
+// logger; the colour conversions are left to the modules which need them
+void setBitmapImage(JNIEnv* env, jobject bitmap, double time)
+{
+    AndroidBitmapInfo  info;
+    void*              pixels = 0;
+
+    if (AndroidBitmap_getInfo(env, bitmap, &info) < 0)
+    {
+        env->ThrowNew(jni.exceptionClass, "Cannot read the bitmap info {setBitmapImage}");
+        return;
+    }
+    if (info.format != ANDROID_BITMAP_FORMAT_RGBA_8888)
+    {
+        Mat img;
+        bitmapToMat(env, bitmap, img, false);
+        sc->logger->setImage(Frame(img, FRAME_RGBA), time);
+        return;
+    }
+
+    if (AndroidBitmap_lockPixels(env, bitmap, &pixels) < 0 || !pixels)
+    {
+        env->ThrowNew(jni.exceptionClass, "Cannot lock the bitmap pixels {setBitmapImage}");
+        return;
+    }
+    sc->logger->setImage(Frame(Mat(info.height, info.width, CV_8UC4, pixels, info.stride), FRAME_RGBA), time);
+    AndroidBitmap_unlockPixels(env, bitmap);
+}
+
+// Checks that a direct buffer holds an image plane of the given geometry
+bool planeFits(JNIEnv* env, jobject buffer, int rows, int rowStride, int rowBytes)
+{
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    return (capacity >= 0 && rows > 0 && capacity >= (jlong) (rows - 1) * rowStride + rowBytes);
+}
+
 void createBitmap(JNIEnv* env, int w, int h, jobject &java_bitmap)
 {
-    jclass java_bitmap_class = (jclass)env->FindClass("android/graphics/Bitmap");
-    jmethodID mid = env->GetStaticMethodID(java_bitmap_class, "createBitmap", "(IILandroid/graphics/Bitmap$Config;)Landroid/graphics/Bitmap;");
-    const wchar_t config_name[] = L"ARGB_8888";
-    jstring j_config_name = env->NewString((const jchar*)config_name, wcslen(config_name));
-    jclass bcfg_class = env->FindClass("android/graphics/Bitmap$Config");
-    jobject java_bitmap_config = env->CallStaticObjectMethod(bcfg_class, env->GetStaticMethodID(bcfg_class, "valueOf", "(Ljava/lang/String;)Landroid/graphics/Bitmap$Config;"), env->NewStringUTF("ARGB_8888"));
-    //    jobject java_bitmap_config = env->CallStaticObjectMethod(bcfg_class, midValueOf, env->NewStringUTF("ARGB_8888"));
-    java_bitmap = env->CallStaticObjectMethod(java_bitmap_class, mid, w, h, java_bitmap_config);
+    java_bitmap = env->CallStaticObjectMethod(jni.bitmapClass, jni.createBitmap, w, h, jni.argb8888);
 }
 
 jobjectArray putIntoArray(JNIEnv* env, std::vector<Object> objects)
 {
-    const int colsNum = 8;
-    jclass cls = env->FindClass("[D");
-    jdoubleArray iniVal = env->NewDoubleArray(colsNum);
-    jobjectArray outer = env->NewObjectArray(objects.size(), cls, iniVal);
+    const int colsNum = 9;
+    jobjectArray outer = env->NewObjectArray(objects.size(), jni.doubleArrayClass, NULL);
 
     for (int i = 0; i < objects.size(); i++)
     {
@@ -132,7 +260,7 @@ jobjectArray putIntoArray(JNIEnv* env, std::vector<Object> objects)
 
         Object det = objects.at(i);
         int type = det.type;
-        double posa[colsNum] = {det.location.lat, det.location.lng, det.location.alt, (double) type, det.distance, (double) det.action, (double) det.lastIdx, det.direction};
+        double posa[colsNum] = {det.location.lat, det.location.lng, det.location.alt, (double) type, det.distance, (double) det.action, (double) det.lastIdx, det.direction, (double) det.id};
 
         env->SetDoubleArrayRegion(inner, 0, colsNum, posa);
         env->SetObjectArrayElement(outer, i, inner);
@@ -143,8 +271,7 @@ jobjectArray putIntoArray(JNIEnv* env, std::vector<Object> objects)
 
 void putIntoBitmapArray(JNIEnv* env, std::vector<Object> &fov_poses, jobjectArray &ret)
 {
-    jclass cls = env->FindClass("android/graphics/Bitmap");
-    ret = env->NewObjectArray( fov_poses.size(), cls, NULL);
+    ret = env->NewObjectArray( fov_poses.size(), jni.bitmapClass, NULL);
 
     for (int i=0; i<fov_poses.size(); i++){
         jobject bitmap;
@@ -152,6 +279,7 @@ void putIntoBitmapArray(JNIEnv* env, std::vector<Object> &fov_poses, jobjectArra
         matToBitmap(env, fov_poses.at(i).picture, bitmap, false);
 
         env->SetObjectArrayElement(ret, i, bitmap);
+        env->DeleteLocalRef(bitmap);
     }
 
 }
@@ -188,25 +316,39 @@ Java_com_example_android_1scanner_MainActivity_scan(JNIEnv* env, jobject p_this,
 
     Mat det, movings;
     std::vector<Object> objects;
-    bitmapToMat(env, detections, det, false);
-    cvtColor(det, det, COLOR_RGBA2BGR);
 
-    if (!sc->scan(objects, det, movings, 0, true, true))
+    if (!sc->scan(objects, det, movings, 0, true))
         {
+        bitmapToMat(env, detections, det, false);
+        cvtColor(det, det, COLOR_RGBA2BGR);
         putText(det, "SENSOR DATA NOT PROVIDED", cv::Point(50,200),cv::FONT_HERSHEY_DUPLEX,4,cv::Scalar(0,0,255),3,false);
     }
 
-    cvtColor(det, det, COLOR_BGR2RGB);
-    matToBitmap(env, det, detections, false);
+    bgrToBitmap(env, det, detections);
 }
 
 extern "C" JNIEXPORT void JNICALL
 Java_com_example_android_1scanner_MainActivity_setImage(JNIEnv* env, jobject p_this, jobject bitmap, jdouble time)
 {
-    Mat img;
-    bitmapToMat(env, bitmap, img, false);
+    setBitmapImage(env, bitmap, time);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_android_1scanner_MainActivity_setImageNv21(JNIEnv* env, jobject p_this, jbyteArray data, jint width, jint height, jdouble time)
+{
+    if (width <= 0 || height <= 0 || env->GetArrayLength(data) < (jlong) width * height * 3 / 2)
+    {
+        env->ThrowNew(jni.exceptionClass, "The NV21 buffer is smaller than the image {setImageNv21}");
+        return;
+    }
+
+    // The frame is detached before the array is released, so the garbage collector is not held by the logger
+    void *bytes = env->GetPrimitiveArrayCritical(data, NULL);
+    Frame frame = Frame::fromNv21((const uint8_t *) bytes, width, height);
+    frame.detach();
+    env->ReleasePrimitiveArrayCritical(data, bytes, JNI_ABORT);
 
-    sc->logger->setImage(img, time);
+    sc->logger->setImage(frame, time);
 }
 
 extern "C" JNIEXPORT void JNICALL
@@ -248,22 +390,16 @@ Java_com_example_android_1scanner_MainActivity_readLog(JNIEnv* env, jobject p_th
         return NULL;
 
     Mat movings;
-    Mat dst = imgSt.image.clone();
+    Mat dst = imgSt.frame.bgr().clone();
 
     if ( !sc->scan(imgSt, dst, movings, objects, stamp) )
         return NULL;
 
     yaw = imgSt.azimuth * 180 / PI;
 
-    Mat src = imgSt.image.clone();
-    cvtColor(src, src, COLOR_BGR2RGB);
-    matToBitmap(env, src, bitmap, false);
-
-    cvtColor(dst, dst, COLOR_BGR2RGB);
-    matToBitmap(env, dst, processedBitmap, false);
-
-    cvtColor(movings, movings, COLOR_BGR2RGB);
-    matToBitmap(env, movings, movingsBitmap, false);
+    bgrToBitmap(env, imgSt.frame.bgr(), bitmap);
+    bgrToBitmap(env, dst, processedBitmap);
+    bgrToBitmap(env, movings, movingsBitmap);
 
     //// Note: calcFov sets fov for an image after scan while scan (motionDetector) uses it for current
     //// image. But it's not important because of the assumption of fixed camera in motion detection mode
@@ -273,9 +409,7 @@ Java_com_example_android_1scanner_MainActivity_readLog(JNIEnv* env, jobject p_th
         fov_poses_array = putIntoArray(env, fov_objects);
     }
 
-    jclass clazz = env->GetObjectClass(outElev);
-    jfieldID param1Field = env->GetFieldID(clazz, "elev", "D");
-    env->SetDoubleField(outElev, param1Field, sc->elev(imuSt));
+    setElevation(env, outElev, sc->elev(imuSt));
 
     return fov_poses_array;
 }
@@ -289,8 +423,7 @@ extern "C" JNIEXPORT jobjectArray JNICALL
 
     if (fov_objects.size()==0) return NULL;
 
-    jclass cls = env->FindClass("android/graphics/Bitmap");
-    jobjectArray ret = env->NewObjectArray( fov_objects.size(), cls, NULL);
+    jobjectArray ret = env->NewObjectArray( fov_objects.size(), jni.bitmapClass, NULL);
 //    __android_log_print(ANDROID_LOG_VERBOSE, "outer", "1543");
 
     for (int i=0; i<fov_objects.size(); i++){
@@ -303,8 +436,7 @@ extern "C" JNIEXPORT jobjectArray JNICALL
 //            __android_log_print(ANDROID_LOG_VERBOSE, "outer", "1545");
 
             createBitmap(env, fov_objects.at(i).picture.cols, fov_objects.at(i).picture.rows, bitmap);
-            cv::cvtColor(fov_objects.at(i).picture, fov_objects.at(i).picture, COLOR_RGB2BGR);
-            matToBitmap(env, fov_objects.at(i).picture, bitmap, false);
+            bgrToBitmap(env, fov_objects.at(i).picture, bitmap);
 
 //            __android_log_print(ANDROID_LOG_VERBOSE, "outer", "1546");
 
@@ -321,6 +453,7 @@ extern "C" JNIEXPORT jobjectArray JNICALL
 //        __android_log_print(ANDROID_LOG_VERBOSE, "outer", "1549");
 
         env->SetObjectArrayElement(ret, i, bitmap);
+        env->DeleteLocalRef(bitmap);
 //        __android_log_print(ANDROID_LOG_VERBOSE, "outer", "1550");
 
     }
@@ -347,11 +480,31 @@ Java_com_example_android_1scanner_AircraftActivity_createScanner(JNIEnv *env, jo
 extern "C" JNIEXPORT void JNICALL
 Java_com_example_android_1scanner_AircraftActivity_setImage(JNIEnv* env, jobject p_this, jobject bitmap, jdouble time)
 {
-    Mat img;
-    bitmapToMat(env, bitmap, img, false);
-    cvtColor(img, img, COLOR_RGB2BGR);
+    setBitmapImage(env, bitmap, time);
+}
 
-    sc->logger->setImage(img, time);
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_android_1scanner_AircraftActivity_setImageYuv(JNIEnv* env, jobject p_this, jobject y, jobject u, jobject v,
+                                                               jint width, jint height, jint yRowStride, jint uvRowStride,
+                                                               jint uvPixelStride, jdouble time)
+{
+    if (!planeFits(env, y, height, yRowStride, width) ||
+        !planeFits(env, u, height / 2, uvRowStride, (width / 2 - 1) * uvPixelStride + 1) ||
+        !planeFits(env, v, height / 2, uvRowStride, (width / 2 - 1) * uvPixelStride + 1))
+    {
+        env->ThrowNew(jni.exceptionClass, "The YUV planes must be direct buffers holding the image {setImageYuv}");
+        return;
+    }
+
+    Frame frame = Frame::fromYuv420(width, height, (const uint8_t *) env->GetDirectBufferAddress(y), yRowStride,
+                                    (const uint8_t *) env->GetDirectBufferAddress(u),
+                                    (const uint8_t *) env->GetDirectBufferAddress(v), uvRowStride, uvPixelStride);
+    if (frame.empty())
+    {
+        env->ThrowNew(jni.exceptionClass, "Invalid YUV_420_888 geometry {setImageYuv}");
+        return;
+    }
+    sc->logger->setImage(frame, time);
 }
 
 extern "C" JNIEXPORT void JNICALL
@@ -366,6 +519,104 @@ Java_com_example_android_1scanner_AircraftActivity_setUserLocation(JNIEnv* env,
     sc->setReferenceLoc(lat, lng, true);
 }
 
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_android_1scanner_AircraftActivity_setAutoMotionGate(JNIEnv* env, jobject p_this, jboolean enable)
+{
+    sc->setAutoMotionGate(enable);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_android_1scanner_AircraftActivity_setDetectionVelocity(JNIEnv* env, jobject p_this, jboolean enable)
+{
+    sc->setDetectionVelocity(enable);
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_example_android_1scanner_AircraftActivity_isStationary(JNIEnv* env, jobject p_this)
+{
+    return sc->isStationary();
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_android_1scanner_AircraftActivity_setFovPolicy(JNIEnv* env, jobject p_this, jdouble shift, jdouble angle, jdouble minInterval, jdouble keepalive)
+{
+    sc->setFovPolicy(shift, angle, minInterval, keepalive);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_example_android_1scanner_AircraftActivity_setMissionBoundary(JNIEnv* env, jobject p_this, jdoubleArray lats, jdoubleArray lngs)
+{
+    jsize n = std::min(env->GetArrayLength(lats), env->GetArrayLength(lngs));
+    std::vector<Location> boundary(n);
+    jdouble *la = env->GetDoubleArrayElements(lats, NULL), *ln = env->GetDoubleArrayElements(lngs, NULL);
+    for (jsize k = 0; k < n; k++)
+    {
+        boundary[k].lat = la[k];
+        boundary[k].lng = ln[k];
+    }
+    env->ReleaseDoubleArrayElements(lats, la, JNI_ABORT);
+    env->ReleaseDoubleArrayElements(lngs, ln, JNI_ABORT);
+    sc->setMissionBoundary(boundary);
+}
+
+// Returns the swept area (m^2), the mission area (m^2), the mission coverage (%), then the revisit histogram
+extern "C" JNIEXPORT jdoubleArray JNICALL
+Java_com_example_android_1scanner_AircraftActivity_getCoverageStats(JNIEnv* env, jobject p_this)
+{
+    SweeperGeometry::CoverageStats stats;
+    sc->getCoverageStats(stats);
+
+    std::vector<jdouble> values{stats.sweptArea, stats.missionArea, stats.missionCoverage};
+    for (size_t count : stats.visitHistogram)
+        values.push_back((jdouble) count);
+
+    jdoubleArray result = env->NewDoubleArray((jsize) values.size());
+    env->SetDoubleArrayRegion(result, 0, (jsize) values.size(), values.data());
+    return result;
+}
+
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_example_android_1scanner_AircraftActivity_getCoverageGaps(JNIEnv* env, jobject p_this)
+{
+    std::vector<Object> gaps;
+    sc->getCoverageGaps(gaps);
+    return putIntoArray(env, gaps);
+}
+
+// Returns the latitude and longitude of the unswept mission point nearest to the given location, or null
+extern "C" JNIEXPORT jdoubleArray JNICALL
+Java_com_example_android_1scanner_AircraftActivity_getNearestGap(JNIEnv* env, jobject p_this, jdouble lat, jdouble lng)
+{
+    Location from, gap;
+    from.lat = lat;
+    from.lng = lng;
+    if (!sc->nearestGap(from, gap))
+        return NULL;
+
+    jdouble values[2] = {gap.lat, gap.lng};
+    jdoubleArray result = env->NewDoubleArray(2);
+    env->SetDoubleArrayRegion(result, 0, 2, values);
+    return result;
+}
+
+// Returns the visit count and the time in seconds since last seen (-1 if never) of the cell of the given location, or null
+extern "C" JNIEXPORT jdoubleArray JNICALL
+Java_com_example_android_1scanner_AircraftActivity_getCellRevisit(JNIEnv* env, jobject p_this, jdouble lat, jdouble lng, jdouble time)
+{
+    Location at;
+    at.lat = lat;
+    at.lng = lng;
+    int visits;
+    double sinceSeen;
+    if (!sc->getCellRevisit(at, time, visits, sinceSeen))
+        return NULL;
+
+    jdouble values[2] = {(jdouble) visits, sinceSeen};
+    jdoubleArray result = env->NewDoubleArray(2);
+    env->SetDoubleArrayRegion(result, 0, 2, values);
+    return result;
+}
+
 extern "C" JNIEXPORT jobjectArray JNICALL
 Java_com_example_android_1scanner_AircraftActivity_setOrientation(JNIEnv* env, jobject p_this, jdouble roll, jdouble pitch, jdouble azimuth, jdouble time, jobject outElev)
 {
@@ -373,9 +624,7 @@ Java_com_example_android_1scanner_AircraftActivity_setOrientation(JNIEnv* env, j
     std::vector<Object> fov_objects1;
     jobjectArray fov_poses_array = NULL;
 
-    jclass clazz = env->GetObjectClass(outElev);
-    jfieldID param1Field = env->GetFieldID(clazz, "elev", "D");
-    env->SetDoubleField(outElev, param1Field, sc->elev());
+    setElevation(env, outElev, sc->elev());
 
     //// fov_objects includes both fov points and swept area
     if (sc->logger->setOrientation(roll, pitch, azimuth, time) && sc->calcFov(fov_objects1))
@@ -390,38 +639,100 @@ Java_com_example_android_1scanner_AircraftActivity_setOrientation(JNIEnv* env, j
 
 }
 
+OutlineDelta outlineDelta;
+std::vector<uint8_t> deltaBuffer;
+
+// Like setOrientation, but returns the FOV and the swept area changes since the acknowledged version as one
+// buffer (see outlineDelta.h), or null if nothing changed
+extern "C" JNIEXPORT jbyteArray JNICALL
+Java_com_example_android_1scanner_AircraftActivity_setOrientationDelta(JNIEnv* env, jobject p_this, jdouble roll, jdouble pitch, jdouble azimuth, jdouble time, jobject outElev, jint ackedVersion)
+{
+    std::vector<Object> fov_objects1;
+
+    setElevation(env, outElev, sc->elev());
+
+    if (!sc->logger->setOrientation(roll, pitch, azimuth, time) || !sc->calcFov(fov_objects1))
+        return NULL;
+
+    outlineDelta.encode(fov_objects1, (uint32_t) ackedVersion, deltaBuffer);
+    jbyteArray result = env->NewByteArray((jsize) deltaBuffer.size());
+    env->SetByteArrayRegion(result, 0, (jsize) deltaBuffer.size(), (const jbyte *) deltaBuffer.data());
+    return result;
+}
+
 std::vector<Object> objects;
 
-extern "C" JNIEXPORT jobjectArray JNICALL
-Java_com_example_android_1scanner_AircraftActivity_scan(JNIEnv* env, jobject p_this, jobject detections, jobject movings_img, jint detMode, jboolean isFix)
+// Scans the camera image into the global objects list and draws the results on the two bitmaps
+bool scanFrame(JNIEnv* env, jobject detections, jobject movings_img, jint detMode, jboolean isFix)
 {
-//    std::vector<Object> objects;
     objects.clear();
 
+    // The bitmaps are only written; they are left as they are if no data is provided
     Mat det, movings;
-    bitmapToMat(env, detections, det, false);
-    cvtColor(det, det, COLOR_RGBA2BGR);
-
-    bitmapToMat(env, movings_img, movings, false);
-    cvtColor(movings, movings, COLOR_RGBA2BGR);
-
-    if (!sc->scan(objects, det, movings, (int) detMode, false, isFix))
+    if (!sc->scan(objects, det, movings, (int) detMode, isFix))
     {
-        putText(det, "SENSOR DATA NOT PROVIDED", cv::Point(50,200),cv::FONT_HERSHEY_DUPLEX,4,cv::Scalar(0,0,255),3,false);
-        putText(movings, "SENSOR DATA NOT PROVIDED", cv::Point(50,200),cv::FONT_HERSHEY_DUPLEX,4,cv::Scalar(0,0,255),3,false);
 //        __android_log_print(ANDROID_LOG_VERBOSE, "outer", "1543");
-        return NULL;
+        return false;
     }
 
-    cvtColor(det, det, COLOR_BGR2RGB);
-    matToBitmap(env, det, detections, false);
+    bgrToBitmap(env, det, detections);
+    bgrToBitmap(env, movings, movings_img);
 
-    cvtColor(movings, movings, COLOR_BGR2RGB);
-    matToBitmap(env, movings, movings_img, false);
+    return true;
+}
+
+extern "C" JNIEXPORT jobjectArray JNICALL
+Java_com_example_android_1scanner_AircraftActivity_scan(JNIEnv* env, jobject p_this, jobject detections, jobject movings_img, jint detMode, jboolean isFix)
+{
+    if (!scanFrame(env, detections, movings_img, detMode, isFix))
+        return NULL;
 
     return putIntoArray(env, objects);
 }
 
+// Like scan, but keeps the results for packResults and returns their number, or -1 if the sensor data is missing
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_android_1scanner_AircraftActivity_scanResults(JNIEnv* env, jobject p_this, jobject detections, jobject movings_img, jint detMode, jboolean isFix)
+{
+    if (!scanFrame(env, detections, movings_img, detMode, isFix))
+        return -1;
+
+    return (jint) objects.size();
+}
+
+// Writes the results of the last scan into a direct ByteBuffer (see resultPacker.h for the layout), and their
+// pictures into the atlas if requested; returns the number of records written
+extern "C" JNIEXPORT jint JNICALL
+Java_com_example_android_1scanner_AircraftActivity_packResults(JNIEnv* env, jobject p_this, jobject buffer, jboolean withAtlas)
+{
+    uint8_t *data = (uint8_t *) env->GetDirectBufferAddress(buffer);
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (data == NULL || capacity <= 0)
+        return 0;
+
+    return (jint) resultPacker.pack(objects, data, (size_t) capacity, withAtlas);
+}
+
+// Copies the pictures atlas of the last packResults into the top left corner of an RGBA bitmap, which must be
+// at least as large as the atlas size given in the buffer header; returns false otherwise
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_example_android_1scanner_AircraftActivity_fillImageAtlas(JNIEnv* env, jobject p_this, jobject bitmap)
+{
+    const cv::Mat &atlas = resultPacker.atlas();
+    AndroidBitmapInfo info;
+    void *pixels = 0;
+    if (atlas.empty() || AndroidBitmap_getInfo(env, bitmap, &info) < 0 || info.format != ANDROID_BITMAP_FORMAT_RGBA_8888 ||
+        info.width < (uint32_t) atlas.cols || info.height < (uint32_t) atlas.rows)
+        return JNI_FALSE;
+    if (AndroidBitmap_lockPixels(env, bitmap, &pixels) < 0 || !pixels)
+        return JNI_FALSE;
+
+    Mat target(info.height, info.width, CV_8UC4, pixels, info.stride);
+    atlas.copyTo(target(cv::Rect(0, 0, atlas.cols, atlas.rows)));
+    AndroidBitmap_unlockPixels(env, bitmap);
+    return JNI_TRUE;
+}
+
 extern "C" JNIEXPORT jobjectArray JNICALL
 Java_com_example_android_1scanner_AircraftActivity_getImages(JNIEnv* env, jobject p_this)
 {
@@ -430,22 +741,21 @@ Java_com_example_android_1scanner_AircraftActivity_getImages(JNIEnv* env, jobjec
 
     if (objects.size()==0) return NULL;
 
-    jclass cls = env->FindClass("android/graphics/Bitmap");
-    jobjectArray ret = env->NewObjectArray( objects.size(), cls, NULL);
+    jobjectArray ret = env->NewObjectArray( objects.size(), jni.bitmapClass, NULL);
 
     for (int i=0; i<objects.size(); i++){
         jobject bitmap;
 
         if (!objects.at(i).picture.empty()){
         createBitmap(env, objects.at(i).picture.cols, objects.at(i).picture.rows, bitmap);
-        cv::cvtColor(objects.at(i).picture, objects.at(i).picture, COLOR_RGB2BGR);
-        matToBitmap(env, objects.at(i).picture, bitmap, false);
+        bgrToBitmap(env, objects.at(i).picture, bitmap);
         } else {
             createBitmap(env, 10, 10, bitmap);
             matToBitmap(env, cv::Mat::zeros(10, 10, CV_8UC3), bitmap, false);
         }
 
         env->SetObjectArrayElement(ret, i, bitmap);
+        env->DeleteLocalRef(bitmap);
     }
 
     return ret;
@@ -23,6 +23,8 @@ import android.graphics.SurfaceTexture;
 import android.location.Location;
 import android.location.LocationListener;
 import android.location.LocationManager;
+import android.media.MediaCodecInfo;
+import android.media.MediaFormat;
 import android.os.Build;
 import android.os.Bundle;
 import android.util.Log;
@@ -30,6 +32,7 @@ import android.view.TextureView;
 import android.view.View;
 import android.view.ViewGroup;
 import android.view.WindowManager;
+import android.widget.CompoundButton;
 import android.widget.FrameLayout;
 import android.widget.ImageView;
 import android.widget.RadioGroup;
@@ -48,9 +51,14 @@ import com.google.android.gms.maps.model.MarkerOptions;
 import com.google.android.gms.maps.model.Polygon;
 import com.google.android.gms.maps.model.PolygonOptions;
 
+import java.nio.ByteBuffer;
 import java.time.Instant;
+import java.util.ArrayDeque;
 import java.util.ArrayList;
+import java.util.HashMap;
 import java.util.List;
+import java.util.Map;
+import java.util.Set;
 
 import dji.common.airlink.SignalQualityCallback;
 import dji.common.battery.BatteryState;
@@ -92,7 +100,15 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
 
     private ActivityAircraftBinding binding;
     Polygon fov_polygon = null;
-    Polygon sweep_polygon = null;
+    Map<Integer, Polygon> sweep_polygons = new HashMap<Integer, Polygon>();
+    SweptAreaState sweptState = new SweptAreaState();
+    List<LatLng> missionVertices = new ArrayList<LatLng>();
+    Polygon mission_polygon = null;
+    List<Polygon> gap_polygons = new ArrayList<Polygon>();
+    Marker gap_marker = null;
+    volatile boolean missionSet = false;
+    volatile double aircraftLat = 0.0, aircraftLng = 0.0;
+    float gapUpdateInterval = 2.0f;
     private GoogleMap googleMap = null;
 
 //    List<Marker> AllMarkers = new ArrayList<Marker>();
@@ -114,6 +130,10 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
     private static final String TAG = AircraftActivity.class.getName();
     protected VideoFeeder.VideoDataListener mReceivedVideoDataListener = null;
     protected DJICodecManager mCodecManager = null;
+    protected DJICodecManager.YuvDataCallback yuvDataCallback = null;
+    private volatile boolean yuvFrames = false;
+    private ByteBuffer yuvBuffer = null;
+    private Bitmap yuvBitmap = null;
     protected DJICodecManager.OnGetBitmapListener bitmapListener = null;
 
     private double aircraftYaw = 0.0;
@@ -136,7 +156,7 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
     double img_time = 0.0;
     double motionDetectionDelay = 1.0;
 
-    Bitmap[] objImages = null;
+    ArrayDeque<ScanResults> freeResults = new ArrayDeque<ScanResults>();
 
     ViewGroup.LayoutParams previewLayoutParams = null;
     boolean fullScreen = false;
@@ -167,6 +187,9 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
         dstBitmap = srcBitmap.copy(srcBitmap.getConfig(), true);
 //        Log.v(TAG, "-------///4");
         createScanner(getIntent().getStringExtra("Assets"), getIntent().getStringExtra("Log"), getIntent().getIntExtra("Log Mode", 2), (float) 66.0, getIntent().getIntExtra("Algorithm", 0));
+        // The FOV and swept area are sent as deltas (setOrientationDelta), so they may be recalculated as soon as
+        // the footprint moves 2 m or turns 2 degrees, up to 10 times per second
+        setFovPolicy(2.0, 2.0, 0.1, 10.0);
 
         // Example of a call to a native method
         ImageView iv = binding.imageView2;
@@ -203,6 +226,7 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
         locationManager.requestLocationUpdates(LocationManager.GPS_PROVIDER, 5000, 10, locationListener);
 
         changeMarkers();
+        updateGaps();
     }
 
     @Override
@@ -210,6 +234,7 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
         Log.e(TAG, "onSurfaceTextureAvailable");
         if (mCodecManager == null) {
             mCodecManager = new DJICodecManager(this, surfaceTexture, i, i1);
+            enableYuvFrames(yuvFrames);
         }
     }
 
@@ -240,7 +265,8 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
             }
         });
 
-        if (!isProcessing) {
+        // The decoded YUV frames feed the scanner instead, if enabled; see onYuvFrame()
+        if (!isProcessing && !yuvFrames) {
             Thread thread = new Thread() {
                 @Override
                 public void run() {
@@ -265,6 +291,92 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
 
     }
 
+    // Turns the YUV output of the video decoder on or off; when on, its frames are scanned instead of the preview
+    // bitmaps
+    private void enableYuvFrames(boolean enable) {
+        yuvFrames = enable;
+        if (mCodecManager == null)
+            return;
+
+        if (yuvDataCallback == null)
+            yuvDataCallback = new DJICodecManager.YuvDataCallback() {
+                @Override
+                public void onYuvDataReceived(MediaFormat format, ByteBuffer yuvFrame, int dataSize, int width, int height) {
+                    onYuvFrame(format, yuvFrame, dataSize, width, height);
+                }
+            };
+        mCodecManager.enabledYuvData(enable);
+        mCodecManager.setYuvDataCallback(enable ? yuvDataCallback : null);
+    }
+
+    // Passes a decoded frame to the scanner as YUV planes, without any colour conversion, and scans it. The decoder
+    // reuses its output buffer once the callback returns, while the frame is scanned on another thread, so this is
+    // the one place where the samples must be copied: the scanner detaches them, as they are, before setImageYuv
+    // returns, and the scan works on its own copy
+    private void onYuvFrame(MediaFormat format, ByteBuffer yuvFrame, int dataSize, int width, int height) {
+        if (isProcessing)
+            return;
+
+        // The decoder may pad the rows and the luma plane; the chroma samples follow the padded luma plane
+        int stride = width, sliceHeight = height;
+        if (format != null && format.containsKey(MediaFormat.KEY_STRIDE))
+            stride = Math.max(width, format.getInteger(MediaFormat.KEY_STRIDE));
+        if (format != null && format.containsKey(MediaFormat.KEY_SLICE_HEIGHT))
+            sliceHeight = Math.max(height, format.getInteger(MediaFormat.KEY_SLICE_HEIGHT));
+
+        // The decoder outputs NV12 (semi-planar) or I420 (planar) frames
+        boolean planar = format != null && format.containsKey(MediaFormat.KEY_COLOR_FORMAT) &&
+                format.getInteger(MediaFormat.KEY_COLOR_FORMAT) == MediaCodecInfo.CodecCapabilities.COLOR_FormatYUV420Planar;
+        int lumaSize = stride * sliceHeight;
+        int uvRowStride = planar ? stride / 2 : stride;
+        int vStart = planar ? lumaSize + uvRowStride * (sliceHeight / 2) : lumaSize + 1;
+        if (dataSize < vStart + uvRowStride * (height / 2 - 1) + (planar ? width / 2 : width - 1))
+            return;
+
+        ByteBuffer frame = yuvFrame;
+        if (!frame.isDirect()) {
+            if (yuvBuffer == null || yuvBuffer.capacity() < dataSize)
+                yuvBuffer = ByteBuffer.allocateDirect(dataSize);
+            yuvBuffer.clear();
+            ByteBuffer source = yuvFrame.duplicate();
+            source.position(0).limit(dataSize);
+            yuvBuffer.put(source);
+            frame = yuvBuffer;
+        }
+
+        ByteBuffer y = plane(frame, 0, lumaSize);
+        ByteBuffer u = plane(frame, lumaSize, dataSize);
+        ByteBuffer v = plane(frame, vStart, dataSize);
+
+        img_time = -1;
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
+            Instant ins = Instant.now();
+            img_time = ins.getEpochSecond() + (ins.getNano() / 1e9);
+        }
+        setImageYuv(y, u, v, width, height, stride, uvRowStride, planar ? 1 : 2, img_time);
+
+        // The scan results are drawn into copies of this bitmap, so only its size matters
+        if (yuvBitmap == null || yuvBitmap.getWidth() != width || yuvBitmap.getHeight() != height)
+            yuvBitmap = Bitmap.createBitmap(width, height, Bitmap.Config.ARGB_8888);
+        Bitmap bitmap = yuvBitmap;
+        isProcessing = true;
+        Thread thread = new Thread() {
+            @Override
+            public void run() {
+                processBitmap(bitmap);
+                isProcessing = false;
+            }
+        };
+        thread.start();
+    }
+
+    // Provides a view of the bytes [start, end) of a buffer
+    private static ByteBuffer plane(ByteBuffer buffer, int start, int end) {
+        ByteBuffer view = buffer.duplicate();
+        view.position(start).limit(end);
+        return view.slice();
+    }
+
     public synchronized AircraftActivity getInstance(){
         return this;
     }
@@ -335,11 +447,11 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
 
         Bitmap bitmap1 = bitmap.copy(bitmap.getConfig(), true);
         Bitmap bitmap2 = bitmap.copy(bitmap.getConfig(), true);
-        double[][] object_poses = null;
+        int found = -1;
         if (r_group.getCheckedRadioButtonId() == R.id.objDetMode)
         {
 //            Log.e(TAG, "object detection set");
-            object_poses = scan(bitmap1, bitmap2, 0, false);
+            found = scanResults(bitmap1, bitmap2, 0, false);
         }
         else {
 //            Log.e(TAG, "motion detection set 1: *-*- "+String.valueOf(abs(movementTime-img_time)));
@@ -347,11 +459,11 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
 
             if ((!isMoving && !isRotating) && abs(movementTime-img_time)>motionDetectionDelay)
             {
-                object_poses = scan(bitmap1, bitmap2, 1, true);
+                found = scanResults(bitmap1, bitmap2, 1, true);
 //                Log.e(TAG, "motion - stable");
             }
             else {
-                object_poses = scan(bitmap1, bitmap2, 1, false);
+                found = scanResults(bitmap1, bitmap2, 1, false);
             }
             if (isMoving || isRotating)
             {
@@ -359,16 +471,24 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
 //                Log.e(TAG, "motion - is moving");
             }
         }
-//        Log.e(TAG, "---- ter before getimages");
-        objImages = getImages();
-//        Log.e(TAG, "---- ter before visualize obj call");
-        visualize(object_poses, bitmap2, bitmap1, false);
+        ScanResults results = null;
+        if (found >= 0)
+        {
+            results = takeResults();
+            results.ensureCapacity(found);
+            packResults(results.buffer, true);
+            Bitmap atlas = results.prepare();
+            if (atlas != null)
+                fillImageAtlas(atlas);
+        }
+        visualize(results, bitmap2, bitmap1);
+        boolean stationary = isStationary();
 
         this.runOnUiThread(new Runnable() {
 
             @Override
             public void run() {
-                binding.isMoving.setText(String.valueOf(isMoving)+","+String.valueOf(isRotating));
+                binding.isMoving.setText(String.valueOf(isMoving)+","+String.valueOf(isRotating)+","+String.valueOf(stationary));
                 binding.imageView2.setImageBitmap(bitmap1);
                 binding.motionImageView.setImageBitmap(bitmap2);
             }
@@ -382,6 +502,167 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
 
         ObjectInfoWindow oiw = new ObjectInfoWindow(this);
         googleMap.setInfoWindowAdapter(oiw);
+
+        // A long click adds a vertex to the mission boundary, a click shows the revisit data of the swept cell
+        googleMap.setOnMapLongClickListener(new GoogleMap.OnMapLongClickListener() {
+            @Override
+            public void onMapLongClick(@NonNull LatLng point) {
+                addMissionVertex(point);
+            }
+        });
+        googleMap.setOnMapClickListener(new GoogleMap.OnMapClickListener() {
+            @Override
+            public void onMapClick(@NonNull LatLng point) {
+                showCellRevisit(point);
+            }
+        });
+    }
+
+    // Adds a vertex to the mission boundary, and sets it in the scanner once it is a polygon
+    private void addMissionVertex(LatLng point) {
+        missionVertices.add(point);
+        if (mission_polygon != null)
+            mission_polygon.remove();
+        mission_polygon = null;
+        if (missionVertices.size() < 3)
+            return;
+
+        PolygonOptions opt = new PolygonOptions();
+        opt.addAll(missionVertices);
+        opt.strokeColor(Color.YELLOW);
+        opt.fillColor(Color.argb(40, 255, 255, 0));
+        mission_polygon = googleMap.addPolygon(opt);
+
+        double[] lats = new double[missionVertices.size()];
+        double[] lngs = new double[missionVertices.size()];
+        for (int k = 0; k < missionVertices.size(); k++) {
+            lats[k] = missionVertices.get(k).latitude;
+            lngs[k] = missionVertices.get(k).longitude;
+        }
+        // The mission cells are marked off the UI thread, as it waits for the sweep merges
+        new Thread() {
+            @Override
+            public void run() {
+                setMissionBoundary(lats, lngs);
+                missionSet = true;
+            }
+        }.start();
+    }
+
+    public void onClearMission(View v) {
+        missionSet = false;
+        missionVertices.clear();
+        if (mission_polygon != null)
+            mission_polygon.remove();
+        mission_polygon = null;
+        drawGaps(new ArrayList<List<List<LatLng>>>(), null);
+        new Thread() {
+            @Override
+            public void run() {
+                setMissionBoundary(new double[0], new double[0]);
+            }
+        }.start();
+    }
+
+    // Queries the unswept regions of the mission and its gap nearest to the aircraft every gapUpdateInterval
+    // seconds, and redraws them
+    public void updateGaps() {
+        Thread gaps_thread = new Thread() {
+            @Override
+            public void run() {
+                try {
+                    while (true) {
+                        sleep((long) (gapUpdateInterval * 1000));
+                        if (!missionSet)
+                            continue;
+
+                        List<List<List<LatLng>>> regions = gapRegions(getCoverageGaps());
+                        double[] nearest = getNearestGap(aircraftLat, aircraftLng);
+                        LatLng gap = (nearest != null ? new LatLng(nearest[0], nearest[1]) : null);
+
+                        runOnUiThread(new Runnable() {
+                            @Override
+                            public void run() {
+                                if (missionSet)
+                                    drawGaps(regions, gap);
+                            }
+                        });
+                    }
+                } catch (InterruptedException e) {
+                    e.printStackTrace();
+                }
+            }
+        };
+        gaps_thread.start();
+    }
+
+    // Groups the gap vertices by region (the object id) and ring (the lastIdx), the outer ring first
+    private List<List<List<LatLng>>> gapRegions(double[][] vertices) {
+        List<List<List<LatLng>>> regions = new ArrayList<List<List<LatLng>>>();
+        for (double[] v : vertices) {
+            int region = (int) v[8], ring = (int) v[6];
+            while (regions.size() <= region)
+                regions.add(new ArrayList<List<LatLng>>());
+            List<List<LatLng>> rings = regions.get(region);
+            while (rings.size() <= ring)
+                rings.add(new ArrayList<LatLng>());
+            rings.get(ring).add(new LatLng(v[0], v[1]));
+        }
+        return regions;
+    }
+
+    // Replaces the drawn gaps of the mission and the marker of the gap nearest to the aircraft
+    private void drawGaps(List<List<List<LatLng>>> regions, LatLng nearest) {
+        for (Polygon polygon : gap_polygons)
+            polygon.remove();
+        gap_polygons.clear();
+        if (gap_marker != null)
+            gap_marker.remove();
+        gap_marker = null;
+        if (googleMap == null)
+            return;
+
+        for (List<List<LatLng>> rings : regions) {
+            if (rings.isEmpty() || rings.get(0).size() < 3)
+                continue;
+            PolygonOptions opt = new PolygonOptions();
+            opt.addAll(rings.get(0));
+            for (int r = 1; r < rings.size(); r++)
+                if (rings.get(r).size() >= 3)
+                    opt.addHole(rings.get(r));
+            opt.fillColor(Color.argb(80, 255, 0, 0));
+            opt.strokeColor(Color.RED);
+            opt.strokeWidth(2);
+            gap_polygons.add(googleMap.addPolygon(opt));
+        }
+
+        if (nearest != null)
+            gap_marker = googleMap.addMarker(new MarkerOptions()
+                    .position(nearest)
+                    .title("Nearest Gap")
+                    .icon(BitmapDescriptorFactory.defaultMarker(BitmapDescriptorFactory.HUE_ORANGE)));
+    }
+
+    // Shows how many times the cell of a map point is visited, and how long ago it was last seen; the query
+    // waits for the sweep merges, so it runs off the UI thread
+    private void showCellRevisit(LatLng point) {
+        double now = 1e8;
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
+            Instant ins = Instant.now();
+            now = ins.getEpochSecond() + (ins.getNano() / 1e9);
+        }
+
+        double time = now;
+        new Thread() {
+            @Override
+            public void run() {
+                double[] revisit = getCellRevisit(point.latitude, point.longitude, time);
+                if (revisit == null || revisit[1] < 0)
+                    showToast("Not swept yet");
+                else
+                    showToast(String.format("Visits: %d, last seen %.0f s ago", (int) revisit[0], revisit[1]));
+            }
+        }.start();
     }
 
     protected void onProductChange() {
@@ -457,6 +738,24 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
     private void initUI()
     {
         r_group = (RadioGroup) findViewById(R.id.detectionMode);
+        binding.autoMotionGate.setOnCheckedChangeListener(new CompoundButton.OnCheckedChangeListener() {
+            @Override
+            public void onCheckedChanged(CompoundButton button, boolean checked) {
+                setAutoMotionGate(checked);
+            }
+        });
+        binding.detectionVelocity.setOnCheckedChangeListener(new CompoundButton.OnCheckedChangeListener() {
+            @Override
+            public void onCheckedChanged(CompoundButton button, boolean checked) {
+                setDetectionVelocity(checked);
+            }
+        });
+        binding.yuvFrames.setOnCheckedChangeListener(new CompoundButton.OnCheckedChangeListener() {
+            @Override
+            public void onCheckedChanged(CompoundButton button, boolean checked) {
+                enableYuvFrames(checked);
+            }
+        });
     }
 
     private void initState() {
@@ -506,6 +805,8 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
                     double lat = location.getLatitude();
                     double lon = location.getLongitude();
                     float alt = location.getAltitude();
+                    aircraftLat = lat;
+                    aircraftLng = lon;
 
                     runOnUiThread(new Runnable() {
                         @Override
@@ -596,7 +897,7 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
                     double gyaw = aircraftYaw;
                     GroundLocation elev = new GroundLocation();
 
-                    double[][] fov = setOrientation(groll, gpitch, gyaw, curr_time, elev);
+                    byte[] delta = setOrientationDelta(groll, gpitch, gyaw, curr_time, elev, sweptState.version());
 
                     isRotating = abs(groll-groll_old)>groll_dif_lim || abs(gpitch-gpitch_old)>gpitch_dif_lim || abs(gyaw - gyaw_old)>gyaw_dif_lim;
                     groll_old = groll;
@@ -605,7 +906,8 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
 
 
 //                    Log.e(TAG, "---- ter before visualize fov call");
-                    visualize(fov, null, null, true);
+                    if (delta != null)
+                        visualizeSweep(delta);
 //                    Log.e(TAG, "onResume");
                     runOnUiThread(new Runnable() {
                         @Override
@@ -705,231 +1007,168 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
         }
     }
 
-    private void visualize(double[][] markers, Bitmap movingsBitmap, Bitmap processedBitmap, boolean fovCall)
+    private void visualize(ScanResults results, Bitmap movingsBitmap, Bitmap processedBitmap)
     {
         runOnUiThread(new Runnable() {
 
             @Override
             public void run() {
-                if (!fovCall) {
-                    binding.motionImageView.setImageBitmap(movingsBitmap);
-                    binding.imageView2.setImageBitmap(processedBitmap);
-//                    Log.v(TAG, "vis -- obj call");
-                }
-                else
-                {
-//                    Log.v(TAG, "vis -- fov call");
-                }
+                binding.motionImageView.setImageBitmap(movingsBitmap);
+                binding.imageView2.setImageBitmap(processedBitmap);
 
-                if (markers != null && googleMap != null) {
-                    if (fovCall)
-                    {
-//                        if ( fov_polygon == null)
-//                            googleMap.moveCamera(CameraUpdateFactory.newLatLngZoom(new LatLng(markers[0][0], markers[0][1]), 18));
+                if (results == null)
+                    return;
 
-                        if (fov_polygon != null)
-                            fov_polygon.remove();
-                        if (sweep_polygon != null)
-                            sweep_polygon.remove();
-                    }
-//                    else
-//                    {
-
-//                        for (Marker mLocationMarker: AllMarkers) {
-//                            mLocationMarker.remove();
-//                        }
-//                        AllMarkers.clear();
-//                    }
-//                    Log.e(TAG, "---- ter 1.5");
-
-                    PolygonOptions fov_polygon_opt = new PolygonOptions();
-                    PolygonOptions sweep_polygon_opt = new PolygonOptions();
-
-                    List<MarkerSet> newMarkers = new ArrayList<MarkerSet>();
-//                    Log.e(TAG, "---- ter 1.75");
-
-                    int i = -1;
-                    for (double[] marker : markers) {
-                        i += 1;
-                        if (marker[3] == 0)
+                if (googleMap != null) {
+                    for (int i = 0; i < results.count(); i++) {
+                        int type = results.type(i), action = results.action(i);
+                        if (action == 3)
                         {
-//                            Log.e(TAG, "---- ter 2");
-
-                            if (marker[5] == 0) {
-//                                Log.e(TAG, "---- ter 3");
-                                continue;
-                            }
-                            LatLng per = new LatLng(marker[0], marker[1]);
-                            MarkerOptions locMarker = new MarkerOptions();
-                            locMarker.position(per);
-//                            Log.e(TAG, "---- ter 4");
+                            removeMarker(results.lastIdx(i));
+                            continue;
+                        }
+                        if (action == 0 || (type != 0 && type != 1 && type != 4))
+                            continue;
 
-                            locMarker.anchor(0.5f,0.5f);
+                        MarkerOptions locMarker = new MarkerOptions();
+                        locMarker.position(new LatLng(results.lat(i), results.lng(i)));
+                        locMarker.anchor(0.5f,0.5f);
+                        String kind;
+                        if (type == 0) {
                             locMarker.icon(BitmapDescriptorFactory.fromResource(R.drawable.red_circle_icon));
-
-                            MarkerSet mm = new MarkerSet();
-                            mm.marker = googleMap.addMarker(locMarker);
-//                            Log.e(TAG, "---- ter 6");
-
-//                            mm.setTag(new InfoWindowData(BitmapFactory.decodeResource(getResources(), R.drawable.mountain) , "person", marker[0], marker[1], marker[4]));
-                            mm.marker.setTag(new InfoWindowData(objImages[i] , "person", marker[0], marker[1], marker[4]));
-//                            Log.e(TAG, "---- ter 7");
-
-                            if (marker[5] == 1)
-                            {
-                                newMarkers.add(mm);
-                                if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
-                                    Instant ins = Instant.now();
-                                    mm.time = ins.getEpochSecond() + (ins.getNano()/1e9);
-                                }
-                            }
-                            else if (marker[5] == 2)
-                            {
-//                                Log.e(TAG, "---- ter 8");
-                                int idx = (int)marker[6];
-                                AllMarkers.get(idx).marker.remove();
-                                AllMarkers.set(idx, mm);
-                                if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
-                                    Instant ins = Instant.now();
-                                    mm.time = ins.getEpochSecond() + (ins.getNano()/1e9);
-                                }
-//                                Log.e(TAG, "---- ter 9");
-                            }
+                            kind = "person";
                         }
-                        else if (marker[3] == 1)
-                        {
-                            if (marker[5] == 0) continue;
-
-                            LatLng per = new LatLng(marker[0], marker[1]);
-                            MarkerOptions locMarker = new MarkerOptions();
-                            locMarker.position(per);
-                            locMarker.anchor(0.5f,0.5f);
+                        else if (type == 1) {
                             locMarker.icon(BitmapDescriptorFactory.fromResource(R.drawable.brown_rect_icon));
-//                                            locMarker.title("Person");
-                            MarkerSet mm = new MarkerSet();
-                            mm.marker = googleMap.addMarker(locMarker);
-                            mm.marker.setTag(new InfoWindowData(objImages[i] , "car", marker[0], marker[1], marker[4]));
-
-                            if (marker[5] == 1)
-                            {
-                                newMarkers.add(mm);
-                                if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
-                                    Instant ins = Instant.now();
-                                    mm.time = ins.getEpochSecond() + (ins.getNano()/1e9);
-                                }
-                            }
-                            else if (marker[5] == 2)
-                            {
-                                int idx = (int)marker[6];
-                                AllMarkers.get(idx).marker.remove();
-                                AllMarkers.set(idx, mm);
-                                if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
-                                    Instant ins = Instant.now();
-                                    mm.time = ins.getEpochSecond() + (ins.getNano()/1e9);
-                                }
-                            }
-                        }
-                        else if (marker[3] == 2)
-                        {
-                            fov_polygon_opt.add(new LatLng(marker[0], marker[1]));
+                            kind = "car";
                         }
-                        else if (marker[3] == 3)
-                        {
-                            sweep_polygon_opt.add(new LatLng(marker[0], marker[1]));
+                        else {
+                            locMarker.icon(BitmapDescriptorFactory.fromResource(R.drawable.yellow_arrow));
+                            locMarker.rotation((float) (aircraftYaw + results.direction(i)));
+                            kind = "moving";
                         }
-                        else if (marker[3] == 4)
-                        {
-                            if (marker[5] == 0)
-                                continue;
 
-                            LatLng mov = new LatLng(marker[0], marker[1]);
-                            MarkerOptions locMarker = new MarkerOptions();
-                            locMarker.position(mov);
-//                            Log.e(TAG, "---- ter 4");
-//
-                            locMarker.anchor(0.5f,0.5f);
-                            locMarker.icon(BitmapDescriptorFactory.fromResource(R.drawable.yellow_arrow));
-                            locMarker.rotation((float) (aircraftYaw + marker[7]));
-//                                            locMarker.title("Person");
-//                            Log.e(TAG, "---- ter 5");
-//
-                            MarkerSet mm = new MarkerSet();
-                            mm.marker = googleMap.addMarker(locMarker);
-//                            Log.e(TAG, "---- ter 6");
-//
-                            mm.marker.setTag(new InfoWindowData(objImages[i] , "moving", marker[0], marker[1], marker[4]));
-//                            Log.e(TAG, "---- ter 7");
-//
-                            if (marker[5] == 1)
-                            {
-                                newMarkers.add(mm);
-                                if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
-                                    Instant ins = Instant.now();
-                                    mm.time = ins.getEpochSecond() + (ins.getNano()/1e9);
-                                }
-                            }
-                            else if (marker[5] == 2)
-                            {
-//                                Log.e(TAG, "---- ter 8");
-                                int idx = (int)marker[6];
-                                AllMarkers.get(idx).marker.remove();
-                                AllMarkers.set(idx, mm);
-                                if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
-                                    Instant ins = Instant.now();
-                                    mm.time = ins.getEpochSecond() + (ins.getNano()/1e9);
-                                }
-//                                Log.e(TAG, "---- ter 9");
-                            }
-//                            Log.e(TAG, "---- ter 10");
-
-//                            if (marker[5] == 0) continue;
-//                            if (marker[5] == 1)
-//                            {
-//                                newMarkers.add(mm);
-//                            }
-//                            else if (marker[5] == 2)
-//                            {
-//                                int idx = (int)marker[6];
-//                                AllMarkers.get(idx).remove();
-//                                AllMarkers.set(idx, null);
-//                            }
-//                            Log.e(TAG, "---- ter 11");
+                        MarkerSet mm = new MarkerSet();
+                        mm.marker = googleMap.addMarker(locMarker);
+                        mm.marker.setTag(new InfoWindowData(results.thumbnail(i), kind, results.lat(i), results.lng(i), results.distance(i)));
+
+                        setMarker(results.lastIdx(i), mm);
+                        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
+                            Instant ins = Instant.now();
+                            mm.time = ins.getEpochSecond() + (ins.getNano()/1e9);
                         }
-//                        Log.e(TAG, "---- ter 12");
                     }
+                }
+                releaseResults(results);
+            }
+        });
+    }
 
-                    if (fovCall)
-                    {
-//                        Log.e(TAG, "---- ter 15");
-                        fov_polygon_opt.add(new LatLng(markers[0][0], markers[0][1]));
-//                        sweep_polygon_opt.add(new LatLng(markers[4][0], markers[4][1]));
+    // Provides a free results buffer; the buffers in use by the UI thread are not reused until released
+    private synchronized ScanResults takeResults() {
+        ScanResults results = freeResults.poll();
+        return (results != null ? results : new ScanResults(256));
+    }
 
-                        sweep_polygon_opt.fillColor(Color.argb(150, 100, 100, 100));
-                        sweep_polygon_opt.strokeColor(Color.argb(255, 255, 255, 255));
-                        fov_polygon_opt.fillColor(Color.argb(100, 255, 255, 255));
-                        fov_polygon_opt.strokeColor(Color.BLACK);
+    private synchronized void releaseResults(ScanResults results) {
+        freeResults.push(results);
+    }
 
-                        if (sweep_polygon_opt.getPoints().size() > 0) {
-                            sweep_polygon = googleMap.addPolygon(sweep_polygon_opt);
-                        }
+    // Applies a FOV and swept area delta, then redraws the FOV and only the swept regions which changed
+    private void visualizeSweep(byte[] delta) {
+        Set<Integer> changed = sweptState.apply(delta);
+        if (changed == null)
+            return;
 
-                        if (fov_polygon_opt.getPoints().size() > 0) {
-                            fov_polygon = googleMap.addPolygon(fov_polygon_opt);
-                        }
-//                        Log.e(TAG, "---- ter 16");
-                    }
-                    else
-                    {
-//                        Log.e(TAG, "---- ter 13");
-                        AllMarkers.addAll(newMarkers);
-//                        Log.e(TAG, "---- ter 14");
-                    }
+        List<LatLng> fov = sweptState.fov;
+        Map<Integer, List<List<LatLng>>> regions = new HashMap<Integer, List<List<LatLng>>>();
+        for (int region : changed)
+            regions.put(region, sweptState.region(region));
+        String coverage = coverageText(getCoverageStats());
 
+        runOnUiThread(new Runnable() {
+            @Override
+            public void run() {
+                binding.coverageState.setText(coverage);
+                if (googleMap == null)
+                    return;
+
+                if (fov_polygon != null)
+                    fov_polygon.remove();
+                fov_polygon = null;
+                if (fov.size() >= 3) {
+                    PolygonOptions fov_polygon_opt = new PolygonOptions();
+                    fov_polygon_opt.addAll(fov);
+                    fov_polygon_opt.fillColor(Color.argb(100, 255, 255, 255));
+                    fov_polygon_opt.strokeColor(Color.BLACK);
+                    fov_polygon = googleMap.addPolygon(fov_polygon_opt);
                 }
+
+                for (Map.Entry<Integer, List<List<LatLng>>> entry : regions.entrySet())
+                    drawSweptRegion(entry.getKey(), entry.getValue());
             }
         });
     }
 
+    // Formats the swept area, the mission coverage and the share of the swept cells visited more than once
+    private String coverageText(double[] stats) {
+        double cells = 0, revisited = 0;
+        for (int k = 3; k < stats.length; k++) {
+            cells += stats[k];
+            if (k > 3)
+                revisited += stats[k];
+        }
+        String text = String.format("Swept: %.0f m2\nRevisited: %.0f %%", stats[0], cells > 0 ? 100.0 * revisited / cells : 0.0);
+        if (stats[1] > 0)
+            text += String.format("\nMission: %.1f %%", stats[2]);
+        return text;
+    }
+
+    // Updates the polygon of a swept region in place, adding it if it is new or removing it if it is gone
+    private void drawSweptRegion(int region, List<List<LatLng>> rings) {
+        Polygon polygon = sweep_polygons.get(region);
+        if (rings.isEmpty() || rings.get(0).size() < 3) {
+            if (polygon != null)
+                polygon.remove();
+            sweep_polygons.remove(region);
+            return;
+        }
+
+        List<List<LatLng>> holes = new ArrayList<List<LatLng>>();
+        for (int r = 1; r < rings.size(); r++)
+            if (rings.get(r).size() >= 3)
+                holes.add(rings.get(r));
+
+        if (polygon != null) {
+            polygon.setPoints(rings.get(0));
+            polygon.setHoles(holes);
+            return;
+        }
+        PolygonOptions opt = new PolygonOptions();
+        opt.addAll(rings.get(0));
+        for (List<LatLng> hole : holes)
+            opt.addHole(hole);
+        opt.fillColor(Color.argb(150, 100, 100, 100));
+        opt.strokeColor(Color.argb(255, 255, 255, 255));
+        sweep_polygons.put(region, googleMap.addPolygon(opt));
+    }
+
+    // Puts the marker of a map object at its stable index (the object's lastIdx), replacing the previous one
+    private void setMarker(int idx, MarkerSet mm) {
+        while (AllMarkers.size() <= idx)
+            AllMarkers.add(null);
+        if (AllMarkers.get(idx) != null)
+            AllMarkers.get(idx).marker.remove();
+        AllMarkers.set(idx, mm);
+    }
+
+    // Removes the marker of a map object evicted by the scanner; its index may be reused later
+    private void removeMarker(int idx) {
+        if (idx < 0 || idx >= AllMarkers.size() || AllMarkers.get(idx) == null)
+            return;
+        AllMarkers.get(idx).marker.remove();
+        AllMarkers.set(idx, null);
+    }
 
     public void onClear(View v) {
 
@@ -939,7 +1178,8 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
             runOnUiThread(new Runnable() {
                 @Override
                 public void run() {
-                    AllMarkers.get(finalCounter).marker.remove();
+                    if (AllMarkers.get(finalCounter) != null)
+                        AllMarkers.get(finalCounter).marker.remove();
                 }
             });
         }
@@ -963,13 +1203,15 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
                         }
 
                         for (int counter = 0; counter < AllMarkers.size(); counter++) {
-                            float markerOpacity = Math.max(0.2f, 1.0f - ((float) (now - AllMarkers.get(counter).time) / markerShowTime));
+                            MarkerSet mm = AllMarkers.get(counter);
+                            if (mm == null)
+                                continue;
+                            float markerOpacity = Math.max(0.2f, 1.0f - ((float) (now - mm.time) / markerShowTime));
 
-                            int finalCounter = counter;
                             runOnUiThread(new Runnable() {
                                 @Override
                                 public void run() {
-                                    AllMarkers.get(finalCounter).marker.setAlpha(markerOpacity);
+                                    mm.marker.setAlpha(markerOpacity);
                                 }
                             });
                         }
@@ -1024,9 +1266,24 @@ public class AircraftActivity extends AppCompatActivity implements OnMapReadyCal
     public native void createScanner(String assets, String logs, int log_mode, float hva, int method);
     public native double[][] scan(Bitmap detections, Bitmap movings_img, int detMode, boolean isFix);
     public native void setImage(Bitmap bitmap, double time);
+    public native void setImageYuv(java.nio.ByteBuffer y, java.nio.ByteBuffer u, java.nio.ByteBuffer v, int width, int height,
+                                   int yRowStride, int uvRowStride, int uvPixelStride, double time);
     public native void setLocation(double lat, double lng, double alt, double time);
     public native void setUserLocation(double lat, double lng);
+    public native void setAutoMotionGate(boolean enable);
+    public native void setDetectionVelocity(boolean enable);
+    public native boolean isStationary();
+    public native void setFovPolicy(double shift, double angle, double minInterval, double keepalive);
+    public native void setMissionBoundary(double[] lats, double[] lngs);
+    public native double[] getCoverageStats();
+    public native double[][] getCoverageGaps();
+    public native double[] getNearestGap(double lat, double lng);
+    public native double[] getCellRevisit(double lat, double lng, double time);
     public native double[][] setOrientation(double roll, double pitch, double azimuth, double time, GroundLocation elev);
+    public native byte[] setOrientationDelta(double roll, double pitch, double azimuth, double time, GroundLocation elev, int ackedVersion);
     public native Bitmap[] getImages();
+    public native int scanResults(Bitmap detections, Bitmap movings_img, int detMode, boolean isFix);
+    public native int packResults(java.nio.ByteBuffer buffer, boolean withAtlas);
+    public native boolean fillImageAtlas(Bitmap atlas);
 
 }
\ No newline at end of file
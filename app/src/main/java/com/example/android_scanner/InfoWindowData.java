@@ -9,6 +9,7 @@ public class InfoWindowData {
     public double lat;
     public double lng;
     public double dist;
+    private static Bitmap blank = null;
 
     public InfoWindowData(Bitmap bitmap, String tp, double lt, double lg, double ds)
     {
@@ -18,4 +19,15 @@ public class InfoWindowData {
         lng = lg;
         dist = ds;
     }
+
+    // Provides the picture of the object; a blank bitmap if it has none
+    public Bitmap picture()
+    {
+        if (img == null) {
+            if (blank == null)
+                blank = Bitmap.createBitmap(10, 10, Bitmap.Config.ARGB_8888);
+            return blank;
+        }
+        return img;
+    }
 };
@@ -23,6 +23,7 @@ import android.content.res.AssetManager;
 import android.graphics.Bitmap;
 import android.graphics.BitmapFactory;
 import android.graphics.Color;
+import android.graphics.ImageFormat;
 import android.graphics.Rect;
 import android.graphics.YuvImage;
 import android.hardware.Camera;
@@ -166,7 +167,7 @@ public class MainActivity extends AppCompatActivity implements OnMapReadyCallbac
 
     Polyline polyline = null;
     Polygon fov_polygon = null;
-    Polygon sweep_polygon = null;
+    List<Polygon> sweep_polygons = new ArrayList<Polygon>();
     GoogleMap googleMap = null;
 
     class MarkerSet {
@@ -389,16 +390,24 @@ public class MainActivity extends AppCompatActivity implements OnMapReadyCallbac
         int width = parameters.getPreviewSize().width;
         int height = parameters.getPreviewSize().height;
 
-        YuvImage yuv = new YuvImage(imgSet.imgBytes, parameters.getPreviewFormat(), width, height, null);
+        Bitmap bitmap1;
+        if (parameters.getPreviewFormat() == ImageFormat.NV21) {
+            // The preview bytes are passed as they are; the scanner converts them only as needed
+            setImageNv21(imgSet.imgBytes, width, height, imgSet.image_time);
+            bitmap1 = Bitmap.createBitmap(width, height, Bitmap.Config.ARGB_8888);
+        }
+        else {
+            YuvImage yuv = new YuvImage(imgSet.imgBytes, parameters.getPreviewFormat(), width, height, null);
 
-        ByteArrayOutputStream out = new ByteArrayOutputStream();
-        yuv.compressToJpeg(new Rect(0, 0, width, height), 50, out);
+            ByteArrayOutputStream out = new ByteArrayOutputStream();
+            yuv.compressToJpeg(new Rect(0, 0, width, height), 50, out);
 
-        byte[] bts = out.toByteArray();
-        final Bitmap bitmap = BitmapFactory.decodeByteArray(bts, 0, bts.length);
+            byte[] bts = out.toByteArray();
+            final Bitmap bitmap = BitmapFactory.decodeByteArray(bts, 0, bts.length);
 
-        setImage(bitmap, imgSet.image_time);
-        Bitmap bitmap1 = bitmap.copy(bitmap.getConfig(), true);
+            setImage(bitmap, imgSet.image_time);
+            bitmap1 = bitmap.copy(bitmap.getConfig(), true);
+        }
 //        detect(bitmap, bitmap1);
         scan(bitmap1);
         MainActivity.this.runOnUiThread(new Runnable() {
@@ -479,18 +488,22 @@ public class MainActivity extends AppCompatActivity implements OnMapReadyCallbac
 
                                     if (fov_polygon != null)
                                         fov_polygon.remove();
-                                    if (sweep_polygon != null)
-                                        sweep_polygon.remove();
 
                                     PolygonOptions fov_polygon_opt = new PolygonOptions();
-                                    PolygonOptions sweep_polygon_opt = new PolygonOptions();
+                                    List<List<List<LatLng>>> sweep_regions = new ArrayList<List<List<LatLng>>>();
+                                    int sweep_vertices = 0;
 
 //                                    List<Marker> newMarkers = new ArrayList<Marker>();      //%%%
-                                    List<MarkerSet> newMarkers = new ArrayList<MarkerSet>();      //%%%
                                     int objCount = -1;
                                     for(int i=0; i<fov.length; i++) {
                                         objCount++;
 
+                                        if (fov[i][5] == 3)
+                                        {
+                                            removeMarker((int) fov[i][6]);
+                                            continue;
+                                        }
+
                                         if (fov[i][3] == 0) {
 
                                             if (fov[i][5] == 0) continue;
@@ -522,7 +535,7 @@ public class MainActivity extends AppCompatActivity implements OnMapReadyCallbac
 //                                            mm.marker
                                             if (fov[i][5] == 1)
                                             {
-                                                newMarkers.add(mm);
+                                                setMarker((int) fov[i][6], mm);
                                                 if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
                                                     Instant ins = Instant.now();
                                                     mm.time = ins.getEpochSecond() + (ins.getNano()/1e9);
@@ -530,12 +543,10 @@ public class MainActivity extends AppCompatActivity implements OnMapReadyCallbac
                                             }
                                             else if (fov[i][5] == 2)
                                             {
-                                                int idx = (int)fov[i][6];
-                                                AllMarkers.get(idx).marker.remove();            //%%%
-                                                AllMarkers.set(idx, mm);
+                                                setMarker((int) fov[i][6], mm);
                                                 if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
                                                     Instant ins = Instant.now();
-                                                    AllMarkers.get(idx).time = ins.getEpochSecond() + (ins.getNano()/1e9);
+                                                    mm.time = ins.getEpochSecond() + (ins.getNano()/1e9);
                                                 }
                                             }
 
@@ -573,7 +584,7 @@ public class MainActivity extends AppCompatActivity implements OnMapReadyCallbac
 
                                             if (fov[i][5] == 1)
                                             {
-                                                newMarkers.add(mm);
+                                                setMarker((int) fov[i][6], mm);
                                                 if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
                                                     Instant ins = Instant.now();
                                                     mm.time = ins.getEpochSecond() + (ins.getNano()/1e9);
@@ -581,12 +592,10 @@ public class MainActivity extends AppCompatActivity implements OnMapReadyCallbac
                                             }
                                             else if (fov[i][5] == 2)
                                             {
-                                                int idx = (int)fov[i][6];
-                                                AllMarkers.get(idx).marker.remove();        //%%%
-                                                AllMarkers.set(idx, mm);
+                                                setMarker((int) fov[i][6], mm);
                                                 if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
                                                     Instant ins = Instant.now();
-                                                    AllMarkers.get(idx).time = ins.getEpochSecond() + (ins.getNano()/1e9);
+                                                    mm.time = ins.getEpochSecond() + (ins.getNano()/1e9);
                                                 }
                                             }
 //                                            Log.v(TAG, "as car");
@@ -597,7 +606,8 @@ public class MainActivity extends AppCompatActivity implements OnMapReadyCallbac
                                         }
                                         else if(fov[i][3] == 3)
                                         {
-                                            sweep_polygon_opt.add(new LatLng(fov[i][0], fov[i][1]));
+                                            addSweepVertex(sweep_regions, fov[i]);
+                                            sweep_vertices++;
                                         }
                                         else if(fov[i][3] == 4)
                                         {
@@ -623,7 +633,7 @@ public class MainActivity extends AppCompatActivity implements OnMapReadyCallbac
 
                                             if (fov[i][5] == 1)
                                             {
-                                                newMarkers.add(mm);
+                                                setMarker((int) fov[i][6], mm);
                                                 if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
                                                     Instant ins = Instant.now();
                                                     mm.time = ins.getEpochSecond() + (ins.getNano()/1e9);
@@ -631,28 +641,23 @@ public class MainActivity extends AppCompatActivity implements OnMapReadyCallbac
                                             }
                                             else if (fov[i][5] == 2)
                                             {
-                                                int idx = (int)fov[i][6];
-                                                AllMarkers.get(idx).marker.remove();           //%%%
-                                                AllMarkers.set(idx, mm);
+                                                setMarker((int) fov[i][6], mm);
                                                 if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
                                                     Instant ins = Instant.now();
-                                                    AllMarkers.get(idx).time = ins.getEpochSecond() + (ins.getNano()/1e9);
+                                                    mm.time = ins.getEpochSecond() + (ins.getNano()/1e9);
                                                 }
                                             }
                                         }
                                     }
 
-                                    AllMarkers.addAll(newMarkers);
 
                                     fov_polygon_opt.add(new LatLng(fov[0][0], fov[0][1]));
 //                                    sweep_polygon_opt.add(new LatLng(fov[4][0], fov[4][1]));
 
-                                    sweep_polygon_opt.fillColor(Color.argb(150, 100, 100, 100));
-                                    sweep_polygon_opt.strokeColor(Color.argb(255, 255, 255, 255));
                                     fov_polygon_opt.fillColor(Color.argb(100, 255, 255, 255));
                                     fov_polygon_opt.strokeColor(Color.BLACK);
 
-                                    binding.textView7.setText(String.valueOf(sweep_polygon_opt.getPoints().size()));
+                                    binding.textView7.setText(String.valueOf(sweep_vertices));
 
                                     binding.textView9.setText(String.valueOf(elev.elev));
                                     if (elev.elev == 0) {
@@ -666,9 +671,7 @@ public class MainActivity extends AppCompatActivity implements OnMapReadyCallbac
                                         binding.textView9.setTextColor(Color.GREEN);
                                     }
 
-                                    if (sweep_polygon_opt.getPoints().size() > 0) {
-                                        sweep_polygon = googleMap.addPolygon(sweep_polygon_opt);
-                                    }
+                                    drawSweptArea(sweep_regions);
                                     if (fov_polygon_opt.getPoints().size() > 0) {
                                         fov_polygon = googleMap.addPolygon(fov_polygon_opt);
                                     }
@@ -687,6 +690,55 @@ public class MainActivity extends AppCompatActivity implements OnMapReadyCallbac
         read_thread.start();
     }
 
+    // Adds an outline vertex of the swept area; column 8 is the swept region and column 6 the ring in it
+    // (0 for the outer ring, 1 and more for the holes)
+    private void addSweepVertex(List<List<List<LatLng>>> regions, double[] vertex) {
+        int region = (int) vertex[8], ring = (int) vertex[6];
+        while (regions.size() <= region)
+            regions.add(new ArrayList<List<LatLng>>());
+        List<List<LatLng>> rings = regions.get(region);
+        while (rings.size() <= ring)
+            rings.add(new ArrayList<LatLng>());
+        rings.get(ring).add(new LatLng(vertex[0], vertex[1]));
+    }
+
+    // Replaces the swept area polygons on the map, one per disjoint swept region
+    private void drawSweptArea(List<List<List<LatLng>>> regions) {
+        for (Polygon p : sweep_polygons)
+            p.remove();
+        sweep_polygons.clear();
+
+        for (List<List<LatLng>> rings : regions) {
+            if (rings.isEmpty() || rings.get(0).size() < 3)
+                continue;
+            PolygonOptions opt = new PolygonOptions();
+            opt.addAll(rings.get(0));
+            for (int r = 1; r < rings.size(); r++)
+                if (rings.get(r).size() >= 3)
+                    opt.addHole(rings.get(r));
+            opt.fillColor(Color.argb(150, 100, 100, 100));
+            opt.strokeColor(Color.argb(255, 255, 255, 255));
+            sweep_polygons.add(googleMap.addPolygon(opt));
+        }
+    }
+
+    // Puts the marker of a map object at its stable index (the object's lastIdx), replacing the previous one
+    private void setMarker(int idx, MarkerSet mm) {
+        while (AllMarkers.size() <= idx)
+            AllMarkers.add(null);
+        if (AllMarkers.get(idx) != null)
+            AllMarkers.get(idx).marker.remove();
+        AllMarkers.set(idx, mm);
+    }
+
+    // Removes the marker of a map object evicted by the scanner; its index may be reused later
+    private void removeMarker(int idx) {
+        if (idx < 0 || idx >= AllMarkers.size() || AllMarkers.get(idx) == null)
+            return;
+        AllMarkers.get(idx).marker.remove();
+        AllMarkers.set(idx, null);
+    }
+
     public void changeMarkers() {
         Thread markers_thread = new Thread() {
             @Override
@@ -704,13 +756,15 @@ public class MainActivity extends AppCompatActivity implements OnMapReadyCallbac
                         }
 
                         for (int counter = 0; counter < AllMarkers.size(); counter++) {
-                            float markerOpacity = Math.max(0.0f, 1.0f - ((float) (now - AllMarkers.get(counter).time) / markerShowTime));
+                            MarkerSet mm = AllMarkers.get(counter);
+                            if (mm == null)
+                                continue;
+                            float markerOpacity = Math.max(0.0f, 1.0f - ((float) (now - mm.time) / markerShowTime));
 
-                            int finalCounter = counter;
                             runOnUiThread(new Runnable() {
                                 @Override
                                 public void run() {
-                                    AllMarkers.get(finalCounter).marker.setAlpha(markerOpacity);
+                                    mm.marker.setAlpha(markerOpacity);
                                 }
                             });
                         }
@@ -744,6 +798,7 @@ public class MainActivity extends AppCompatActivity implements OnMapReadyCallbac
 //    public native void detect(Bitmap bitmapIn, Bitmap bitmapOut);
     public native void scan(Bitmap detections);
     public native void setImage(Bitmap bitmap, double time);
+    public native void setImageNv21(byte[] data, int width, int height, double time);
     public native void setLocation(double lat, double lng, double alt, double time);
 //    public native boolean setOrientation(double roll, double pitch, double azimuth, double time, Double[][] oa);
     public native double[][] setOrientation(double roll, double pitch, double azithmu, double time);
@@ -44,8 +44,12 @@ public class ObjectInfoWindow extends LinearLayout implements GoogleMap.InfoWind
     public View getInfoWindow(@NonNull Marker marker) {
 
         InfoWindowData data = (InfoWindowData) marker.getTag();
+        // The markers which are not map objects (e.g. the nearest gap) get the default window
+        if (data == null)
+            return null;
 
-        Bitmap btm = Bitmap.createScaledBitmap(data.img, 200, data.img.getHeight()*100/data.img.getWidth(), false);
+        Bitmap img = data.picture();
+        Bitmap btm = Bitmap.createScaledBitmap(img, 200, img.getHeight()*100/img.getWidth(), false);
 
         imageView.setImageBitmap(btm);
         objTypeTxt.setText(data.type);
@@ -0,0 +1,68 @@
+package com.example.android_scanner;
+
+import android.graphics.Bitmap;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+// The results of a scan, packed by the native ResultPacker class into a reused direct buffer, and the atlas of
+// their pictures; see resultPacker.h for the record layout
+public class ScanResults {
+
+    public static final int HEADER_SIZE = 16;
+    public static final int RECORD_SIZE = 64;
+
+    public ByteBuffer buffer;
+    public Bitmap atlas = null;
+    private int count = 0;
+
+    public ScanResults(int records) {
+        allocate(records);
+    }
+
+    private void allocate(int records) {
+        buffer = ByteBuffer.allocateDirect(HEADER_SIZE + records * RECORD_SIZE).order(ByteOrder.LITTLE_ENDIAN);
+    }
+
+    // Grows the buffer if it cannot hold the given number of records; the content is dropped
+    public void ensureCapacity(int records) {
+        if (buffer.capacity() < HEADER_SIZE + records * RECORD_SIZE)
+            allocate(Math.max(records, 2 * (buffer.capacity() - HEADER_SIZE) / RECORD_SIZE));
+    }
+
+    // Reads the header after the buffer is packed, and returns the atlas bitmap to fill, grown if needed, or
+    // null if there is no picture
+    public Bitmap prepare() {
+        count = buffer.getInt(0);
+        int width = buffer.getInt(8), height = buffer.getInt(12);
+        if (width == 0 || height == 0)
+            return null;
+        if (atlas == null || atlas.getWidth() < width || atlas.getHeight() < height)
+            atlas = Bitmap.createBitmap(width, Math.max(height, atlas == null ? 0 : atlas.getHeight()), Bitmap.Config.ARGB_8888);
+        return atlas;
+    }
+
+    public int count() { return count; }
+
+    private int at(int i) { return HEADER_SIZE + i * RECORD_SIZE; }
+
+    public double lat(int i) { return buffer.getDouble(at(i)); }
+    public double lng(int i) { return buffer.getDouble(at(i) + 8); }
+    public double alt(int i) { return buffer.getDouble(at(i) + 16); }
+    public float distance(int i) { return buffer.getFloat(at(i) + 24); }
+    public float direction(int i) { return buffer.getFloat(at(i) + 28); }
+    public int type(int i) { return buffer.getInt(at(i) + 32); }
+    public int action(int i) { return buffer.getInt(at(i) + 36); }
+    public int lastIdx(int i) { return buffer.getInt(at(i) + 40); }
+    public int id(int i) { return buffer.getInt(at(i) + 44); }
+
+    // Copies the picture of a record out of the atlas, so that it outlives the next scan packed into these
+    // results; null if it has none. Only called for the markers which are created or replaced
+    public Bitmap thumbnail(int i) {
+        int x = buffer.getShort(at(i) + 48), y = buffer.getShort(at(i) + 50);
+        int w = buffer.getShort(at(i) + 52), h = buffer.getShort(at(i) + 54);
+        if (w == 0 || h == 0 || atlas == null)
+            return null;
+        return Bitmap.createBitmap(atlas, x, y, w, h);
+    }
+}
@@ -0,0 +1,91 @@
+package com.example.android_scanner;
+
+import com.google.android.gms.maps.model.LatLng;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.Set;
+import java.util.TreeSet;
+
+// The FOV and the swept area outline as decoded from the delta buffers of the native OutlineDelta class; see
+// outlineDelta.h for the buffer layout
+public class SweptAreaState {
+
+    private static class Ring {
+        int region;
+        int ring;
+        List<LatLng> points = new ArrayList<LatLng>();
+    }
+
+    private int version = 0;
+    private final List<Ring> rings = new ArrayList<Ring>();
+
+    public List<LatLng> fov = new ArrayList<LatLng>();
+
+    // The last applied version, to be acknowledged with the next request
+    public int version() {
+        return version;
+    }
+
+    // Applies a delta buffer and returns the regions whose rings changed, or null if the buffer is not based
+    // on the applied version (the next request acknowledges the applied version, so a keyframe follows)
+    public Set<Integer> apply(byte[] buffer) {
+        ByteBuffer in = ByteBuffer.wrap(buffer).order(ByteOrder.LITTLE_ENDIAN);
+        int newVersion = in.getInt();
+        int baseVersion = in.getInt();
+        if (baseVersion != 0 && baseVersion != version)
+            return null;
+
+        Set<Integer> changed = new TreeSet<Integer>();
+        if (baseVersion == 0) {
+            for (Ring r : rings)
+                changed.add(r.region);
+            rings.clear();
+        }
+
+        double originLat = in.getDouble(), originLng = in.getDouble();
+        fov = new ArrayList<LatLng>();
+        for (int n = in.getInt(); n > 0; n--)
+            fov.add(new LatLng(originLat + in.getFloat(), originLng + in.getFloat()));
+
+        int ringCount = in.getInt();
+        for (int n = in.getInt(); n > 0; n--) {
+            int k = in.getInt();
+            while (rings.size() <= k)
+                rings.add(new Ring());
+            Ring r = rings.get(k);
+            changed.add(r.region);
+            r.region = in.getInt();
+            r.ring = in.getInt();
+            changed.add(r.region);
+
+            int start = in.getInt(), removed = in.getInt(), inserted = in.getInt();
+            r.points.subList(start, start + removed).clear();
+            List<LatLng> added = new ArrayList<LatLng>(inserted);
+            for (int i = 0; i < inserted; i++)
+                added.add(new LatLng(originLat + in.getFloat(), originLng + in.getFloat()));
+            r.points.addAll(start, added);
+        }
+        while (rings.size() > ringCount)
+            changed.add(rings.remove(rings.size() - 1).region);
+
+        changed.remove(-1);
+        version = newVersion;
+        return changed;
+    }
+
+    // Copies the rings of a region, the outer one first; empty if the region does not exist anymore
+    public List<List<LatLng>> region(int region) {
+        List<List<LatLng>> out = new ArrayList<List<LatLng>>();
+        for (Ring r : rings) {
+            if (r.region != region)
+                continue;
+            while (out.size() <= r.ring)
+                out.add(new ArrayList<LatLng>());
+            out.set(r.ring, new ArrayList<LatLng>(r.points));
+        }
+        return out;
+    }
+}
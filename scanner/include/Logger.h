@@ -17,6 +17,8 @@
 #include "time.h"
 #include <android/log.h>
 #include <fstream>
+#include "stationarityDetector.h"
+#include "frame.h"
 
 using namespace cv;
 
@@ -29,7 +31,7 @@ using namespace cv;
  */
 struct Image
 {
-    Mat image = Mat::zeros(Size(480, 640),CV_8UC1);     /**< The image itself */
+    Frame frame = Frame(Mat::zeros(Size(480, 640),CV_8UC1), FRAME_GRAY);   /**< The image itself */
     double time = 0;                                        /**< The time in which image is captured */
 };
 
@@ -44,8 +46,8 @@ struct Location
     double lng = 0.0;   /**< GPS longitude */
     double alt = 0.0;   /**< GPS altitude */
     double time = 0;    /**< The time in which location data is received from sensor */
-    double x = 0.0;     /**< UTM x */
-    double y = 0.0;     /**< UTM y */
+    double x = 0.0;     /**< East coordinate in meters, in the Scanner's local frame */
+    double y = 0.0;     /**< North coordinate in meters, in the Scanner's local frame */
     int zone = 0;       /**< UTM zone number */
 };
 
@@ -69,7 +71,7 @@ struct Orientation
  */
 struct ImageSet
 {
-    Mat image;              /**< The image captured by the camera */
+    Frame frame;            /**< The image captured by the camera; its luma and colour planes are provided on demand */
     double lat = 0.0;       /**< GPS latitude corresponding to the image */
     double lng = 0.0;       /**< GPS longitude corresponding to the image */
     double alt = 0.0;       /**< GPS altitude corresponding to the image */
@@ -111,12 +113,14 @@ struct ImuSet
   *     -# In another functionality, for each IMU data, finds the nearest GPS data in terms of time to
   *     receive
   *     -# If desired, saves the synchronized data in a specific directory within device memory
+  *     -# Decides whether the camera is stationary, based on the variance of recent IMU and GPS data
   *
   * Call the function getImageSet() to get an ImageSet instance with synchronized image, IMU data and GPS
   * data
   * Call the function getImuSet() to get an ImuSet instance with synchronized IMU data and GPS data
   * Call the function getImageSetFromLogger() to get an ImageSet instance from an existing pre-logged
   * directory
+  * Call the function isStationary() to know whether the camera is currently in a fixed position
   *
   * \sa class Scanner, class Sweeper, class Detector, class MotionDetector
  */
@@ -131,6 +135,7 @@ class Logger {
     std::vector<Orientation> orientationBuffer;
     int locBufLen = 5, ornBufLen = 40, counter;
     std::string prelogged_dir;
+    StationarityDetector stationarity;
 
     void bufferLocation(Location);
     void bufferOrientation(Orientation);
@@ -143,7 +148,7 @@ public:
     bool readFromLog;
 
     Logger(std::string, bool, bool, std::string);
-    void setImage(Mat&, double);
+    void setImage(const Frame&, double);
     void setLocation(double, double, double, double);
     bool setOrientation(double, double, double, double);
     bool getImageSet(ImageSet&);
@@ -151,6 +156,8 @@ public:
     void disableLogMode();
     void enableLogMode();
     bool getImageSetFromLogger(ImageSet &, ImuSet &);
+    bool isStationary();
+    bool getGroundVelocity(double&, double&);
 };
 
 #endif
\ No newline at end of file
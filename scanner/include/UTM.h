@@ -50,6 +50,7 @@
 
 
 #include <math.h>
+#include <stddef.h>
 
 #define pi 3.14159265358979
 
@@ -167,8 +168,8 @@ void MapXYToLatLon (FLOAT x, FLOAT y, FLOAT lambda0, FLOAT& phi, FLOAT& lambda);
 // Universal Transverse Mercator projection.
 //
 // Inputs:
-//   lat - Latitude of the point, in radians.
-//   lon - Longitude of the point, in radians.
+//   lat - Latitude of the point, in degrees.
+//   lon - Longitude of the point, in degrees.
 //   zone - UTM zone to be used for calculating values for x and y.
 //          If zone is less than 1 or greater than 60, the routine
 //          will determine the appropriate zone from the value of lon.
@@ -183,8 +184,7 @@ int LatLonToUTMXY (FLOAT lat, FLOAT lon, int zone, FLOAT& x, FLOAT& y);
 
 // UTMXYToLatLon
 //
-// Converts x and y coordinates in the Universal Transverse Mercator//   The UTM zone parameter should be in the range [1,60].
-
+// Converts x and y coordinates in the Universal Transverse Mercator
 // projection to a latitude/longitude pair.
 //
 // Inputs:
@@ -202,5 +202,22 @@ int LatLonToUTMXY (FLOAT lat, FLOAT lon, int zone, FLOAT& x, FLOAT& y);
 // The function does not return a value.
 void UTMXYToLatLon (FLOAT x, FLOAT y, int zone, bool southhemi, FLOAT& lat, FLOAT& lon);
 
+// Batch conversions
+// The same conversions as LatLonToUTMXY and UTMXYToLatLon for n points at once, all of them in a single
+// zone (and hemisphere). If zone is out of [1,60], LatLonToUTMXY determines it from the first point.
+// The points are converted in small chunks with vectorized sin/cos, with no heap allocation.
+//
+// Accuracy (against the scalar double precision conversion, zone 33, |lat| < 80 degrees,
+// |lon - central meridian| < 3 degrees):
+//   double - within 1e-8 m and 1e-15 rad; the same results up to the rounding.
+//   float  - within 0.3 m in easting and 2.3 m in northing (a float northing itself only resolves 0.5 m
+//            at 8e6 m), and within 2 m in latitude and 0.25 m in longitude on the ground (3e-7 rad).
+//            Good enough for drawing and coarse gating, not for accumulating geometry; use the double
+//            version for that.
+int LatLonToUTMXY (const double *lat, const double *lon, size_t n, int zone, double *x, double *y);
+int LatLonToUTMXY (const float *lat, const float *lon, size_t n, int zone, float *x, float *y);
+void UTMXYToLatLon (const double *x, const double *y, size_t n, int zone, bool southhemi, double *lat, double *lon);
+void UTMXYToLatLon (const float *x, const float *y, size_t n, int zone, bool southhemi, float *lat, float *lon);
+
 #endif
 
@@ -0,0 +1,80 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#ifndef ANDROID_SCANNER_CAMERAMODEL_H
+#define ANDROID_SCANNER_CAMERAMODEL_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+/**
+  * \scanner_module \ingroup Scanner_Module
+  * \class CameraModel
+  * \brief Holds the camera intrinsics and provides the unit ray of each image point
+  *
+  * The focal length is derived from the image width and the horizontal view angle, assuming that the
+  * optical center is the image center. Optionally a radial lens distortion (k1, k2 of the Brown model) is
+  * applied. The unit rays (camera frame: right, down, forward) of a coarse grid of image points are
+  * calculated once per resolution, view angle and distortion, the distortion being removed from each grid
+  * point. The ray of any image point is then interpolated bilinearly between the four surrounding grid
+  * rays, with no square root nor undistortion per point. With a 16 pixel grid and a 640 pixel wide image,
+  * the interpolated rays are within 1e-4 rad of the exact ones and their norms within 3e-4 of 1 (less at
+  * higher resolutions), which is negligible compared to the sensor errors.
+  *
+  * A single instance is shared by all the modules which need the camera geometry, which may run on other
+  * threads than the one configuring it. A ray table is never modified once built: each new configuration
+  * builds a new table, whose pointer is swapped atomically. A module takes the table with rays() once per
+  * batch of image points, and keeps using it however the camera is configured meanwhile.
+  *
+  * Call the functions setViewAngle() and setDistortion() to set the camera parameters
+  * Call the function configure() with the image resolution before looking up the rays
+  * Call the function rays() to get the current ray table, then Rays::ray() to get the unit ray of an image point
+  *
+  * \sa class Scanner, class MotionDetector, class GroundProjector
+ */
+class CameraModel {
+
+public:
+
+    /**
+      * \class Rays
+      * \brief The unit rays of the grid points for one camera configuration; never modified once built
+     */
+    class Rays {
+
+        friend class CameraModel;
+
+        int step = 1, gridCols = 0, gridRows = 0;
+        double f = 1.0;
+        std::vector<double> rayRight, rayDown, rayForward;
+
+    public:
+
+        bool valid() const;
+        double focalLength() const;
+        void ray(float, float, double&, double&, double&) const;
+    };
+
+    CameraModel(float = 66.0, int = 16);
+    void setViewAngle(float);
+    void setDistortion(double, double);
+    bool configure(int, int);
+    bool isConfigured() const;
+    std::shared_ptr<const Rays> rays() const;
+
+private:
+
+    float hva;
+    int step, imgWidth = 0, imgHeight = 0;
+    double k1 = 0.0, k2 = 0.0;
+    bool built = false;
+    std::mutex buildMutex;
+    std::shared_ptr<const Rays> table;
+
+    void build();
+    void undistort(double, double, double&, double&) const;
+};
+
+#endif //ANDROID_SCANNER_CAMERAMODEL_H
@@ -0,0 +1,125 @@
+
+#ifndef ANDROID_SCANNER_COVERAGEGRID_H
+#define ANDROID_SCANNER_COVERAGEGRID_H
+
+#include <vector>
+#include <stdint.h>
+#include <unordered_map>
+#include <opencv2/core.hpp>
+
+#include <boost/geometry.hpp>
+#include <boost/geometry/geometries/point_xy.hpp>
+#include <boost/geometry/geometries/polygon.hpp>
+
+namespace SweeperGeometry{
+
+    typedef boost::geometry::model::polygon<boost::geometry::model::d2::point_xy<double> > polygon;
+
+    /**
+      * \scanner_module \ingroup Scanner_Module
+      * \struct CoverageStats
+      * \brief The coverage statistics of the swept area
+     */
+    struct CoverageStats
+    {
+        double sweptArea = 0.0;                 /**< The total swept area in square meters */
+        double missionArea = 0.0;               /**< The area of the mission boundary in square meters, 0 if not set */
+        double missionCoverage = 0.0;           /**< The swept percentage of the mission area */
+        std::vector<size_t> visitHistogram;     /**< The number of cells visited k+1 times at index k; the last
+                                                     bin counts the cells visited as many times or more */
+    };
+
+    /**
+      * \scanner_module \ingroup Scanner_Module
+      * \class CoverageGrid
+      * \brief A tiled occupancy bitmap of the swept area, in meters in the Scanner's local frame
+      *
+      * The cells are squares of the given size, grouped in square tiles which are allocated as the camera
+      * first sweeps them, so the memory follows the swept area and not its bounding box. Each field of view
+      * polygon is scan converted into the cells whose centers it covers, at a cost proportional to its
+      * footprint, whatever the size of the area swept before. The outlines are traced only when they are
+      * requested, with their holes, and each disjoint swept region is a polygon of its own. The swept cells
+      * are traced from a persistent mask into which only the tiles swept since the previous outline are
+      * copied; the caller decides how often the outlines are traced (see SweepWorker).
+      *
+      * Each cell also keeps its visit count and the time in which it was last seen. A visit is counted when
+      * the cell is covered for the first time, or again after revisitInterval seconds without being seen,
+      * so hovering over an area does not inflate its count. The swept area, the swept part of the mission
+      * boundary and the histogram of the visit counts are counters updated cell by cell as the cells are
+      * filled, so the statistics cost nothing more than the fill itself.
+      *
+      * The mission boundary is kept as one bit per cell, in the same tiles: a mission tile holds only this
+      * bitmask until it is swept, and the swept tiles outside the mission hold no mission bits at all.
+      *
+      * Each tile also counts its mission cells not swept yet, so the search of the nearest gap skips the tiles
+      * without any, and visits the others by increasing distance until no closer cell can be found: its cost
+      * depends on the number of tiles, not on the number of cells.
+      *
+      * Call the function fill() with each field of view polygon and the time in which it is seen
+      * Call the function outline() to get the swept regions as polygons
+      * Call the function setMission() to set the mission boundary, and getStats() to get the statistics
+      * Call the functions visits() and timeSinceSeen() to get the revisit data of a point
+      * Call the function gaps() to get the unswept regions of the mission, and nearestGap() to get its
+      * unswept cell nearest to a point
+      *
+      * \sa class Sweeper
+     */
+    class CoverageGrid {
+
+    public:
+
+        CoverageGrid(double = 1.0, int = 64);
+        void fill(const std::vector<double> &, const std::vector<double> &, double);
+        bool isDirty() const;
+        void outline(std::vector<polygon> &);
+        void setMission(const std::vector<double> &, const std::vector<double> &);
+        void setRevisitInterval(double);
+        void getStats(CoverageStats &) const;
+        void gaps(std::vector<polygon> &) const;
+        bool nearestGap(double, double, double &, double &) const;
+        int visits(double, double) const;
+        double timeSinceSeen(double, double, double) const;
+        double cellSize() const;
+        void clear();
+
+    private:
+
+        struct Tile
+        {
+            std::vector<uint8_t> covered;       /**< Allocated with visits and lastSeen on the first sweep */
+            std::vector<uint16_t> visits;
+            std::vector<float> lastSeen;        /**< Relative to the time of the first fill */
+            std::vector<uint64_t> mission;      /**< One bit per cell; empty if the tile is not in the mission */
+            int gaps = 0;                       /**< The number of mission cells not swept yet */
+            int swept = 0;                      /**< The number of swept cells */
+            int64_t key = 0;
+            bool changed = false;               /**< True if cells are swept since the last outline() */
+        };
+
+        static const int histogramBins = 8;
+
+        double cell, revisitInterval = 30.0, epoch = 0.0;
+        int tileSize;
+        int64_t sweptMinTx = 0, sweptMaxTx = -1, sweptMinTy = 0, sweptMaxTy = -1;
+        int64_t maskTx = 0, maskTy = 0;
+        int maskW = 0, maskH = 0;
+        cv::Mat sweptMask;
+        std::vector<int64_t> changedTiles;
+        bool dirty = false, started = false;
+        size_t coveredCells = 0, missionCells = 0, missionCovered = 0;
+        size_t histogram[histogramBins] = {};
+        std::unordered_map<int64_t, Tile> tiles;
+        std::vector<double> crossings;
+
+        static int64_t key(int64_t, int64_t);
+        int64_t tileOf(int64_t) const;
+        Tile &tile(int64_t, int64_t);
+        static bool inMission(const Tile &, size_t);
+        static bool isCovered(const Tile &, size_t);
+        const Tile *find(double, double, size_t &) const;
+        template <typename F> void scan(const std::vector<double> &, const std::vector<double> &, F);
+        void contours(const cv::Mat &, int64_t, int64_t, std::vector<polygon> &) const;
+    };
+}
+
+#endif //ANDROID_SCANNER_COVERAGEGRID_H
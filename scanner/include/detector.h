@@ -41,7 +41,8 @@ struct Object
 	        {
 	        REMAIN,
 	        ADD,
-	        UPDATE
+	        UPDATE,
+	        REMOVE
 	        };
     ObjectAction action = REMAIN;
 
@@ -55,10 +56,12 @@ struct Object
 	        CAR,
 	        FOV,
 	        SWEPT,
-	        MOVING
+	        MOVING,
+	        GAP
 	        } type;
 
 	int lastIdx = -1;
+	int id = -1;								/**< The object's persistent track id, -1 if it is not tracked */
     cv::Rect box;								/**< The object's bounding box in the image */
     cv::Mat picture;							/**< The object's cropped image */
     double distance = -1;						/**< The object's distance to the reference point */
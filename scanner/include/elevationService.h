@@ -0,0 +1,84 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#ifndef ANDROID_SCANNER_ELEVATIONSERVICE_H
+#define ANDROID_SCANNER_ELEVATIONSERVICE_H
+
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <thread>
+#include <condition_variable>
+#include <stdint.h>
+
+/**
+  * \scanner_module \ingroup Scanner_Module
+  * \class ElevationService
+  * \brief Provides the terrain elevation of a GPS location from the SRTM (HGT) tiles
+  *
+  * Each 1°×1° HGT tile (e.g. N35E051.hgt, 1201×1201 or 3601×3601 big-endian 16-bit posts) found in the
+  * tiles directory is memory-mapped on first use, so loading a tile costs no read nor copy; only the pages
+  * actually queried are brought into memory by the system. The mapped tiles are kept in a bounded LRU cache
+  * (missing tiles are cached as well, so they are not looked for again). All the queries are thread-safe;
+  * the cache lock is held only for the lookup, never while a tile is mapped.
+  *
+  * Batches of locations (FOV corners, object footprints, georeferencing grids) are queried at once with
+  * bilinear interpolation between the four surrounding posts. A background prefetcher maps the tiles
+  * ahead of the drone along its course and asks the system to read them in advance, so that crossing a
+  * tile border does not stall a scan.
+  *
+  * Call the function height() to get the elevation of a location (nearest post)
+  * Call the function heights() to get the interpolated elevations of a batch of locations
+  * Call the function prefetch() whenever the drone location, course and speed are updated
+  *
+  * \sa class Scanner
+ */
+class ElevationService {
+
+public:
+
+    static constexpr double NO_DATA = -32768;   /**< The elevation returned where no tile or post exists */
+
+    ElevationService(std::string, size_t = 20);
+    ~ElevationService();
+    double height(double, double);
+    void heights(const double*, const double*, double*, size_t);
+    void prefetch(double, double, double, double, double);
+
+private:
+
+    struct Tile
+    {
+        const uint8_t *data = nullptr;
+        size_t length = 0;
+        int samples = 0;
+        ~Tile();
+    };
+
+    typedef std::pair<int, std::shared_ptr<Tile>> CacheEntry;
+
+    std::string dir;
+    size_t cacheLimit;
+    std::mutex cacheMutex;
+    std::list<CacheEntry> lru;
+    std::unordered_map<int, std::list<CacheEntry>::iterator> cacheIndex;
+
+    std::thread prefetcher;
+    std::mutex prefetchMutex;
+    std::condition_variable prefetchCond;
+    std::vector<std::pair<int, int>> prefetchTiles;
+    bool prefetchPending = false, stopPrefetcher = false;
+
+    static int tileKey(int, int);
+    static std::string tileName(int, int);
+    std::shared_ptr<Tile> loadTile(int, int);
+    std::shared_ptr<Tile> getTile(int, int);
+    static double post(const Tile&, int, int);
+    void prefetchLoop();
+};
+
+#endif //ANDROID_SCANNER_ELEVATIONSERVICE_H
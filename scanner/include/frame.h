@@ -0,0 +1,89 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#ifndef ANDROID_SCANNER_FRAME_H
+#define ANDROID_SCANNER_FRAME_H
+
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <opencv2/core.hpp>
+
+/**
+  * \enum FrameFormat
+  * \brief The pixel layouts a camera frame may be received in
+ */
+enum FrameFormat {
+    FRAME_GRAY,     /**< One 8 bit luma channel */
+    FRAME_BGR,      /**< Three 8 bit channels, as produced by OpenCV */
+    FRAME_RGBA,     /**< Four 8 bit channels, as in an Android ARGB_8888 bitmap */
+    FRAME_YUV420    /**< An Android YUV_420_888 image: a full resolution luma plane and two half resolution
+                         chroma planes, with any row and pixel strides */
+};
+
+/**
+  * \scanner_module \ingroup Scanner_Module
+  * \class Frame
+  * \brief A camera frame which wraps the received pixel buffers and provides the planes its consumers need on
+  * demand
+  *
+  * A frame is created over the buffers it is received in, without copying them: a cv::Mat, or the plane
+  * buffers of a YUV_420_888 image (an Android Image or direct ByteBuffers). The luma plane and the BGR
+  * image are only produced when first requested, and then cached, so a consumer which only needs the luma
+  * plane (motion detection, velocity estimation) never pays for the colour conversion. The luma plane of a
+  * YUV frame is a view on the Y buffer itself.
+  *
+  * The copies of a Frame share the same buffers and cached planes. A frame over buffers it does not own
+  * (borrowed) is only valid while the caller keeps these buffers; call detach() before keeping it longer. It
+  * copies the source buffers once, without any conversion, and compacts the YUV planes into the NV21, NV12
+  * or I420 layout so the colour conversion runs in one pass. A frame wrapping a reference counted cv::Mat
+  * owns its data and detach() does nothing.
+  *
+  * The only consumers are in the Scanner module, which does not depend on Android; the JNI layer creates
+  * the frames.
+  *
+  * \sa class Logger
+ */
+class Frame {
+
+    enum Layout { NONE, NV21, NV12, I420 };
+
+    struct Planes
+    {
+        FrameFormat format = FRAME_GRAY;
+        int width = 0, height = 0;
+        bool borrowed = false;
+        cv::Mat image;                              // The GRAY, BGR or RGBA source
+        const uint8_t *y = nullptr, *u = nullptr, *v = nullptr;
+        int yRowStride = 0, uvRowStride = 0, uvPixelStride = 0;
+        Layout layout = NONE;                       // The layout of yuv, if the YUV planes are compact
+        cv::Mat yuv;                                // The compact YUV planes, height * 3 / 2 rows of width bytes
+        std::mutex mutex;
+        cv::Mat gray, bgr;
+    };
+
+    std::shared_ptr<Planes> planes;
+
+    static void compact(const Planes&, cv::Mat&, Layout&);
+    static Layout canonicalLayout(const Planes&);
+
+public:
+
+    Frame();
+    Frame(const cv::Mat&, FrameFormat);
+    static Frame fromYuv420(int, int, const uint8_t*, int, const uint8_t*, const uint8_t*, int, int);
+    static Frame fromNv21(const uint8_t*, int, int);
+
+    void detach();
+    bool empty() const;
+    bool borrowed() const;
+    FrameFormat format() const;
+    cv::Size size() const;
+    int cols() const;
+    int rows() const;
+    const cv::Mat &gray() const;
+    const cv::Mat &bgr() const;
+};
+
+#endif //ANDROID_SCANNER_FRAME_H
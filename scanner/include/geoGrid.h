@@ -0,0 +1,58 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#ifndef ANDROID_SCANNER_GEOGRID_H
+#define ANDROID_SCANNER_GEOGRID_H
+
+#include <vector>
+#include <stdint.h>
+#include <opencv2/core.hpp>
+#include "groundProjector.h"
+
+/**
+  * \scanner_module \ingroup Scanner_Module
+  * \class GeoGrid
+  * \brief The ground location of a coarse mesh of image points, projected once per image
+  *
+  * The mesh nodes (32×24 by default) span the whole image, the first and last ones lying on the image
+  * borders. The Scanner projects the nodes through the exact camera model (and the terrain, if enabled)
+  * with the pose of each image, and any module samples the grid instead of projecting points on its own:
+  * the ground location and the slant range of an image point are interpolated bilinearly between the four
+  * surrounding nodes. So all the modules share one consistent projection per image.
+  *
+  * Call the function configure() with the image resolution, then project the nodes given by nodeX() and
+  * nodeY() and call the function set() with the results
+  * Call the functions sample() and range() to get the ground location and the slant range of an image point
+  * Call the function footprint() to get the ground area covered by an image box
+  * Call the function groundRoi() to get the image region which is mapped on the ground within the range
+  *
+  * \sa class Scanner, class MotionDetector, class GroundProjector
+ */
+class GeoGrid {
+
+    int cols, rows, imgWidth = 0, imgHeight = 0;
+    bool valid = false;
+    double stamp = -1;
+    std::vector<float> pixelX, pixelY;
+    std::vector<double> groundX, groundY, ranges;
+    std::vector<uint8_t> show;
+
+    void locate(float, float, int&, int&, double&, double&) const;
+
+public:
+
+    GeoGrid(int = 32, int = 24);
+    void configure(int, int);
+    const std::vector<float> &nodeX() const;
+    const std::vector<float> &nodeY() const;
+    void set(const GroundProjector::Points&, double, double, double);
+    bool isValid() const;
+    double time() const;
+    bool sample(float, float, double&, double&, double&) const;
+    double range(float, float) const;
+    bool footprint(const cv::Rect&, double&) const;
+    cv::Rect groundRoi() const;
+};
+
+#endif //ANDROID_SCANNER_GEOGRID_H
@@ -0,0 +1,64 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#ifndef ANDROID_SCANNER_GROUNDPROJECTOR_H
+#define ANDROID_SCANNER_GROUNDPROJECTOR_H
+
+#include <vector>
+#include <stdint.h>
+#include "Eigen/Core"
+#include "cameraModel.h"
+
+/**
+  * \scanner_module \ingroup Scanner_Module
+  * \class GroundProjector
+  * \brief Projects batches of image points onto the ground plane under the camera
+  *
+  * The image points are given and the results are returned as separate arrays (structure of arrays). The
+  * camera rays of the points are looked up in the shared CameraModel, then processed in fixed-size lanes
+  * of Eigen arrays, so the rotation into the inertial frame and the intersection with the ground plane run
+  * in registers and are vectorized, without any heap allocation. The output arrays are kept by the caller
+  * and reused from call to call, so they are allocated only when a larger batch than ever before is
+  * projected.
+  *
+  * The inertial frame is the north, east, down frame centered on the camera.
+  *
+  * Call the function setCamera() to set the camera model
+  * Call the function rays() to get the unit inertial direction of each image point
+  * Call the function project() to get the ground point, distance and visibility of each image point
+  *
+  * \sa class Scanner, class CameraModel
+ */
+class GroundProjector {
+
+public:
+
+    /** \brief The projection results, one element per image point in each array
+     */
+    struct Points
+    {
+        std::vector<double> north;      /**< North offset from the camera in meters (or ray direction) */
+        std::vector<double> east;       /**< East offset from the camera in meters (or ray direction) */
+        std::vector<double> down;       /**< Down offset from the camera in meters (or ray direction) */
+        std::vector<double> distance;   /**< Horizontal distance from the camera in meters */
+        std::vector<uint8_t> show;      /**< 1 if the ray hits the ground within the maximum distance */
+
+        void resize(size_t);
+    };
+
+    void setCamera(const CameraModel*);
+    void rays(const float*, const float*, size_t, const Eigen::Matrix3d&, Points&) const;
+    void project(const float*, const float*, size_t, const Eigen::Matrix3d&, double, double, Points&) const;
+
+private:
+
+    static const int LANES = 8;
+    typedef Eigen::Array<double, LANES, 1> Lane;
+
+    const CameraModel *camera = nullptr;
+
+    void rayLane(const CameraModel::Rays&, const float*, const float*, size_t, size_t, const Eigen::Matrix3d&, Lane&, Lane&, Lane&) const;
+};
+
+#endif //ANDROID_SCANNER_GROUNDPROJECTOR_H
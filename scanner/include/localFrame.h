@@ -0,0 +1,49 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#ifndef ANDROID_SCANNER_LOCALFRAME_H
+#define ANDROID_SCANNER_LOCALFRAME_H
+
+#include <atomic>
+#include <mutex>
+#include <stddef.h>
+
+/**
+  * \scanner_module \ingroup Scanner_Module
+  * \class LocalFrame
+  * \brief A local East-North-Up tangent frame, anchored at the drone's initial location
+  *
+  * All the map geometry of the Scanner (object locations, association, swept area, motion normalization)
+  * is kept in meters in this frame; geodetic coordinates are calculated only for the output. The frame uses
+  * the WGS84 meridian and prime vertical radii of curvature at the anchor, so the conversion in either
+  * direction is linear: no series expansion nor trigonometric function per point, and no UTM zone, so a
+  * mission crossing a zone boundary is handled like any other. The east scale is that of the anchor
+  * latitude, so east distances are off by about tan(lat)·1.6e-4 of their length per km of north offset
+  * from the anchor, e.g. 11 cm for a 1 km east leg flown 1 km north of the anchor at 35° latitude.
+  *
+  * The frame is anchored once, by whichever thread maps a location first; the later anchor locations are
+  * ignored. Once anchored, the frame is only read, so the conversions need no lock.
+  *
+  * Call the function setOrigin() with the anchor location
+  * Call the function toLocal() to convert a geodetic location into the frame
+  * Call the function toGeodetic() to convert a batch of points of the frame into geodetic locations
+  *
+  * \sa class Scanner
+ */
+class LocalFrame {
+
+    double lat0 = 0.0, lng0 = 0.0;
+    double metersPerDegLat = 1.0, metersPerDegLng = 1.0;
+    std::atomic<bool> set{false};
+    std::mutex anchorMutex;
+
+public:
+
+    void setOrigin(double, double);
+    bool isSet() const;
+    void toLocal(double, double, double&, double&) const;
+    void toGeodetic(const double*, const double*, double*, double*, size_t) const;
+};
+
+#endif //ANDROID_SCANNER_LOCALFRAME_H
@@ -9,12 +9,24 @@
 #include <opencv2/core.hpp>
 #include <opencv2/opencv.hpp>
 #include <android/log.h>
+// Before UTM.h, whose pi macro breaks the Eigen headers included by the grid
+#include "cameraModel.h"
+#include "geoGrid.h"
 #include "Logger.h"
 #include "UTM.h"
 #include <math.h>
 #include "detector.h"
+#include "motionTracker.h"
 
-// TODO: It is much better that the MotionDetector class inherits Scanner in order to access its focal length and fov
+/**
+  * \enum MotionMethod
+  * \brief Different motion detection methods: Dense optical flow on the whole frame, or background subtraction
+  * with optical flow only inside the foreground blobs
+ */
+enum MotionMethod {
+    DENSE_FLOW,
+    BACKGROUND_SUBTRACTION
+};
 
 /**
   * \scanner_module \ingroup Scanner_Module
@@ -30,6 +42,12 @@
   * 3 - Generates a motion map; A gray scale image in which the brighter a pixel is, the faster the corresponding
   *     point on the ground moves
   * 4 - Provides a list of moving objects in the output, containing a bounding box for each
+  * 5 - Tracks the moving objects over consecutive images, providing a stable id and a smoothed velocity for each
+  *
+  * Two detection methods are available (see setMethod()). DENSE_FLOW calculates the optical flow on every
+  * pixel. BACKGROUND_SUBTRACTION finds the moving blobs using a background model on a reduced resolution
+  * image and calculates the optical flow only inside the blobs bounding boxes, which is much cheaper
+  * when a few objects move in a large static scene
   *
   * Call the function detect() to detect the moving objects within the input image and get the additional
   * details inside the objects list in output
@@ -39,16 +57,27 @@
 class MotionDetector{
 
     cv::Mat old_frame;
-    float hva, fl = 0.0, minimumDetectionSpeed = 1.5, objectSizeUpLimit = 0.25, objectSizeLowLimit = 0.002;
-    bool focalLengthSet = false, active = false;
+    const CameraModel *camera;
+    float minimumDetectionSpeed = 1.5, objectSizeUpLimit = 0.25, objectSizeLowLimit = 0.002;
+    double maxObjectArea = 400.0;
+    bool active = false;
     float objMaxSpeed = 3.0;
     double old_time;
+    int flowBands = 1, flowBandOverlap = 48;
+    MotionMethod method = DENSE_FLOW;
+    float bgScale = 0.5;
+    cv::Ptr<cv::BackgroundSubtractor> bgSubtractor;
+    MotionTracker tracker;
 
-    void visualize(const cv::Mat&, const cv::Mat&, const cv::Mat&, cv::Mat&, ImageSet&, std::vector<Object>&, const std::vector<Object>&, double);
-    void setFocalLength(int);
-    void calcNormCoeffMat(const std::vector<Object>&, double, double, double, cv::Mat&, cv::Mat&, double&);
+    void visualize(const cv::Mat&, const cv::Mat&, const cv::Mat&, cv::Mat&, ImageSet&, std::vector<Object>&, const std::vector<Object>&, double, const GeoGrid&);
+    void calcFlow(const cv::Mat&, const cv::Mat&, cv::Mat&);
+    void calcNormCoeffMat(const std::vector<Object>&, const GeoGrid&, cv::Mat&, cv::Mat&, double&, const cv::Rect&);
+    void detectForeground(ImageSet&, const cv::Mat&, cv::Mat&, std::vector<Object>&, const std::vector<Object>&, const GeoGrid&);
+    void trackObjects(std::vector<Object>&, cv::Mat&, double);
+    Object createMovingObject(const cv::Mat&, const cv::Rect&, const std::vector<Object>&, double, double, double);
 //    void generateMovingRects(cv::Mat&, cv::Mat&, std::vector<Object>&, const cv::Mat&, const cv::Mat&, const std::vector<Object>&, double, cv::Mat&);           //mm//
-    void generateMovingRects(cv::Mat&, cv::Mat&, std::vector<Object>&, const cv::Mat&, const cv::Mat&, const std::vector<Object>&, double);           //mm//
+    void generateMovingRects(const Frame&, cv::Mat&, std::vector<Object>&, const cv::Mat&, const cv::Mat&, const std::vector<Object>&, double, const GeoGrid&);           //mm//
+    bool onGround(const GeoGrid&, const cv::Rect&) const;
     void metricNormalize(Mat &);
     void saturateBox(int, int, cv::Rect&);
     void calcObjectsVelocities(Object&, const std::vector<Object>&, double, double, double);
@@ -57,8 +86,11 @@ class MotionDetector{
 
 public:
 
-    MotionDetector(float);
-    void detect(ImageSet&, cv::Mat&, std::vector<Object>&, const std::vector<Object>&, bool);
+    MotionDetector(const CameraModel*);
+    void setFlowBands(int);
+    void setMethod(MotionMethod, float = 0.5);
+    void release();
+    void detect(ImageSet&, cv::Mat&, std::vector<Object>&, const std::vector<Object>&, const GeoGrid&, bool);
 };
 
 #endif //ANDROID_SCANNER_MOTIONDETECTOR_H
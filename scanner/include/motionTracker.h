@@ -0,0 +1,59 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#ifndef ANDROID_SCANNER_MOTIONTRACKER_H
+#define ANDROID_SCANNER_MOTIONTRACKER_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/video/tracking.hpp>
+#include "detector.h"
+
+/**
+  * \scanner_module \ingroup Scanner_Module
+  * \class MotionTracker
+  * \brief Keeps the moving objects detected in consecutive images as persistent tracks
+  *
+  * Each track holds a constant velocity Kalman filter whose state is the object center in the image, its
+  * pixel velocity and its metric velocity on the ground. The camera is assumed to be in a fixed position,
+  * so the tracks are kept in image coordinates.
+  * This class handles the following tasks:
+  * 1 - Associates the new moving objects with the predicted tracks, using gated nearest neighbour
+  * 2 - Smooths the object position and metric speed with the track filter
+  * 3 - Confirms a track after minHits consecutive detections and deletes it after maxMisses missed images
+  * 4 - Provides the confirmed tracks with a stable id, coasting through short detection gaps
+  *
+  * Call the function update() with the moving objects of each image to replace them with the tracked ones
+  *
+  * \sa class MotionDetector
+ */
+class MotionTracker {
+
+    struct Track
+    {
+        int id;
+        cv::KalmanFilter kf;
+        Object object;
+        int hits = 1;
+        int misses = 0;
+        bool confirmed = false;
+    };
+
+    std::vector<Track> tracks;
+    int nextId = 0, minHits, maxMisses;
+    float gateRadius;
+    double lastTime = -1;
+
+    void initTrack(Track&, const Object&);
+    void predict(Track&, double);
+    void correct(Track&, const Object&);
+
+public:
+
+    MotionTracker(int = 3, int = 5, float = 60);
+    void update(std::vector<Object>&, double);
+    void reset();
+};
+
+#endif //ANDROID_SCANNER_MOTIONTRACKER_H
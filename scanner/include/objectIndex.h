@@ -0,0 +1,45 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#ifndef ANDROID_SCANNER_OBJECTINDEX_H
+#define ANDROID_SCANNER_OBJECTINDEX_H
+
+#include <vector>
+#include <stdint.h>
+#include <unordered_map>
+
+/**
+  * \scanner_module \ingroup Scanner_Module
+  * \class ObjectIndex
+  * \brief A uniform grid over the local frame, indexing the map objects by type and location
+  *
+  * Each cell is a square of the given size in meters, keyed on the object type and the cell coordinates
+  * in a hash map, so only the occupied cells are stored, however large the mission area is. With cells as
+  * large as the association gate, a query visits the 3×3 cells around the point and costs the same however
+  * many objects have been mapped since the beginning.
+  *
+  * Call the function insert() to index a map object, remove() to drop it and move() as it is relocated
+  * Call the function query() to get the objects of a type in the neighbourhood of a point
+  *
+  * \sa class Scanner
+ */
+class ObjectIndex {
+
+    double cell;
+    std::unordered_map<uint64_t, std::vector<int>> cells;
+
+    uint64_t key(int, int64_t, int64_t) const;
+    int64_t cellOf(double) const;
+
+public:
+
+    ObjectIndex(double = 3.0);
+    void clear();
+    void insert(int, int, double, double);
+    void remove(int, int, double, double);
+    void move(int, int, double, double, double, double);
+    void query(int, double, double, double, std::vector<int>&) const;
+};
+
+#endif //ANDROID_SCANNER_OBJECTINDEX_H
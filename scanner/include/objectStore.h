@@ -0,0 +1,59 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#ifndef ANDROID_SCANNER_OBJECTSTORE_H
+#define ANDROID_SCANNER_OBJECTSTORE_H
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include <unordered_map>
+#include "detector.h"
+#include "objectIndex.h"
+
+/**
+  * \scanner_module \ingroup Scanner_Module
+  * \class ObjectStore
+  * \brief Holds the objects of the online map, associates new detections with them and ages them out
+  *
+  * Each map object lives in a slot whose index is its stable id on the UI side (Object::lastIdx): it is
+  * given with the ADD action, with every UPDATE, and with the REMOVE action when the object is evicted;
+  * the slot may then be reused by a later ADD. The store keeps the time in which each object was last
+  * seen. Objects not seen for the maximum age are evicted, and when the store is full, the ones seen
+  * least recently are evicted first, so the map stays bounded however long the mission is.
+  *
+  * Each call of the function update() outputs only the changes since the previous call: REMOVE first,
+  * then ADD and UPDATE, so the output size depends on what changed and not on the mission length.
+  *
+  * Call the function setAgeing() to set the maximum age and the capacity
+  * Call the function update() with the mapped objects of each image to get the map changes
+  * Call the function clear() to drop all the map objects
+  *
+  * \sa class Scanner, class ObjectIndex
+ */
+class ObjectStore {
+
+    std::vector<Object> slots;
+    std::vector<double> lastSeen;
+    std::vector<uint8_t> used;
+    std::vector<int> freeSlots;
+    size_t count = 0, capacity;
+    double maxAge, gate;
+    ObjectIndex index;
+    std::unordered_map<int64_t, int> tracked;
+
+    static int64_t trackKey(const Object&);
+    int allocate();
+    void evict(int, std::vector<Object>&);
+
+public:
+
+    ObjectStore(double = 3.0, double = 600.0, size_t = 1000);
+    void setAgeing(double, size_t);
+    void update(std::vector<Object>&, double);
+    size_t size() const;
+    void clear();
+};
+
+#endif //ANDROID_SCANNER_OBJECTSTORE_H
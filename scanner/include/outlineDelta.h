@@ -0,0 +1,68 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#ifndef ANDROID_SCANNER_OUTLINEDELTA_H
+#define ANDROID_SCANNER_OUTLINEDELTA_H
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include "detector.h"
+
+/**
+  * \scanner_module \ingroup Scanner_Module
+  * \class OutlineDelta
+  * \brief Encodes the FOV and the swept area outline for the UI as versioned deltas in one compact buffer
+  *
+  * Each encoded state gets a new version. The UI acknowledges the last version it applied with the next
+  * call, and the swept area rings are encoded as the changes from that state: for each ring whose vertices
+  * differ, the common prefix and suffix are kept and only the vertices in between are replaced. As the
+  * swept area grows, most rings are unchanged and the others change locally, so the buffer size depends on
+  * what changed and not on the mission length. A keyframe (the whole state, with base version 0) is sent
+  * first, periodically, and whenever the acknowledged version is not the one the delta would be based on.
+  *
+  * The buffer is little endian (the native order of the Android ABIs); the coordinates are float offsets in
+  * degrees from the origin given in the header, which keeps them within a few millimeters:
+  *
+  *     uint32  version
+  *     uint32  base version, 0 for a keyframe: the client drops its rings first
+  *     float64 origin latitude, float64 origin longitude
+  *     uint32  FOV corner count, then the corners as (float32 latitude, float32 longitude) offsets
+  *     uint32  ring count after the changes: the client drops its rings beyond it
+  *     uint32  changed ring count, then for each changed ring:
+  *             uint32 ring index, int32 region, int32 ring in the region (0 outer, 1 and more the holes),
+  *             uint32 first replaced vertex, uint32 replaced vertex count,
+  *             uint32 new vertex count, then the new vertices as (float32, float32) offsets
+  *
+  * Call the function encode() with each FOV and swept area outline, and the version acknowledged by the UI
+  * Call the function reset() to force a keyframe, e.g. when the UI is recreated
+  *
+  * \sa class Scanner, class Sweeper
+ */
+class OutlineDelta {
+
+    struct Ring
+    {
+        int region = -1, ring = -1;
+        std::vector<double> lat, lng;
+    };
+
+    std::vector<Ring> base, sent, current;
+    uint32_t baseVersion = 0, sentVersion = 0, lastVersion = 0;
+    int keyframeInterval, sinceKeyframe = 0;
+    double originLat = 0, originLng = 0;
+
+    static void toRings(const std::vector<Object>&, std::vector<Ring>&);
+    template <typename T> static void put(std::vector<uint8_t>&, T);
+    void putVertex(std::vector<uint8_t>&, double, double) const;
+
+public:
+
+    OutlineDelta(int = 50);
+    uint32_t encode(const std::vector<Object>&, uint32_t, std::vector<uint8_t>&);
+    uint32_t version() const;
+    void reset();
+};
+
+#endif //ANDROID_SCANNER_OUTLINEDELTA_H
@@ -0,0 +1,59 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#ifndef ANDROID_SCANNER_RESULTPACKER_H
+#define ANDROID_SCANNER_RESULTPACKER_H
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include <opencv2/core.hpp>
+#include "detector.h"
+
+/**
+  * \scanner_module \ingroup Scanner_Module
+  * \class ResultPacker
+  * \brief Packs the mapped objects into a flat buffer of fixed size records, and their pictures into one atlas
+  *
+  * The UI provides one buffer (a direct ByteBuffer) which is reused from scan to scan, so no per object array
+  * nor bitmap is created to carry the results. The buffer is little endian (the native order of the Android
+  * ABIs): a 16 byte header, then one 64 byte record per object.
+  *
+  *     header: uint32 record count, uint32 record size, uint32 atlas width, uint32 atlas height
+  *     record: float64 latitude, float64 longitude, float64 altitude,          (offset 0)
+  *             float32 distance, float32 direction,                            (offset 24)
+  *             int32 type, int32 action, int32 lastIdx, int32 id,              (offset 32)
+  *             int16 atlas x, int16 atlas y, int16 atlas width, int16 atlas height (0 if no picture), (offset 48)
+  *             float32 east speed, float32 north speed                         (offset 56)
+  *
+  * The object pictures are scaled to fit a square of thumbSize pixels and packed row by row (shelf packing)
+  * into an RGBA atlas of atlasWidth pixels width (and at most 4096 pixels height, the common maximum texture
+  * size), whose rectangle of each object is given in its record.
+  *
+  * Call the function pack() after each scan, with the objects and the buffer
+  * Call the function atlas() to get the pictures atlas built by the last pack() call
+  *
+  * \sa class Scanner
+ */
+class ResultPacker {
+
+    static const int maxAtlasHeight = 4096;
+
+    int thumbSize, atlasWidth;
+    cv::Mat atlasImage;
+    std::vector<cv::Rect> rects;
+
+    void buildAtlas(const std::vector<Object>&);
+
+public:
+
+    static const size_t HEADER_SIZE = 16;   /**< The buffer header size in bytes */
+    static const size_t RECORD_SIZE = 64;   /**< The record size in bytes */
+
+    ResultPacker(int = 96, int = 1024);
+    size_t pack(const std::vector<Object>&, uint8_t*, size_t, bool);
+    const cv::Mat &atlas() const;
+};
+
+#endif //ANDROID_SCANNER_RESULTPACKER_H
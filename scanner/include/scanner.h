@@ -5,6 +5,7 @@
 #ifndef ANDROID_SCANNER_SCANNER_H
 #define ANDROID_SCANNER_SCANNER_H
 
+#include <atomic>
 #include <iostream>
 #include <opencv2/core.hpp>
 #include <opencv2/opencv.hpp>
@@ -13,15 +14,20 @@
 #include <android/log.h>
 #include <math.h>
 
-#include "grid.h"
-#include "nasagridsquare.h"
-#include "utils.h"
-
 #include "detector.h"
 #include "Logger.h"
 #include "sweeper.h"
+#include "sweepWorker.h"
 #include "UTM.h"
 #include "motionDetector.h"
+#include "velocityEstimator.h"
+#include "elevationService.h"
+#include "terrainRaycaster.h"
+#include "groundProjector.h"
+#include "geoGrid.h"
+#include "localFrame.h"
+#include "objectStore.h"
+#include "outlineDelta.h"
 
 /** \defgroup Scanner_Module Scanner module
 *
@@ -51,11 +57,14 @@ using namespace cv;
 * - This class handles the following tasks:
 *     -# Having camera info and IMU data, maps the camera FOV borders on the online map
 *     -# As camera moves, calculates the area swept by camera FOV since beginning, using "sweeper" class member
+*        maintained off the sensor callbacks by "sweepWorker" class member
 *     -# Synchronizes the multi-thread sensor data (GPS, IMU, Camera) using "Logger" class member
 *     -# Detects the desired objects (persons, cars, ...) using "detector" class member
 *     -# Detects moving objects using "motionDetector" class member
+*     -# Estimates the velocity of detected objects using "velocityEstimator" class member, if desired
 *     -# Calculates each object's position on map based on its position in the image
-*     -# Updates the existing map objects based on the last camera image
+*     -# Updates the existing map objects based on the last camera image, and ages out the ones not seen
+*        for a while, using "objectStore" class member
 *
 * - Call the function calcFov() to map the most recent FOV borders as well as previously swept area
 * - Call the function scan() to detect objects OR motion, and then map the desired objects on the online map
@@ -65,45 +74,73 @@ using namespace cv;
 class Scanner{
 
     float res, RAD, hva;
-    float f, cx, cy;
     double lastProcessStamp = -1; double lastProcessImgSetStamp = -1;
     std::string assets_dir;
-    int max_dist, zone;
-    bool initialInfoSet = false, isSouth = false, useElev = false;
-    Grid<NasaGridSquare> *grid;
-    std::vector<Object> objectPoses;
+    int max_dist;
+    bool initialInfoSet = false, userLocationSet = false, useElev = false;
+    std::atomic<bool> autoMotionGate{false}, detectionVelocity{false};     // Set from the UI thread
+    std::atomic<bool> terrainIntersection{false};
+    ElevationService *elevation;
+    TerrainRaycaster *terrain;
+    ObjectStore objectStore;
     std::vector<Object> fovPoses;
     Location userLocation = {.x = -1.0, .y = -1.0}, firstLocation = {.x = -1.0, .y = -1.0};
-    double lastFovTime = -1, fovDelay = 1.0;
+    double lastFovTime = -1, prefetchHorizon = 120.0;
+    std::atomic<double> fovDelay{1.0}, fovShift{2.0}, fovAngle{2.0 * PI / 180}, fovKeepalive{10.0};   // Set from the UI thread
+    double fovRange = 0, lastFovX = 0, lastFovY = 0;
+    ImuSet lastFovSet;
+    unsigned long sweptVersion = 0;
+    ImageSet lastVelocitySet;
+    CameraModel camera;
+    GroundProjector projector;
+    GroundProjector::Points gridPoints;     // Only used by the scan thread, see updateGeoGrid()
+    GeoGrid geoGrid;
+    LocalFrame frame;
 
 
     void camToMap(std::vector<Object>&, const ImageSet&);
-    bool scaleVector(Eigen::VectorXd, Eigen::VectorXd&, double);
-    void associate(std::vector<Object>&);
-    void gpsToUtm(double, double, double&, double&);
     void eulerToRotationMat(double, double, double, Eigen::Matrix3d&);
-    void calcDirVec(float, float, Eigen::VectorXd&);
-    void utmToGps(std::vector<Object>&);
+    void toGeodetic(std::vector<Object>&);
     void setInitialInfo(ImageSet&);
     bool elevDiff(double, double, double&);
+    void projectPoints(double, double, double, double, double, double, const float*, const float*, size_t, Eigen::Vector3d&,
+                       GroundProjector::Points&);
     void imageToMap(double, double, double, double, double, double, std::vector<Object>&);
+    void updateGeoGrid(const ImageSet&);
     void calcDistances(std::vector<Object>&);
+    void estimateVelocities(std::vector<Object>&, const ImageSet&);
+    bool fovChanged(const ImuSet&);
 
 public:
 
     Detector *detector;
     Logger *logger;
     SweeperGeometry::Sweeper *sweeper;
+    SweeperGeometry::SweepWorker *sweepWorker;
     MotionDetector *motionDetector;
+    VelocityEstimator *velocityEstimator;
 
     Scanner(std::string, std::string, DetectionMethod, int, float, int);
-    bool scan(std::vector<Object>&, Mat&, Mat&, int, bool, bool);
+    bool scan(std::vector<Object>&, Mat&, Mat&, int, bool);
     bool scan(ImageSet&, Mat&, Mat&, std::vector<Object>&, double);
     bool calcFov(std::vector<Object>&);
     bool calcFov(std::vector<Object>&, ImageSet&);
     void setReferenceLoc(double, double, bool );
     double elev();
     double elev(ImuSet &);
+    void setAutoMotionGate(bool);
+    void setDetectionVelocity(bool);
+    void setTerrainIntersection(bool);
+    void setLensDistortion(double, double);
+    void setObjectAgeing(double, int);
+    void setFovPolicy(double, double, double, double);
+    void setMissionBoundary(const std::vector<Location>&);
+    void getCoverageStats(SweeperGeometry::CoverageStats&) const;
+    void getCoverageGaps(std::vector<Object>&);
+    bool nearestGap(const Location&, Location&) const;
+    bool getCellRevisit(const Location&, double, int&, double&) const;
+    bool isStationary();
+    const GeoGrid &getGeoGrid() const;
 };
 
 
@@ -0,0 +1,59 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#ifndef ANDROID_SCANNER_STATIONARITYDETECTOR_H
+#define ANDROID_SCANNER_STATIONARITYDETECTOR_H
+
+#include <deque>
+#include <mutex>
+#include <math.h>
+
+/**
+  * \scanner_module \ingroup Scanner_Module
+  * \class StationarityDetector
+  * \brief Decides whether the camera is in a fixed position, based on the recent IMU and GPS data
+  *
+  * The orientations and locations received within a sliding time window are kept. The camera is
+  * considered stationary when the window is (almost) full and the standard deviations of the roll, pitch,
+  * azimuth and of the metric position inside the window are all below their limits. To avoid toggling
+  * around the limits, a stationary camera is considered moving only when a standard deviation exceeds
+  * its limit multiplied by a hysteresis factor. The camera is also considered moving once either sensor
+  * has not sent data for a timeout, so an interrupted stream does not keep a stale decision.
+  *
+  * The orientations and locations may be added from different sensor threads, and the decision read from
+  * the scan thread; the windows and the decision are guarded by one mutex.
+  *
+  * Call the functions addOrientation() and addLocation() as the sensor data is received
+  * Call the function isStationary() with the current time to get the last decision
+  *
+  * \sa class Logger, class MotionDetector
+ */
+class StationarityDetector {
+
+    struct Sample
+    {
+        double time;
+        double a, b, c;
+    };
+
+    std::deque<Sample> orientations, locations;
+    double window, maxAngleStd, maxPositionStd, timeout, hysteresis = 2.0;
+    double lastRawAzimuth = 0.0, locRefLat = 0.0, locRefLng = 0.0;
+    bool stationary = false;
+    mutable std::mutex mutex;
+
+    void push(std::deque<Sample>&, const Sample&);
+    bool windowFull(const std::deque<Sample>&, size_t) const;
+    static double stdDev(const std::deque<Sample>&, double Sample::*);
+    void evaluate();
+
+public:
+
+    StationarityDetector(double = 3.0, double = 0.01, double = 0.5, double = 1.0);
+    void addOrientation(double, double, double, double);
+    void addLocation(double, double, double, double);
+    bool isStationary(double) const;
+};
+
+#endif //ANDROID_SCANNER_STATIONARITYDETECTOR_H
@@ -0,0 +1,85 @@
+
+#ifndef ANDROID_SCANNER_SWEEPWORKER_H
+#define ANDROID_SCANNER_SWEEPWORKER_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "sweeper.h"
+
+namespace SweeperGeometry{
+
+    /**
+      * \scanner_module \ingroup Scanner_Module
+      * \struct SweepSnapshot
+      * \brief The sweeped area as published by the SweepWorker; never modified once published
+     */
+    struct SweepSnapshot
+    {
+        std::vector<Object> outline;            /**< The outline vertices in the local frame; see Sweeper::outline() */
+        CoverageStats stats;                    /**< The coverage statistics */
+        double time = -1;                       /**< The time of the last field of view merged */
+        unsigned long version = 0;              /**< Incremented each time the outline is traced again */
+    };
+
+    /**
+      * \scanner_module \ingroup Scanner_Module
+      * \class SweepWorker
+      * \brief Maintains the sweeped area on a background thread, off the sensor callbacks
+      *
+      * The fields of view are queued and return at once. The worker thread takes all the fields of view
+      * queued since its last pass as a batch, merges them into the Sweeper (see Sweeper::update() for
+      * batches) and publishes the statistics as a new snapshot. The outline is traced again at most once per
+      * outline interval of the fields of view time (see setOutlineInterval()); in between, a snapshot carries
+      * the previous outline. The snapshot pointer is
+      * swapped atomically, so snapshot() never waits for a merge in progress: it returns the latest published
+      * outline, which lags the queued fields of view by at most one batch. The other Sweeper queries are
+      * serialized with the merges.
+      *
+      * Call the function submit() with each new field of view
+      * Call the function snapshot() to get the latest sweeped area outline and statistics
+      * Call the functions setMission(), gaps(), nearestGap(), visits() and timeSinceSeen() instead of those of the
+      * Sweeper and its CoverageGrid
+      * Call the function flush() to wait until the queued fields of view are merged and traced, e.g. when a log
+      * is replayed
+      *
+      * \sa class Sweeper, class Scanner
+     */
+    class SweepWorker {
+
+    public:
+
+        SweepWorker(Sweeper *);
+        ~SweepWorker();
+        void submit(const std::vector<Object> &, double);
+        std::shared_ptr<const SweepSnapshot> snapshot() const;
+        void flush();
+        void setOutlineInterval(double);
+        void setMission(const std::vector<double> &, const std::vector<double> &);
+        void gaps(std::vector<Object> &);
+        bool nearestGap(double, double, Location &);
+        int visits(double, double);
+        double timeSinceSeen(double, double, double);
+
+    private:
+
+        Sweeper *sweeper;
+        std::shared_ptr<const SweepSnapshot> published;
+
+        std::thread worker;
+        std::mutex queueMutex, sweeperMutex;
+        std::condition_variable queueCond, idleCond;
+        std::vector<std::vector<Object>> pending;
+        std::vector<double> pendingTimes;
+        bool busy = false, stopWorker = false;
+        double outlineInterval = 1.0, lastOutlineTime = -1;
+
+        void workLoop();
+        void publish(double, bool);
+    };
+}
+
+#endif //ANDROID_SCANNER_SWEEPWORKER_H
@@ -14,26 +14,61 @@
 
 // TODO: included for "Location" structure. all typedefs must be moved to an external base header file.
 #include "Detector.h"
+#include "coverageGrid.h"
 
 namespace SweeperGeometry{
 
-    typedef boost::geometry::model::polygon<boost::geometry::model::d2::point_xy<double> > polygon;
     typedef boost::geometry::model::d2::point_xy<double> boost2dPoint;
+    typedef boost::geometry::model::multi_polygon<polygon> multi_polygon;
+
+    /**
+    * \enum SweepMode
+    * \brief How the swept area is accumulated: by polygon unions, or in a raster coverage grid
+    */
+    enum SweepMode
+    {
+        POLYGON_UNION,
+        RASTER
+    };
 
     class Sweeper {
 
     public:
 
-        void update(std::vector<Object> &, std::vector<Object> &);
+        void update(std::vector<Object> &, std::vector<Object> &, double);
+        void update(std::vector<Object> &, double);
+        void update(std::vector<std::vector<Object>> &, const std::vector<double> &);
+        void outline(std::vector<Object> &);
+        bool isDirty() const;
+        void gaps(std::vector<Object> &);
+        bool nearestGap(double, double, Location &) const;
+        void setMode(SweepMode);
+        void setCellSize(double);
+        void setSimplifyTolerance(double);
+        void setMission(const std::vector<double> &, const std::vector<double> &);
+        const CoverageGrid &getCoverage() const;
 
     private:
 
         static Location p0;
-        polygon sweeped_area;
-        bool isFirstPolygon = true;
+        double simplifyTolerance = 1.0;
+        multi_polygon sweeped_area;
+        SweepMode mode = RASTER;
+        bool merged = false;
+        CoverageGrid grid;
+        std::vector<polygon> regions, gapRegions;
+        std::vector<double> xs, ys;
+        std::vector<std::pair<double, size_t>> heap;
+        std::vector<size_t> prev, next;
+        std::vector<double> cost;
+        std::vector<uint8_t> keep;
 
-        static double dist(double, double, double, double);
-        void refineLocations(polygon &);
+        void fill(const std::vector<Object> &, double);
+        static void toPolygon(const std::vector<Object> &, polygon &);
+        void merge(const multi_polygon &);
+        void simplify(polygon &);
+        bool simplifyRing(polygon::ring_type &);
+        static void toObjects(const std::vector<polygon> &, Object::ObjectType, std::vector<Object> &);
 
     };
 }
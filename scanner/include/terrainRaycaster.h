@@ -0,0 +1,91 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#ifndef ANDROID_SCANNER_TERRAINRAYCASTER_H
+#define ANDROID_SCANNER_TERRAINRAYCASTER_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include "Eigen/Core"
+#include "elevationService.h"
+
+/**
+  * \scanner_module \ingroup Scanner_Module
+  * \class TerrainRaycaster
+  * \brief Intersects camera rays with the terrain surface given by the DEM
+  *
+  * A square height grid centered on the drone is sampled from the ElevationService, in a local metric
+  * frame (north, east, up) with the terrain surface bilinear inside each cell. On top of the grid, a
+  * pyramid of the cells maximum heights is built, each level halving the resolution. A ray is marched
+  * through the grid from the coarsest level: as long as the ray stays above the maximum height of the
+  * current pyramid cell, the whole cell is skipped at once. Only the finest cells which the ray may
+  * actually hit are tested against the bilinear surface (a ray ending below the cell minimum height hits
+  * it for sure), and the hit is refined by bisection.
+  *
+  * The grid is resampled only when the drone moves so far that the rays range is not inside it anymore.
+  * A grid is never modified once built: the new grid is built on a background thread, off the sensor
+  * callbacks, and the grid pointer is swapped atomically. The rays of a camera pose are cast through the
+  * grid returned by update(), which stays valid however long the caller keeps it. Until the new grid is
+  * ready, update() provides no grid and the caller falls back to the flat ground.
+  *
+  * Call the function update() with the drone location before casting the rays of a camera pose
+  * Call the function Grid::toLocal() to get the drone position in the grid frame
+  * Call the function Grid::cast() to intersect a ray with the terrain
+  *
+  * \sa class Scanner, class ElevationService
+ */
+class TerrainRaycaster {
+
+public:
+
+    /**
+      * \class Grid
+      * \brief A height grid along with its maximum heights pyramid; never modified once built
+     */
+    class Grid {
+
+        friend class TerrainRaycaster;
+
+        double cellSize = 0.0, half = 0.0, range = 0.0;
+        double centerLat = 0.0, centerLng = 0.0;
+        int size = 0;
+        bool valid = false;
+        std::vector<float> heights, cellMin;
+        std::vector<std::vector<float>> maxLevels;
+
+        bool covers(double, double, double) const;
+        double surface(double, double) const;
+        double cellExit(const Eigen::Vector3d&, const Eigen::Vector3d&, int, int, int) const;
+        bool refine(const Eigen::Vector3d&, const Eigen::Vector3d&, double, double, bool, double&) const;
+
+    public:
+
+        void toLocal(double, double, double&, double&) const;
+        bool cast(const Eigen::Vector3d&, const Eigen::Vector3d&, double, double&) const;
+    };
+
+    TerrainRaycaster(double = 8.0);
+    ~TerrainRaycaster();
+    std::shared_ptr<const Grid> update(ElevationService&, double, double, double);
+
+private:
+
+    double cellSize;
+    std::shared_ptr<const Grid> current;
+
+    std::thread builder;
+    std::mutex buildMutex;
+    std::condition_variable buildCond;
+    ElevationService *buildElevation = nullptr;
+    double buildLat = 0.0, buildLng = 0.0, buildRange = 0.0;
+    bool buildPending = false, stopBuilder = false;
+
+    std::shared_ptr<const Grid> build(ElevationService&, double, double, double) const;
+    void buildLoop();
+};
+
+#endif //ANDROID_SCANNER_TERRAINRAYCASTER_H
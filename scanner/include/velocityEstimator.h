@@ -0,0 +1,41 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#ifndef ANDROID_SCANNER_VELOCITYESTIMATOR_H
+#define ANDROID_SCANNER_VELOCITYESTIMATOR_H
+
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+#include "detector.h"
+
+/**
+  * \scanner_module \ingroup Scanner_Module
+  * \class VelocityEstimator
+  * \brief Estimates the image motion of detected objects using sparse optical flow
+  *
+  * A few good features are selected inside each object's bounding box in the current image, and tracked
+  * back into the previous image with the pyramidal Lucas-Kanade method. The median displacement of the
+  * tracked features is the object's displacement in the image since the previous image. Unlike the
+  * MotionDetector class, it works along with the object detection and does not need a fixed camera; the
+  * displacement is converted into a metric velocity by the Scanner class, using the camera pose of both
+  * images.
+  *
+  * Call the function estimate() with each new gray image and the objects detected within
+  *
+  * \sa class Scanner, class MotionDetector
+ */
+class VelocityEstimator {
+
+    cv::Mat prevGray;
+    int maxCorners = 20, minTracked = 3;
+
+public:
+
+    bool estimate(const cv::Mat&, const std::vector<Object>&, std::vector<cv::Point2f>&, std::vector<bool>&);
+    void reset();
+};
+
+#endif //ANDROID_SCANNER_VELOCITYESTIMATOR_H
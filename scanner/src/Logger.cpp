@@ -47,18 +47,21 @@ void Logger::disableLogMode()
 
 /** \brief Sets the input image and its time to receive as the last received image
 *
-* \param [in]   image   cv::Mat; The new camera image
+* \param [in]   frame   Frame; The new camera image. If it is borrowed, its buffers are copied once (see
+*                       Frame::detach()), so they can be released as soon as this function returns
 * \param [in]   time    Double; The exact time instant in which the image is received
 *
 * This function must be called once the camera image is received. If write-to-log mode is on, it
 * saves it in the log directory
 */
-void Logger::setImage(Mat &image, double time)
+void Logger::setImage(const Frame &frame, double time)
 {
-    if (readFromLog)
+    if (readFromLog || frame.empty())
         return;
 
-    img.image = image;
+    Frame kept = frame;
+    kept.detach();
+    img.frame = kept;
     img.time = time;
 
     if (logMode)
@@ -80,7 +83,7 @@ void Logger::writeImageSet(const ImageSet &imgSet)
     counter++;
     std::string imgName = "image" + std::to_string(counter) + ".jpg";
     std::string address = logsDir + imgName;
-    imwrite(address, imgSet.image);
+    imwrite(address, imgSet.frame.bgr());
     logFile.open(logsDir + "log.txt", std::ios::out | std::ios::in | std::ios::app);
     logFile << imgName << ',' << std::to_string(imgSet.time) << ',' << std::to_string(imgSet.lat) << ',' << std::to_string(imgSet.lng) \
             << ',' << std::to_string(imgSet.alt) << ',' << std::to_string(imgSet.roll) << ',' << std::to_string(imgSet.pitch) \
@@ -166,6 +169,7 @@ void Logger::setLocation(double lat, double lng, double alt, double time)
     loc.time = time;
 
     bufferLocation(loc);
+    stationarity.addLocation(lat, lng, alt, time);
 }
 
 /** \brief Sets the input IMU data and its time to receive as the last received orientation in a buffer
@@ -191,6 +195,7 @@ bool Logger::setOrientation(double roll, double pitch, double azimuth, double ti
     orn.time = time;
 
     bufferOrientation(orn);
+    stationarity.addOrientation(orn.roll, orn.pitch, orn.azimuth, time);
 
     return true;
 }
@@ -261,7 +266,7 @@ bool Logger::getImageSetFromLogger(ImageSet &imgSt, ImuSet &imuSt)
 
     readData(line_text, image, imuSt);
 
-    imgSt.image = image;
+    imgSt.frame = Frame(image, FRAME_BGR);
     imgSt.time = imuSt.time;
     imgSt.lat = imuSt.lat;
     imgSt.lng = imuSt.lng;
@@ -288,7 +293,7 @@ bool Logger::getImageSet(ImageSet &imgSet)
     Orientation orientation;
     double dist = 0, minDist = 1e7;
 
-    if (locationBuffer.empty() || orientationBuffer.empty() || img.image.empty())
+    if (locationBuffer.empty() || orientationBuffer.empty() || img.frame.empty())
     {
         return false;
     }
@@ -315,7 +320,7 @@ bool Logger::getImageSet(ImageSet &imgSet)
         }
     }
 
-    imgSet.image = img.image;
+    imgSet.frame = img.frame;
     imgSet.lat = location.lat;
     imgSet.lng = location.lng;
     imgSet.alt = location.alt;
@@ -341,7 +346,7 @@ bool Logger::getImuSet(ImuSet &imuSet)
     Location location;
     float dist = 0, minDist = 1e7;
 
-    if (orientationBuffer.empty() || locationBuffer.empty() || img.image.empty())
+    if (orientationBuffer.empty() || locationBuffer.empty() || img.frame.empty())
     {
         return false;
     }
@@ -365,4 +370,45 @@ bool Logger::getImuSet(ImuSet &imuSet)
     imuSet.time = orientationBuffer.back().time;
 
     return true;
-}
\ No newline at end of file
+}
+
+/** \brief Tells whether the camera is currently in a fixed position
+*
+* \returns      true if the variance of the orientations and locations received within the last few
+*               seconds is small enough, and the IMU and GPS data are still received at the time of the last
+*               image
+*
+* \sa class StationarityDetector
+*/
+bool Logger::isStationary()
+{
+    return stationarity.isStationary(img.time);
+}
+
+/** \brief Provides the drone ground speed and course from the buffered locations
+*
+* \param [out]  speed   The ground speed in m/s
+* \param [out]  course  The course in radians, clockwise from north
+*
+* \returns      true if at least two locations at different times are buffered
+*
+* The speed and course are calculated between the oldest and the newest buffered location, using a
+* local equirectangular approximation
+*/
+bool Logger::getGroundVelocity(double &speed, double &course)
+{
+    if (locationBuffer.size() < 2)
+        return false;
+
+    const Location &first = locationBuffer.front(), &last = locationBuffer.back();
+    double dt = last.time - first.time;
+    if (dt <= 0)
+        return false;
+
+    double north = (last.lat - first.lat) * PI / 180 * 6378137.0;
+    double east = (last.lng - first.lng) * PI / 180 * 6378137.0 * cos(first.lat * PI / 180);
+
+    speed = sqrt(north*north + east*east) / dt;
+    course = atan2(east, north);
+    return true;
+}
@@ -15,8 +15,95 @@
 // 
 // 1) http://home.hiwaay.net/~taylorc/toolbox/geography/geoutm.html
 
+#include <algorithm>
+#include "Eigen/Core"
 #include "UTM.h"
 
+// Ellipsoid dependent constants of the series below, calculated once instead of on every call.
+static const double utm_n = (sm_a - sm_b) / (sm_a + sm_b);
+static const double utm_n2 = utm_n * utm_n, utm_n3 = utm_n2 * utm_n, utm_n4 = utm_n3 * utm_n, utm_n5 = utm_n4 * utm_n;
+
+// ArcLengthOfMeridian (Eq. 10.17)
+static const double arc_alpha = ((sm_a + sm_b) / 2.0) * (1.0 + utm_n2 / 4.0 + utm_n4 / 64.0);
+static const double arc_beta = -3.0 * utm_n / 2.0 + 9.0 * utm_n3 / 16.0 - 3.0 * utm_n5 / 32.0;
+static const double arc_gamma = 15.0 * utm_n2 / 16.0 - 15.0 * utm_n4 / 32.0;
+static const double arc_delta = -35.0 * utm_n3 / 48.0 + 105.0 * utm_n5 / 256.0;
+static const double arc_epsilon = 315.0 * utm_n4 / 512.0;
+
+// FootpointLatitude (Eq. 10.22)
+static const double fp_beta = 3.0 * utm_n / 2.0 - 27.0 * utm_n3 / 32.0 + 269.0 * utm_n5 / 512.0;
+static const double fp_gamma = 21.0 * utm_n2 / 16.0 - 55.0 * utm_n4 / 32.0;
+static const double fp_delta = 151.0 * utm_n3 / 96.0 - 417.0 * utm_n5 / 128.0;
+static const double fp_epsilon = 1097.0 * utm_n4 / 512.0;
+
+// Second eccentricity squared, and a^2/b of the radius of curvature N
+static const double utm_ep2 = (sm_a * sm_a - sm_b * sm_b) / (sm_b * sm_b);
+static const double utm_a2b = sm_a * sm_a / sm_b;
+
+// SinSeries
+// Evaluates b1 sin(theta) + b2 sin(2 theta) + b3 sin(3 theta) + b4 sin(4 theta) with the Clenshaw
+// recurrence, from sin(theta) and cos(theta) only.
+template <typename T, typename S>
+static inline T SinSeries(const T &s, const T &c, S b1, S b2, S b3, S b4) {
+  T X = 2 * c;
+  T u3 = b3 + X * b4;
+  T u2 = b2 + X * u3 - b4;
+  T u1 = b1 + X * u2 - u3;
+  return u1 * s;
+}
+
+// MapLatLonToXYCore
+// The body of MapLatLonToXY, shared by the scalar and the batch (Eigen array) versions. The series in l
+// are evaluated in Horner form in (cos(phi) l)^2.
+template <typename T, typename S>
+static inline void MapLatLonToXYCore(const T &phi, const T &l, T &x, T &y) {
+  T s = SIN(phi), c = COS(phi);
+  T t = s / c, t2 = t * t, t4 = t2 * t2;
+  T nu2 = S(utm_ep2) * c * c;
+  T N = S(utm_a2b) / SQRT(1 + nu2);
+
+  T sin2 = 2 * s * c, cos2 = c * c - s * s;
+  T arc = S(arc_alpha) * (phi + SinSeries<T, S>(sin2, cos2, arc_beta, arc_gamma, arc_delta, arc_epsilon));
+
+  T l3coef = 1 - t2 + nu2;
+  T l4coef = 5 - t2 + 9 * nu2 + 4 * nu2 * nu2;
+  T l5coef = 5 - 18 * t2 + t4 + 14 * nu2 - 58 * t2 * nu2;
+  T l6coef = 61 - 58 * t2 + t4 + 270 * nu2 - 330 * t2 * nu2;
+  T l7coef = 61 - 479 * t2 + 179 * t4 - t4 * t2;
+  T l8coef = 1385 - 3111 * t2 + 543 * t4 - t4 * t2;
+
+  T cl = c * l, cl2 = cl * cl;
+  x = N * cl * (1 + cl2 * (l3coef / 6 + cl2 * (l5coef / 120 + cl2 * l7coef / 5040)));
+  y = arc + t * N * cl2 * (S(0.5) + cl2 * (l4coef / 24 + cl2 * (l6coef / 720 + cl2 * l8coef / 40320)));
+}
+
+// MapXYToLatLonCore
+// The body of MapXYToLatLon, shared by the scalar and the batch (Eigen array) versions. The series in x
+// are evaluated in Horner form in (x / Nf)^2.
+template <typename T, typename S>
+static inline void MapXYToLatLonCore(const T &x, const T &y, S lambda0, T &phi, T &lambda) {
+  T y_ = y * S(1.0 / arc_alpha);
+  T sy = SIN(2 * y_), cy = COS(2 * y_);
+  T phif = y_ + SinSeries<T, S>(sy, cy, fp_beta, fp_gamma, fp_delta, fp_epsilon);
+
+  T sf = SIN(phif), cf = COS(phif);
+  T tf = sf / cf, tf2 = tf * tf, tf4 = tf2 * tf2;
+  T nuf2 = S(utm_ep2) * cf * cf;
+  T Nf = S(utm_a2b) / SQRT(1 + nuf2);
+
+  T x2poly = -1 - nuf2;
+  T x3poly = -1 - 2 * tf2 - nuf2;
+  T x4poly = 5 + 3 * tf2 + 6 * nuf2 - 6 * tf2 * nuf2 - 3 * nuf2 * nuf2 - 9 * tf2 * nuf2 * nuf2;
+  T x5poly = 5 + 28 * tf2 + 24 * tf4 + 6 * nuf2 + 8 * tf2 * nuf2;
+  T x6poly = -61 - 90 * tf2 - 45 * tf4 - 107 * nuf2 + 162 * tf2 * nuf2;
+  T x7poly = -61 - 662 * tf2 - 1320 * tf4 - 720 * tf4 * tf2;
+  T x8poly = 1385 + 3633 * tf2 + 4095 * tf4 + 1575 * tf4 * tf2;
+
+  T u = x / Nf, u2 = u * u;
+  phi = phif + tf * u2 * (x2poly / 2 + u2 * (x4poly / 24 + u2 * (x6poly / 720 + u2 * x8poly / 40320)));
+  lambda = lambda0 + u / cf * (1 + u2 * (x3poly / 6 + u2 * (x5poly / 120 + u2 * x7poly / 5040)));
+}
+
 // DegToRad
 // Converts degrees to radians.
 FLOAT DegToRad(FLOAT deg) {
@@ -47,39 +134,8 @@ FLOAT RadToDeg(FLOAT rad) {
 // Returns:
 //     The ellipsoidal distance of the point from the equator, in meters.
 FLOAT ArcLengthOfMeridian (FLOAT phi) {
-  FLOAT alpha, beta, gamma, delta, epsilon, n;
-  FLOAT result;
-  
-  /* Precalculate n */
-  n = (sm_a - sm_b) / (sm_a + sm_b);
-  
-  /* Precalculate alpha */
-  alpha = ((sm_a + sm_b) / 2.0)
-        * (1.0 + (POW(n, 2.0) / 4.0) + (POW(n, 4.0) / 64.0));
-  
-  /* Precalculate beta */
-  beta = (-3.0 * n / 2.0) + (9.0 * POW(n, 3.0) / 16.0)
-       + (-3.0 * POW(n, 5.0) / 32.0);
-  
-  /* Precalculate gamma */
-  gamma = (15.0 * POW(n, 2.0) / 16.0)
-        + (-15.0 * POW(n, 4.0) / 32.0);
-  
-  /* Precalculate delta */
-  delta = (-35.0 * POW(n, 3.0) / 48.0)
-      + (105.0 * POW(n, 5.0) / 256.0);
-  
-  /* Precalculate epsilon */
-  epsilon = (315.0 * POW(n, 4.0) / 512.0);
-  
-  /* Now calculate the sum of the series and return */
-  result = alpha
-         * (phi + (beta * SIN(2.0 * phi))
-         + (gamma * SIN(4.0 * phi))
-         + (delta * SIN(6.0 * phi))
-         + (epsilon * SIN(8.0 * phi)));
-  
-  return result;
+  FLOAT s = SIN(phi), c = COS(phi);
+  return arc_alpha * (phi + SinSeries<FLOAT, FLOAT>(2 * s * c, c * c - s * s, arc_beta, arc_gamma, arc_delta, arc_epsilon));
 }
 
 
@@ -116,42 +172,8 @@ FLOAT UTMCentralMeridian(int zone) {
 // Returns:
 //   The footpoint latitude, in radians.
 FLOAT FootpointLatitude(FLOAT y) {
-  FLOAT y_, alpha_, beta_, gamma_, delta_, epsilon_, n;
-  FLOAT result;
-  
-  /* Precalculate n (Eq. 10.18) */
-  n = (sm_a - sm_b) / (sm_a + sm_b);
-    
-  /* Precalculate alpha_ (Eq. 10.22) */
-  /* (Same as alpha in Eq. 10.17) */
-  alpha_ = ((sm_a + sm_b) / 2.0)
-         * (1 + (POW(n, 2.0) / 4) + (POW(n, 4.0) / 64));
-  
-  /* Precalculate y_ (Eq. 10.23) */
-  y_ = y / alpha_;
-  
-  /* Precalculate beta_ (Eq. 10.22) */
-  beta_ = (3.0 * n / 2.0) + (-27.0 * POW(n, 3.0) / 32.0)
-        + (269.0 * POW(n, 5.0) / 512.0);
-  
-  /* Precalculate gamma_ (Eq. 10.22) */
-  gamma_ = (21.0 * POW(n, 2.0) / 16.0)
-         + (-55.0 * POW(n, 4.0) / 32.0);
-    
-  /* Precalculate delta_ (Eq. 10.22) */
-  delta_ = (151.0 * POW(n, 3.0) / 96.0)
-         + (-417.0 * POW(n, 5.0) / 128.0);
-    
-  /* Precalculate epsilon_ (Eq. 10.22) */
-  epsilon_ = (1097.0 * POW(n, 4.0) / 512.0);
-    
-  /* Now calculate the sum of the series (Eq. 10.21) */
-  result = y_ + (beta_ * SIN(2.0 * y_))
-         + (gamma_ * SIN(4.0 * y_))
-         + (delta_ * SIN(6.0 * y_))
-         + (epsilon_ * SIN(8.0 * y_));
-  
-  return result;
+  FLOAT y_ = y / arc_alpha;
+  return y_ + SinSeries<FLOAT, FLOAT>(SIN(2 * y_), COS(2 * y_), fp_beta, fp_gamma, fp_delta, fp_epsilon);
 }
 
 
@@ -176,59 +198,7 @@ FLOAT FootpointLatitude(FLOAT y) {
 // Returns:
 //    The function does not return a value.
 void MapLatLonToXY (FLOAT phi, FLOAT lambda, FLOAT lambda0, FLOAT &x, FLOAT &y) {
-    FLOAT N, nu2, ep2, t, t2, l;
-    FLOAT l3coef, l4coef, l5coef, l6coef, l7coef, l8coef;
-    //FLOAT tmp; // Unused
-
-    /* Precalculate ep2 */
-    ep2 = (POW(sm_a, 2.0) - POW(sm_b, 2.0)) / POW(sm_b, 2.0);
-
-    /* Precalculate nu2 */
-    nu2 = ep2 * POW(COS(phi), 2.0);
-
-    /* Precalculate N */
-    N = POW(sm_a, 2.0) / (sm_b * SQRT(1 + nu2));
-
-    /* Precalculate t */
-    t = TAN(phi);
-    t2 = t * t;
-    //tmp = (t2 * t2 * t2) - POW(t, 6.0); // Unused
-
-    /* Precalculate l */
-    l = lambda - lambda0;
-
-    /* Precalculate coefficients for l**n in the equations below
-       so a normal human being can read the expressions for easting
-       and northing
-       -- l**1 and l**2 have coefficients of 1.0 */
-    l3coef = 1.0 - t2 + nu2;
-
-    l4coef = 5.0 - t2 + 9 * nu2 + 4.0 * (nu2 * nu2);
-
-    l5coef = 5.0 - 18.0 * t2 + (t2 * t2) + 14.0 * nu2
-        - 58.0 * t2 * nu2;
-
-    l6coef = 61.0 - 58.0 * t2 + (t2 * t2) + 270.0 * nu2
-        - 330.0 * t2 * nu2;
-
-    l7coef = 61.0 - 479.0 * t2 + 179.0 * (t2 * t2) - (t2 * t2 * t2);
-
-    l8coef = 1385.0 - 3111.0 * t2 + 543.0 * (t2 * t2) - (t2 * t2 * t2);
-
-    /* Calculate easting (x) */
-    x = N * COS(phi) * l
-        + (N / 6.0 * POW(COS(phi), 3.0) * l3coef * POW(l, 3.0))
-        + (N / 120.0 * POW(COS(phi), 5.0) * l5coef * POW(l, 5.0))
-        + (N / 5040.0 * POW(COS(phi), 7.0) * l7coef * POW(l, 7.0));
-
-    /* Calculate northing (y) */
-    y = ArcLengthOfMeridian (phi)
-        + (t / 2.0 * N * POW(COS(phi), 2.0) * POW(l, 2.0))
-        + (t / 24.0 * N * POW(COS(phi), 4.0) * l4coef * POW(l, 4.0))
-        + (t / 720.0 * N * POW(COS(phi), 6.0) * l6coef * POW(l, 6.0))
-        + (t / 40320.0 * N * POW(COS(phi), 8.0) * l8coef * POW(l, 8.0));
-
-    return;
+  MapLatLonToXYCore<FLOAT, FLOAT>(phi, lambda - lambda0, x, y);
 }
 
 
@@ -252,98 +222,8 @@ void MapLatLonToXY (FLOAT phi, FLOAT lambda, FLOAT lambda0, FLOAT &x, FLOAT &y)
 //
 // Returns:
 //   The function does not return a value.
-//
-// Remarks:
-//   The local variables Nf, nuf2, tf, and tf2 serve the same purpose as
-//   N, nu2, t, and t2 in MapLatLonToXY, but they are computed with respect
-//   to the footpoint latitude phif.
-//
-//   x1frac, x2frac, x2poly, x3poly, etc. are to enhance readability and
-//   to optimize computations.
-void MapXYToLatLon (FLOAT x, FLOAT y, FLOAT lambda0, FLOAT& phi, FLOAT& lambda)
-{
-  FLOAT phif, Nf, Nfpow, nuf2, ep2, tf, tf2, tf4, cf;
-  FLOAT x1frac, x2frac, x3frac, x4frac, x5frac, x6frac, x7frac, x8frac;
-  FLOAT x2poly, x3poly, x4poly, x5poly, x6poly, x7poly, x8poly;
-  
-  /* Get the value of phif, the footpoint latitude. */
-  phif = FootpointLatitude (y);
-    
-  /* Precalculate ep2 */
-  ep2 = (POW(sm_a, 2.0) - POW(sm_b, 2.0))
-      / POW(sm_b, 2.0);
-    
-  /* Precalculate cos (phif) */
-  cf = COS(phif);
-    
-  /* Precalculate nuf2 */
-  nuf2 = ep2 * POW(cf, 2.0);
-    
-  /* Precalculate Nf and initialize Nfpow */
-  Nf = POW(sm_a, 2.0) / (sm_b * SQRT(1 + nuf2));
-  Nfpow = Nf;
-    
-  /* Precalculate tf */
-  tf = TAN(phif);
-  tf2 = tf * tf;
-  tf4 = tf2 * tf2;
-  
-  /* Precalculate fractional coefficients for x**n in the equations
-     below to simplify the expressions for latitude and longitude. */
-  x1frac = 1.0 / (Nfpow * cf);
-  
-  Nfpow *= Nf;   /* now equals Nf**2) */
-  x2frac = tf / (2.0 * Nfpow);
-  
-  Nfpow *= Nf;   /* now equals Nf**3) */
-  x3frac = 1.0 / (6.0 * Nfpow * cf);
-  
-  Nfpow *= Nf;   /* now equals Nf**4) */
-  x4frac = tf / (24.0 * Nfpow);
-  
-  Nfpow *= Nf;   /* now equals Nf**5) */
-  x5frac = 1.0 / (120.0 * Nfpow * cf);
-  
-  Nfpow *= Nf;   /* now equals Nf**6) */
-  x6frac = tf / (720.0 * Nfpow);
-  
-  Nfpow *= Nf;   /* now equals Nf**7) */
-  x7frac = 1.0 / (5040.0 * Nfpow * cf);
-  
-  Nfpow *= Nf;   /* now equals Nf**8) */
-  x8frac = tf / (40320.0 * Nfpow);
-  
-  /* Precalculate polynomial coefficients for x**n.
-     -- x**1 does not have a polynomial coefficient. */
-  x2poly = -1.0 - nuf2;
-  
-  x3poly = -1.0 - 2 * tf2 - nuf2;
-  
-  x4poly = 5.0 + 3.0 * tf2 + 6.0 * nuf2 - 6.0 * tf2 * nuf2
-         - 3.0 * (nuf2 *nuf2) - 9.0 * tf2 * (nuf2 * nuf2);
-  
-  x5poly = 5.0 + 28.0 * tf2 + 24.0 * tf4 + 6.0 * nuf2 + 8.0 * tf2 * nuf2;
-  
-  x6poly = -61.0 - 90.0 * tf2 - 45.0 * tf4 - 107.0 * nuf2
-         + 162.0 * tf2 * nuf2;
-  
-  x7poly = -61.0 - 662.0 * tf2 - 1320.0 * tf4 - 720.0 * (tf4 * tf2);
-  
-  x8poly = 1385.0 + 3633.0 * tf2 + 4095.0 * tf4 + 1575 * (tf4 * tf2);
-    
-  /* Calculate latitude */
-  phi = phif + x2frac * x2poly * (x * x)
-      + x4frac * x4poly * POW(x, 4.0)
-      + x6frac * x6poly * POW(x, 6.0)
-      + x8frac * x8poly * POW(x, 8.0);
-    
-  /* Calculate longitude */
-  lambda = lambda0 + x1frac * x
-         + x3frac * x3poly * POW(x, 3.0)
-         + x5frac * x5poly * POW(x, 5.0)
-         + x7frac * x7poly * POW(x, 7.0);
-    
-  return;
+void MapXYToLatLon (FLOAT x, FLOAT y, FLOAT lambda0, FLOAT& phi, FLOAT& lambda) {
+  MapXYToLatLonCore<FLOAT, FLOAT>(x, y, lambda0, phi, lambda);
 }
 
 
@@ -354,8 +234,8 @@ void MapXYToLatLon (FLOAT x, FLOAT y, FLOAT lambda0, FLOAT& phi, FLOAT& lambda)
 // Universal Transverse Mercator projection.
 //
 // Inputs:
-//   lat - Latitude of the point, in radians.
-//   lon - Longitude of the point, in radians.
+//   lat - Latitude of the point, in degrees.
+//   lon - Longitude of the point, in degrees.
 //   zone - UTM zone to be used for calculating values for x and y.
 //          If zone is less than 1 or greater than 60, the routine
 //          will determine the appropriate zone from the value of lon.
@@ -419,3 +299,72 @@ void UTMXYToLatLon (FLOAT x, FLOAT y, int zone, bool southhemi, FLOAT& lat, FLOA
   return;
 }
 
+
+
+// Batch conversions
+// The points are processed in chunks of up to UTM_CHUNK points held in stack allocated Eigen arrays, so
+// sin, cos, sqrt and the divisions run on whole chunks (vectorized with NEON/SSE) with no heap allocation.
+#define UTM_CHUNK 64
+
+template <typename T>
+static int LatLonToUTMXYBatch (const T *lat, const T *lon, size_t n, int zone, T *x, T *y) {
+  typedef Eigen::Array<T, Eigen::Dynamic, 1, 0, UTM_CHUNK, 1> Chunk;
+  typedef Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>> ConstMap;
+  typedef Eigen::Map<Eigen::Array<T, Eigen::Dynamic, 1>> Map;
+
+  if (n == 0)
+    return zone;
+  if ( (zone < 1) || (zone > 60) )
+    zone = (int) floor((lon[0] + 180.0) / 6) + 1;
+
+  const T d2r = T(pi / 180.0), lambda0 = T((-183.0 + zone * 6.0) * pi / 180.0);
+  for (size_t s = 0; s < n; s += UTM_CHUNK) {
+    Eigen::Index m = (Eigen::Index) std::min((size_t) UTM_CHUNK, n - s);
+    Chunk phi = ConstMap(lat + s, m) * d2r;
+    Chunk l = ConstMap(lon + s, m) * d2r - lambda0;
+    Chunk cx(m), cy(m);
+    MapLatLonToXYCore<Chunk, T>(phi, l, cx, cy);
+
+    Map(x + s, m) = cx * T(UTMScaleFactor) + T(500000.0);
+    cy *= T(UTMScaleFactor);
+    Map(y + s, m) = (cy < 0).select(cy + T(10000000.0), cy);
+  }
+
+  return zone;
+}
+
+template <typename T>
+static void UTMXYToLatLonBatch (const T *x, const T *y, size_t n, int zone, bool southhemi, T *lat, T *lon) {
+  typedef Eigen::Array<T, Eigen::Dynamic, 1, 0, UTM_CHUNK, 1> Chunk;
+  typedef Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>> ConstMap;
+  typedef Eigen::Map<Eigen::Array<T, Eigen::Dynamic, 1>> Map;
+
+  const T lambda0 = T((-183.0 + zone * 6.0) * pi / 180.0);
+  const T yOffset = T(southhemi ? 10000000.0 : 0.0);
+  for (size_t s = 0; s < n; s += UTM_CHUNK) {
+    Eigen::Index m = (Eigen::Index) std::min((size_t) UTM_CHUNK, n - s);
+    Chunk cx = (ConstMap(x + s, m) - T(500000.0)) * T(1.0 / UTMScaleFactor);
+    Chunk cy = (ConstMap(y + s, m) - yOffset) * T(1.0 / UTMScaleFactor);
+    Chunk phi(m), lambda(m);
+    MapXYToLatLonCore<Chunk, T>(cx, cy, lambda0, phi, lambda);
+
+    Map(lat + s, m) = phi;
+    Map(lon + s, m) = lambda;
+  }
+}
+
+int LatLonToUTMXY (const double *lat, const double *lon, size_t n, int zone, double *x, double *y) {
+  return LatLonToUTMXYBatch<double>(lat, lon, n, zone, x, y);
+}
+
+int LatLonToUTMXY (const float *lat, const float *lon, size_t n, int zone, float *x, float *y) {
+  return LatLonToUTMXYBatch<float>(lat, lon, n, zone, x, y);
+}
+
+void UTMXYToLatLon (const double *x, const double *y, size_t n, int zone, bool southhemi, double *lat, double *lon) {
+  UTMXYToLatLonBatch<double>(x, y, n, zone, southhemi, lat, lon);
+}
+
+void UTMXYToLatLon (const float *x, const float *y, size_t n, int zone, bool southhemi, float *lat, float *lon) {
+  UTMXYToLatLonBatch<float>(x, y, n, zone, southhemi, lat, lon);
+}
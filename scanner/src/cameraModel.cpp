@@ -0,0 +1,195 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include "cameraModel.h"
+
+/** \brief Constructor; sets the view angle and the ray table resolution
+*
+* \param [in]   hva_    Camera horizontal view angle in degrees
+* \param [in]   step_   The spacing of the ray table grid in pixels
+*/
+CameraModel::CameraModel(float hva_, int step_)
+{
+    hva = hva_;
+    step = std::max(1, step_);
+    table = std::make_shared<const Rays>();
+}
+
+/** \brief Sets the camera horizontal view angle; the ray table is rebuilt if it changes
+*
+* \param [in]   hva_    Camera horizontal view angle in degrees
+*/
+void CameraModel::setViewAngle(float hva_)
+{
+    std::lock_guard<std::mutex> lock(buildMutex);
+    if (hva_ == hva)
+        return;
+    hva = hva_;
+    if (built)
+        build();
+}
+
+/** \brief Sets the radial lens distortion; the ray table is rebuilt if it changes
+*
+* \param [in]   k1_     The second order radial distortion coefficient
+* \param [in]   k2_     The fourth order radial distortion coefficient
+*/
+void CameraModel::setDistortion(double k1_, double k2_)
+{
+    std::lock_guard<std::mutex> lock(buildMutex);
+    if (k1_ == k1 && k2_ == k2)
+        return;
+    k1 = k1_;
+    k2 = k2_;
+    if (built)
+        build();
+}
+
+/** \brief Sets the image resolution; the ray table is rebuilt if it changes
+*
+* \param [in]   width   The image width in pixels
+* \param [in]   height  The image height in pixels
+*
+* \returns      true if the ray table is (re)built
+*/
+bool CameraModel::configure(int width, int height)
+{
+    std::lock_guard<std::mutex> lock(buildMutex);
+    if (built && width == imgWidth && height == imgHeight)
+        return false;
+    imgWidth = width;
+    imgHeight = height;
+    build();
+    return true;
+}
+
+/** \brief Tells whether a ray table is built, i.e. configure() is called
+*/
+bool CameraModel::isConfigured() const
+{
+    return rays()->valid();
+}
+
+/** \brief Provides the current ray table
+*
+* \returns      The table, which stays valid however long the caller keeps it; an empty table (see
+*               Rays::valid()) until configure() is called
+*/
+std::shared_ptr<const CameraModel::Rays> CameraModel::rays() const
+{
+    return std::atomic_load(&table);
+}
+
+/** \brief Tells whether the table holds rays
+*/
+bool CameraModel::Rays::valid() const
+{
+    return gridCols >= 2 && gridRows >= 2;
+}
+
+/** \brief Provides the focal length in pixels
+*/
+double CameraModel::Rays::focalLength() const
+{
+    return f;
+}
+
+/** \brief Provides the unit ray of an image point
+*
+* \param [in]   x           The horizontal coordinate of the image point
+* \param [in]   y           The vertical coordinate of the image point
+* \param [out]  right       The ray component along the image x axis
+* \param [out]  down        The ray component along the image y axis
+* \param [out]  forward     The ray component along the optical axis
+*
+* The ray of an empty table is the optical axis
+*/
+void CameraModel::Rays::ray(float x, float y, double &right, double &down, double &forward) const
+{
+    if (!valid())
+    {
+        right = down = 0;
+        forward = 1;
+        return;
+    }
+
+    double u = x / step, v = y / step;
+    int j = std::min(std::max((int) u, 0), gridCols - 2);
+    int i = std::min(std::max((int) v, 0), gridRows - 2);
+    double fu = u - j, fv = v - i;
+
+    size_t k00 = (size_t) i * gridCols + j, k10 = k00 + gridCols;
+    double w00 = (1 - fu) * (1 - fv), w01 = fu * (1 - fv), w10 = (1 - fu) * fv, w11 = fu * fv;
+
+    right = w00 * rayRight[k00] + w01 * rayRight[k00 + 1] + w10 * rayRight[k10] + w11 * rayRight[k10 + 1];
+    down = w00 * rayDown[k00] + w01 * rayDown[k00 + 1] + w10 * rayDown[k10] + w11 * rayDown[k10 + 1];
+    forward = w00 * rayForward[k00] + w01 * rayForward[k00 + 1] + w10 * rayForward[k10] + w11 * rayForward[k10 + 1];
+}
+
+/** \brief Calculates the intrinsics and the unit rays of the grid points into a new table, and publishes it
+*
+* The grid covers the whole image, its last row and column lying on or beyond the image border. Called with
+* buildMutex locked
+*/
+void CameraModel::build()
+{
+    std::shared_ptr<Rays> rays = std::make_shared<Rays>();
+    Rays &t = *rays;
+
+    // TODO: Set the true cx, cy and f based on camera params instead of this simplification
+    t.f = 0.5 * imgWidth * (1.0 / tan((hva / 2.0) * M_PI / 180));
+    double cx = imgWidth / 2.0, cy = imgHeight / 2.0;
+
+    t.step = step;
+    t.gridCols = std::max((imgWidth + step - 1) / step + 1, 2);
+    t.gridRows = std::max((imgHeight + step - 1) / step + 1, 2);
+    size_t n = (size_t) t.gridCols * t.gridRows;
+    t.rayRight.resize(n);
+    t.rayDown.resize(n);
+    t.rayForward.resize(n);
+
+    for (int i = 0; i < t.gridRows; i++)
+        for (int j = 0; j < t.gridCols; j++)
+        {
+            double xu, yu;
+            undistort((j * step - cx) / t.f, (i * step - cy) / t.f, xu, yu);
+            double norm = sqrt(xu * xu + yu * yu + 1);
+            size_t k = (size_t) i * t.gridCols + j;
+            t.rayRight[k] = xu / norm;
+            t.rayDown[k] = yu / norm;
+            t.rayForward[k] = 1 / norm;
+        }
+
+    std::atomic_store(&table, std::shared_ptr<const Rays>(rays));
+    built = true;
+}
+
+/** \brief Removes the radial distortion of a normalized image point
+*
+* \param [in]   xd  The distorted normalized x coordinate
+* \param [in]   yd  The distorted normalized y coordinate
+* \param [out]  xu  The undistorted normalized x coordinate
+* \param [out]  yu  The undistorted normalized y coordinate
+*
+* The distortion model has no closed form inverse; a few fixed point iterations are enough for the mild
+* distortion of the drone cameras
+*/
+void CameraModel::undistort(double xd, double yd, double &xu, double &yu) const
+{
+    xu = xd;
+    yu = yd;
+    if (k1 == 0 && k2 == 0)
+        return;
+
+    for (int n = 0; n < 10; n++)
+    {
+        double r2 = xu * xu + yu * yu;
+        double scale = 1 + k1 * r2 + k2 * r2 * r2;
+        xu = xd / scale;
+        yu = yd / scale;
+    }
+}
@@ -0,0 +1,519 @@
+
+#include <math.h>
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+
+#include "coverageGrid.h"
+
+using namespace SweeperGeometry;
+
+// std::min takes it by reference
+const int CoverageGrid::histogramBins;
+
+/** \brief Constructor; sets the grid resolution
+*
+* \param [in]   cellSize    The cell side in meters
+* \param [in]   tileSize_   The tile side in cells
+*/
+CoverageGrid::CoverageGrid(double cellSize, int tileSize_)
+{
+    cell = cellSize;
+    tileSize = std::max(tileSize_, 8);
+}
+
+inline int64_t CoverageGrid::key(int64_t tx, int64_t ty)
+{
+    return (int64_t) (((uint64_t) tx << 32) | (uint32_t) ty);
+}
+
+/** \brief Provides the tile coordinate of a cell coordinate, rounding towards minus infinity
+*/
+inline int64_t CoverageGrid::tileOf(int64_t c) const
+{
+    return (c >= 0 ? c / tileSize : -((-c - 1) / tileSize) - 1);
+}
+
+/** \brief Provides a tile, adding it without any plane if it is neither swept nor in the mission yet
+*/
+CoverageGrid::Tile &CoverageGrid::tile(int64_t tx, int64_t ty)
+{
+    Tile &t = tiles[key(tx, ty)];
+    t.key = key(tx, ty);
+    return t;
+}
+
+/** \brief Tells whether a cell of a tile is in the mission boundary
+*/
+inline bool CoverageGrid::inMission(const Tile &t, size_t k)
+{
+    return !t.mission.empty() && (t.mission[k >> 6] >> (k & 63) & 1);
+}
+
+/** \brief Tells whether a cell of a tile is swept
+*/
+inline bool CoverageGrid::isCovered(const Tile &t, size_t k)
+{
+    return !t.covered.empty() && t.covered[k];
+}
+
+/** \brief Scan converts a polygon
+*
+* \param [in]   xs      The east coordinates of the polygon vertices in meters
+* \param [in]   ys      The north coordinates of the polygon vertices in meters
+* \param [in]   span    Called with the tile, the row in the tile and the first and last columns in the tile of
+*                       each horizontal run of cells whose centers are inside the polygon
+*
+* The polygon is scan converted row by row: the cells of a row whose centers are between a pair of edge
+* crossings (even-odd rule) are inside
+*/
+template <typename F>
+void CoverageGrid::scan(const std::vector<double> &xs, const std::vector<double> &ys, F span)
+{
+    size_t n = std::min(xs.size(), ys.size());
+    if (n < 3)
+        return;
+
+    double minY = *std::min_element(ys.begin(), ys.begin() + n), maxY = *std::max_element(ys.begin(), ys.begin() + n);
+    int64_t r0 = (int64_t) ceil(minY / cell - 0.5), r1 = (int64_t) floor(maxY / cell - 0.5);
+
+    for (int64_t row = r0; row <= r1; row++)
+    {
+        double yc = (row + 0.5) * cell;
+        crossings.clear();
+        for (size_t i = 0, j = n - 1; i < n; j = i++)
+        {
+            if ((ys[i] <= yc) != (ys[j] <= yc))
+                crossings.push_back(xs[i] + (yc - ys[i]) * (xs[j] - xs[i]) / (ys[j] - ys[i]));
+        }
+        std::sort(crossings.begin(), crossings.end());
+
+        int64_t ty = tileOf(row);
+        int r = (int) (row - ty * tileSize);
+        for (size_t k = 0; k + 1 < crossings.size(); k += 2)
+        {
+            int64_t c0 = (int64_t) ceil(crossings[k] / cell - 0.5), c1 = (int64_t) floor(crossings[k + 1] / cell - 0.5);
+            if (c0 > c1)
+                continue;
+            for (int64_t tx = tileOf(c0); tx <= tileOf(c1); tx++)
+            {
+                int64_t first = std::max(c0, tx * tileSize), last = std::min(c1, (tx + 1) * tileSize - 1);
+                span(tile(tx, ty), r, (int) (first - tx * tileSize), (int) (last - tx * tileSize));
+            }
+        }
+    }
+}
+
+/** \brief Marks the cells covered by a polygon, e.g. a field of view, and updates the statistics
+*
+* \param [in]   xs      The east coordinates of the polygon vertices in meters
+* \param [in]   ys      The north coordinates of the polygon vertices in meters
+* \param [in]   time    The time in which the polygon is seen, in seconds
+*/
+void CoverageGrid::fill(const std::vector<double> &xs, const std::vector<double> &ys, double time)
+{
+    if (!started)
+    {
+        epoch = time;
+        started = true;
+    }
+    float t = (float) (time - epoch);
+
+    scan(xs, ys, [&](Tile &tl, int r, int c0, int c1) {
+        if (tl.covered.empty())
+        {
+            size_t n = (size_t) tileSize * tileSize;
+            tl.covered.assign(n, 0);
+            tl.visits.assign(n, 0);
+            tl.lastSeen.assign(n, 0.0f);
+        }
+        for (size_t k = (size_t) r * tileSize + c0, end = (size_t) r * tileSize + c1; k <= end; k++)
+        {
+            if (!tl.covered[k])
+            {
+                tl.covered[k] = 1;
+                tl.swept++;
+                if (!tl.changed)
+                {
+                    tl.changed = true;
+                    changedTiles.push_back(tl.key);
+                }
+                coveredCells++;
+                if (inMission(tl, k))
+                {
+                    missionCovered++;
+                    tl.gaps--;
+                }
+                dirty = true;
+            }
+            if (tl.visits[k] == 0 || t - tl.lastSeen[k] > revisitInterval)
+            {
+                if (tl.visits[k] > 0)
+                    histogram[std::min((int) tl.visits[k], histogramBins) - 1]--;
+                if (tl.visits[k] < UINT16_MAX)
+                    tl.visits[k]++;
+                histogram[std::min((int) tl.visits[k], histogramBins) - 1]++;
+            }
+            tl.lastSeen[k] = t;
+        }
+    });
+}
+
+/** \brief Sets the mission boundary, replacing the previous one
+*
+* \param [in]   xs      The east coordinates of the boundary vertices in meters
+* \param [in]   ys      The north coordinates of the boundary vertices in meters
+*
+* The mission cells are kept as one bit per cell in the tiles; a tile of the mission which is not swept yet
+* holds nothing else, so a large mission costs only its bitmask until the camera sweeps it
+*/
+void CoverageGrid::setMission(const std::vector<double> &xs, const std::vector<double> &ys)
+{
+    for (auto it = tiles.begin(); it != tiles.end();)
+    {
+        if (it->second.covered.empty())
+        {
+            it = tiles.erase(it);
+            continue;
+        }
+        std::vector<uint64_t>().swap(it->second.mission);
+        it->second.gaps = 0;
+        ++it;
+    }
+    missionCells = 0;
+    missionCovered = 0;
+
+    scan(xs, ys, [&](Tile &tl, int r, int c0, int c1) {
+        if (tl.mission.empty())
+            tl.mission.assign(((size_t) tileSize * tileSize + 63) / 64, 0);
+        for (size_t k = (size_t) r * tileSize + c0, end = (size_t) r * tileSize + c1; k <= end; k++)
+        {
+            if (inMission(tl, k))
+                continue;
+            tl.mission[k >> 6] |= (uint64_t) 1 << (k & 63);
+            missionCells++;
+            if (isCovered(tl, k))
+                missionCovered++;
+            else
+                tl.gaps++;
+        }
+    });
+}
+
+/** \brief Sets the time after which a cell seen again counts as a new visit
+*
+* \param [in]   interval    The time in seconds; 30 s by default
+*/
+void CoverageGrid::setRevisitInterval(double interval)
+{
+    revisitInterval = interval;
+}
+
+/** \brief Provides the coverage statistics
+*
+* \param [out]  stats   The statistics
+*/
+void CoverageGrid::getStats(CoverageStats &stats) const
+{
+    double cellArea = cell * cell;
+    stats.sweptArea = coveredCells * cellArea;
+    stats.missionArea = missionCells * cellArea;
+    stats.missionCoverage = (missionCells > 0 ? 100.0 * missionCovered / missionCells : 0.0);
+    stats.visitHistogram.assign(histogram, histogram + histogramBins);
+}
+
+/** \brief Finds the tile and the cell of a point
+*
+* \param [in]   x       The east coordinate of the point in meters
+* \param [in]   y       The north coordinate of the point in meters
+* \param [out]  k       The cell index in the tile
+*
+* \returns      The tile, NULL if it is not allocated
+*/
+const CoverageGrid::Tile *CoverageGrid::find(double x, double y, size_t &k) const
+{
+    int64_t col = (int64_t) floor(x / cell), row = (int64_t) floor(y / cell);
+    int64_t tx = tileOf(col), ty = tileOf(row);
+    auto it = tiles.find(key(tx, ty));
+    if (it == tiles.end())
+        return NULL;
+    k = (size_t) (row - ty * tileSize) * tileSize + (size_t) (col - tx * tileSize);
+    return &it->second;
+}
+
+/** \brief Provides the visit count of the cell of a point
+*
+* \param [in]   x       The east coordinate of the point in meters
+* \param [in]   y       The north coordinate of the point in meters
+*/
+int CoverageGrid::visits(double x, double y) const
+{
+    size_t k;
+    const Tile *t = find(x, y, k);
+    return (t && !t->visits.empty() ? t->visits[k] : 0);
+}
+
+/** \brief Provides the time since the cell of a point was last seen
+*
+* \param [in]   x       The east coordinate of the point in meters
+* \param [in]   y       The north coordinate of the point in meters
+* \param [in]   now     The current time in seconds
+*
+* \returns      The time in seconds, -1 if the cell is never seen
+*/
+double CoverageGrid::timeSinceSeen(double x, double y, double now) const
+{
+    size_t k;
+    const Tile *t = find(x, y, k);
+    if (!t || !isCovered(*t, k))
+        return -1;
+    return now - epoch - t->lastSeen[k];
+}
+
+/** \brief Tells whether new cells are covered since the last outline() call
+*/
+bool CoverageGrid::isDirty() const
+{
+    return dirty;
+}
+
+/** \brief Traces the contours of a mask into polygons
+*
+* \param [in]   mask        The mask, whose cell (1, 1) is the first cell of the tile (tx0, ty0)
+* \param [in]   tx0         The tile column of the mask origin
+* \param [in]   ty0         The tile row of the mask origin
+* \param [out]  polygons    One polygon per disjoint region, with its holes as inner rings
+*
+* The contours are traced in a two level hierarchy: the outer contours of the regions and the contours of
+* their holes. The vertices are the centers of the boundary cells, only the corners of the staircases being
+* kept
+*/
+void CoverageGrid::contours(const cv::Mat &mask, int64_t tx0, int64_t ty0, std::vector<polygon> &polygons) const
+{
+    polygons.clear();
+
+    std::vector<std::vector<cv::Point>> contours;
+    std::vector<cv::Vec4i> hierarchy;
+    cv::findContours(mask, contours, hierarchy, cv::RETR_CCOMP, cv::CHAIN_APPROX_SIMPLE);
+
+    double originX = (double) tx0 * tileSize - 1 + 0.5, originY = (double) ty0 * tileSize - 1 + 0.5;
+    auto toRing = [&](const std::vector<cv::Point> &contour, polygon::ring_type &ring) {
+        for (const cv::Point &p : contour)
+            boost::geometry::append(ring, boost::geometry::make<polygon::point_type>((originX + p.x) * cell, (originY + p.y) * cell));
+        boost::geometry::append(ring, boost::geometry::make<polygon::point_type>((originX + contour[0].x) * cell, (originY + contour[0].y) * cell));
+    };
+
+    for (size_t i = 0; i < contours.size(); i++)
+    {
+        if (hierarchy[i][3] >= 0 || contours[i].size() < 3)
+            continue;
+
+        polygon poly;
+        toRing(contours[i], poly.outer());
+        for (int child = hierarchy[i][2]; child >= 0; child = hierarchy[child][0])
+        {
+            if (contours[child].size() < 3)
+                continue;
+            poly.inners().emplace_back();
+            toRing(contours[child], poly.inners().back());
+        }
+        boost::geometry::correct(poly);
+        polygons.push_back(poly);
+    }
+}
+
+/** \brief Traces the outlines of the swept area
+*
+* \param [out]  polygons    One polygon per disjoint swept region, with its holes as inner rings
+*
+* The swept cells are kept in a mask over the bounding box of the swept tiles (not of the mission tiles),
+* which persists from call to call: only the tiles swept since the previous call are copied into it. The
+* mask is reallocated only when the swept area leaves it, with some slack on each side so that it is not
+* reallocated again and again while the area grows. The contours are then traced on the whole mask
+*/
+void CoverageGrid::outline(std::vector<polygon> &polygons)
+{
+    dirty = false;
+
+    bool grown = sweptMask.empty();
+    for (int64_t k : changedTiles)
+    {
+        int64_t tx = k >> 32, ty = (int32_t) (uint32_t) k;
+        if (sweptMaxTx < sweptMinTx)
+        {
+            sweptMinTx = sweptMaxTx = tx;
+            sweptMinTy = sweptMaxTy = ty;
+        }
+        sweptMinTx = std::min(sweptMinTx, tx);
+        sweptMaxTx = std::max(sweptMaxTx, tx);
+        sweptMinTy = std::min(sweptMinTy, ty);
+        sweptMaxTy = std::max(sweptMaxTy, ty);
+        grown = grown || tx < maskTx || ty < maskTy || tx >= maskTx + maskW || ty >= maskTy + maskH;
+    }
+
+    if (sweptMaxTx < sweptMinTx)
+    {
+        polygons.clear();
+        return;
+    }
+
+    auto copyTile = [this](int64_t k, const Tile &t) {
+        int64_t tx = k >> 32, ty = (int32_t) (uint32_t) k;
+        int x0 = (int) (tx - maskTx) * tileSize + 1, y0 = (int) (ty - maskTy) * tileSize + 1;
+        cv::Mat roi = sweptMask(cv::Rect(x0, y0, tileSize, tileSize));
+        cv::Mat(tileSize, tileSize, CV_8UC1, (void *) t.covered.data()).copyTo(roi);
+    };
+
+    if (grown)
+    {
+        int64_t slackX = std::max<int64_t>(2, (sweptMaxTx - sweptMinTx + 1) / 4);
+        int64_t slackY = std::max<int64_t>(2, (sweptMaxTy - sweptMinTy + 1) / 4);
+        maskTx = sweptMinTx - slackX;
+        maskTy = sweptMinTy - slackY;
+        maskW = (int) (sweptMaxTx - sweptMinTx + 1 + 2 * slackX);
+        maskH = (int) (sweptMaxTy - sweptMinTy + 1 + 2 * slackY);
+        sweptMask = cv::Mat::zeros(maskH * tileSize + 2, maskW * tileSize + 2, CV_8UC1);
+        for (auto &it : tiles)
+            if (it.second.swept > 0)
+                copyTile(it.first, it.second);
+    }
+    else
+        for (int64_t k : changedTiles)
+            copyTile(k, tiles.at(k));
+
+    for (int64_t k : changedTiles)
+        tiles.at(k).changed = false;
+    changedTiles.clear();
+
+    contours(sweptMask, maskTx, maskTy, polygons);
+}
+
+/** \brief Traces the outlines of the mission area not swept yet
+*
+* \param [out]  polygons    One polygon per disjoint unswept region, with the swept islands inside it as
+*                           inner rings; empty if the mission is fully swept or not set
+*
+* The mask spans only the bounding box of the tiles which still have gaps, so it shrinks as the mission
+* is swept
+*/
+void CoverageGrid::gaps(std::vector<polygon> &polygons) const
+{
+    polygons.clear();
+    if (missionCovered == missionCells)
+        return;
+
+    int64_t tx0 = INT64_MAX, ty0 = INT64_MAX, tx1 = INT64_MIN, ty1 = INT64_MIN;
+    for (auto &it : tiles)
+    {
+        if (it.second.gaps == 0)
+            continue;
+        int64_t tx = it.first >> 32, ty = (int32_t) (uint32_t) it.first;
+        tx0 = std::min(tx0, tx);
+        tx1 = std::max(tx1, tx);
+        ty0 = std::min(ty0, ty);
+        ty1 = std::max(ty1, ty);
+    }
+
+    int cols = (int) (tx1 - tx0 + 1) * tileSize + 2, rows = (int) (ty1 - ty0 + 1) * tileSize + 2;
+    cv::Mat mask = cv::Mat::zeros(rows, cols, CV_8UC1);
+    for (auto &it : tiles)
+    {
+        const Tile &t = it.second;
+        if (t.gaps == 0)
+            continue;
+        int64_t tx = it.first >> 32, ty = (int32_t) (uint32_t) it.first;
+        int x0 = (int) (tx - tx0) * tileSize + 1, y0 = (int) (ty - ty0) * tileSize + 1;
+        cv::Mat roi = mask(cv::Rect(x0, y0, tileSize, tileSize));
+        for (int r = 0; r < tileSize; r++)
+        {
+            uint8_t *row = roi.ptr<uint8_t>(r);
+            for (int c = 0, k = r * tileSize; c < tileSize; c++, k++)
+                row[c] = inMission(t, k) && !isCovered(t, k);
+        }
+    }
+
+    contours(mask, tx0, ty0, polygons);
+}
+
+/** \brief Finds the unswept mission cell nearest to a point
+*
+* \param [in]   x       The east coordinate of the point in meters
+* \param [in]   y       The north coordinate of the point in meters
+* \param [out]  gapX    The east coordinate of the center of the nearest unswept cell in meters
+* \param [out]  gapY    The north coordinate of the center of the nearest unswept cell in meters
+*
+* \returns      false if the mission is fully swept or not set
+*/
+bool CoverageGrid::nearestGap(double x, double y, double &gapX, double &gapY) const
+{
+    if (missionCovered == missionCells)
+        return false;
+
+    // The tiles with gaps, by the squared distance from the point to their nearest cell center
+    typedef std::pair<double, const std::pair<const int64_t, Tile> *> Candidate;
+    std::vector<Candidate> candidates;
+    double span = (tileSize - 1) * cell;
+    for (auto &it : tiles)
+    {
+        if (it.second.gaps == 0)
+            continue;
+        int64_t tx = it.first >> 32, ty = (int32_t) (uint32_t) it.first;
+        double x0 = (tx * tileSize + 0.5) * cell, y0 = (ty * tileSize + 0.5) * cell;
+        double dx = std::max(std::max(x0 - x, x - x0 - span), 0.0), dy = std::max(std::max(y0 - y, y - y0 - span), 0.0);
+        candidates.emplace_back(dx * dx + dy * dy, &it);
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate &a, const Candidate &b) { return a.first < b.first; });
+
+    double best = INFINITY;
+    for (auto &candidate : candidates)
+    {
+        if (candidate.first >= best)
+            break;
+        int64_t tx = candidate.second->first >> 32, ty = (int32_t) (uint32_t) candidate.second->first;
+        const Tile &t = candidate.second->second;
+        for (int r = 0, k = 0; r < tileSize; r++)
+        {
+            double cy = ((double) ty * tileSize + r + 0.5) * cell, dy2 = (cy - y) * (cy - y);
+            if (dy2 >= best)
+            {
+                k += tileSize;
+                continue;
+            }
+            for (int c = 0; c < tileSize; c++, k++)
+            {
+                if (!inMission(t, k) || isCovered(t, k))
+                    continue;
+                double cx = ((double) tx * tileSize + c + 0.5) * cell, d = (cx - x) * (cx - x) + dy2;
+                if (d < best)
+                {
+                    best = d;
+                    gapX = cx;
+                    gapY = cy;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/** \brief Provides the cell side in meters
+*/
+double CoverageGrid::cellSize() const
+{
+    return cell;
+}
+
+/** \brief Drops all the cells, with their statistics and the mission boundary
+*/
+void CoverageGrid::clear()
+{
+    tiles.clear();
+    changedTiles.clear();
+    sweptMask.release();
+    sweptMinTx = sweptMinTy = 0;
+    sweptMaxTx = sweptMaxTy = -1;
+    coveredCells = missionCells = missionCovered = 0;
+    std::fill(histogram, histogram + histogramBins, 0);
+    started = false;
+    dirty = true;
+}
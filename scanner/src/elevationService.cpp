@@ -0,0 +1,299 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "Eigen/Core"
+#include "elevationService.h"
+
+/** \brief Constructor; sets the tiles directory and the cache size
+*
+* \param [in]   tilesDir    The directory in which the HGT tiles exist
+* \param [in]   limit       The maximum number of tiles kept mapped at the same time
+*/
+ElevationService::ElevationService(std::string tilesDir, size_t limit)
+{
+    dir = tilesDir;
+    if (!dir.empty() && dir.back() != '/')
+        dir += '/';
+    cacheLimit = limit;
+}
+
+/** \brief Destructor; stops the prefetcher thread
+*/
+ElevationService::~ElevationService()
+{
+    {
+        std::lock_guard<std::mutex> lock(prefetchMutex);
+        stopPrefetcher = true;
+    }
+    prefetchCond.notify_one();
+    if (prefetcher.joinable())
+        prefetcher.join();
+}
+
+ElevationService::Tile::~Tile()
+{
+    if (data)
+        munmap((void *) data, length);
+}
+
+/** \brief Provides the terrain elevation of a location
+*
+* \param [in]   lat     Latitude in degrees
+* \param [in]   lng     Longitude in degrees
+*
+* \returns      The elevation (meters) of the nearest post, or NO_DATA if the tile does not exist
+*/
+double ElevationService::height(double lat, double lng)
+{
+    int tileLat = (int) floor(lat), tileLng = (int) floor(lng);
+    std::shared_ptr<Tile> tile = getTile(tileLat, tileLng);
+    if (!tile->data)
+        return NO_DATA;
+
+    int n = tile->samples - 1;
+    int row = (int) lround((tileLat + 1 - lat) * n);
+    int col = (int) lround((lng - tileLng) * n);
+
+    return post(*tile, row, col);
+}
+
+/** \brief Provides the terrain elevations of a batch of locations, interpolated bilinearly
+*
+* \param [in]   lats    Latitudes in degrees
+* \param [in]   lngs    Longitudes in degrees
+* \param [out]  out     The elevations in meters; NO_DATA where the tile does not exist or any of the four
+*                       surrounding posts is a void
+* \param [in]   n       The number of locations
+*
+* The four surrounding posts of each location are gathered first, holding on to the last used tile so
+* that consecutive locations in the same tile do not touch the cache. The interpolation itself is then
+* done on whole arrays, which Eigen vectorizes (NEON on the phone)
+*/
+void ElevationService::heights(const double *lats, const double *lngs, double *out, size_t n)
+{
+    Eigen::ArrayXd h00(n), h01(n), h10(n), h11(n), fr(n), fc(n);
+    std::vector<bool> invalid(n, false);
+
+    std::shared_ptr<Tile> tile;
+    int tileLat = 0, tileLng = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        int la = (int) floor(lats[i]), ln = (int) floor(lngs[i]);
+        if (!tile || la != tileLat || ln != tileLng)
+        {
+            tile = getTile(la, ln);
+            tileLat = la;
+            tileLng = ln;
+        }
+
+        if (!tile->data)
+        {
+            invalid[i] = true;
+            h00[i] = h01[i] = h10[i] = h11[i] = fr[i] = fc[i] = 0;
+            continue;
+        }
+
+        int m = tile->samples - 1;
+        double r = (tileLat + 1 - lats[i]) * m, c = (lngs[i] - tileLng) * m;
+        int r0 = std::min((int) r, m - 1), c0 = std::min((int) c, m - 1);
+        fr[i] = r - r0;
+        fc[i] = c - c0;
+        h00[i] = post(*tile, r0, c0);
+        h01[i] = post(*tile, r0, c0 + 1);
+        h10[i] = post(*tile, r0 + 1, c0);
+        h11[i] = post(*tile, r0 + 1, c0 + 1);
+        invalid[i] = (h00[i] == NO_DATA || h01[i] == NO_DATA || h10[i] == NO_DATA || h11[i] == NO_DATA);
+    }
+
+    Eigen::Map<Eigen::ArrayXd> result(out, n);
+    result = (1 - fr) * ((1 - fc) * h00 + fc * h01) + fr * ((1 - fc) * h10 + fc * h11);
+
+    for (size_t i = 0; i < n; i++)
+        if (invalid[i])
+            out[i] = NO_DATA;
+}
+
+/** \brief Asks the prefetcher to prepare the tiles ahead of the drone
+*
+* \param [in]   lat     The drone latitude in degrees
+* \param [in]   lng     The drone longitude in degrees
+* \param [in]   course  The drone course (radians, clockwise from north)
+* \param [in]   speed   The drone ground speed in m/s
+* \param [in]   horizon The time (seconds) to look ahead
+*
+* This function returns immediately. The tiles under the path from the current location to the location
+* reached after horizon seconds, along with the tiles within about 1 km around the path, are mapped and
+* read ahead by the prefetcher thread. A newer request replaces an older one which is not handled yet
+*/
+void ElevationService::prefetch(double lat, double lng, double course, double speed, double horizon)
+{
+    const double metersPerDeg = 111320.0, margin = 0.01;
+    double dist = speed * horizon;
+    double cosLat = std::max(cos(lat * M_PI / 180.0), 0.01);
+    int steps = std::max(1, (int) (dist / 500.0));
+
+    std::vector<std::pair<int, int>> tiles;
+    for (int k = 0; k <= steps; k++)
+    {
+        double d = dist * k / steps;
+        double pLat = lat + d * cos(course) / metersPerDeg;
+        double pLng = lng + d * sin(course) / (metersPerDeg * cosLat);
+        for (double dLat : {-margin, 0.0, margin})
+            for (double dLng : {-margin, 0.0, margin})
+            {
+                std::pair<int, int> t((int) floor(pLat + dLat), (int) floor(pLng + dLng));
+                if (std::find(tiles.begin(), tiles.end(), t) == tiles.end())
+                    tiles.push_back(t);
+            }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(prefetchMutex);
+        prefetchTiles = tiles;
+        prefetchPending = true;
+        if (!prefetcher.joinable())
+            prefetcher = std::thread(&ElevationService::prefetchLoop, this);
+    }
+    prefetchCond.notify_one();
+}
+
+/** \brief The prefetcher thread loop; maps the requested tiles and advises the system to read them
+*/
+void ElevationService::prefetchLoop()
+{
+    while (true)
+    {
+        std::vector<std::pair<int, int>> tiles;
+        {
+            std::unique_lock<std::mutex> lock(prefetchMutex);
+            prefetchCond.wait(lock, [this] { return prefetchPending || stopPrefetcher; });
+            if (stopPrefetcher)
+                return;
+            tiles.swap(prefetchTiles);
+            prefetchPending = false;
+        }
+
+        // Never evict more than half of the cache for tiles which may be needed only later
+        if (tiles.size() > cacheLimit / 2)
+            tiles.resize(cacheLimit / 2);
+
+        for (auto & t : tiles)
+        {
+            std::shared_ptr<Tile> tile = getTile(t.first, t.second);
+            if (tile->data)
+                madvise((void *) tile->data, tile->length, MADV_WILLNEED);
+        }
+    }
+}
+
+/** \brief Reads a post of a tile
+*
+* \param [in]   tile    The mapped tile
+* \param [in]   row     The post row, from north to south
+* \param [in]   col     The post column, from west to east
+*
+* \returns      The post elevation in meters, NO_DATA if it is a void
+*/
+double ElevationService::post(const Tile &tile, int row, int col)
+{
+    const uint8_t *p = tile.data + 2 * ((size_t) row * tile.samples + col);
+    return (double) (int16_t) ((p[0] << 8) | p[1]);
+}
+
+int ElevationService::tileKey(int lat, int lng)
+{
+    return (lat + 90) * 360 + (lng + 180);
+}
+
+/** \brief Generates the standard HGT file name of a tile, e.g. N35E051.hgt
+*/
+std::string ElevationService::tileName(int lat, int lng)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%c%02d%c%03d.hgt", lat < 0 ? 'S' : 'N', abs(lat), lng < 0 ? 'W' : 'E', abs(lng));
+    return std::string(name);
+}
+
+/** \brief Maps a tile file into memory
+*
+* \param [in]   lat     The latitude of the tile's south west corner
+* \param [in]   lng     The longitude of the tile's south west corner
+*
+* \returns      The mapped tile. If the file does not exist or is not a valid HGT file, its data is null
+*/
+std::shared_ptr<ElevationService::Tile> ElevationService::loadTile(int lat, int lng)
+{
+    std::shared_ptr<Tile> tile = std::make_shared<Tile>();
+
+    int fd = open((dir + tileName(lat, lng)).c_str(), O_RDONLY);
+    if (fd < 0)
+        return tile;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0)
+    {
+        int samples = (int) lround(sqrt(st.st_size / 2.0));
+        if ((off_t) samples * samples * 2 == st.st_size && samples > 1)
+        {
+            void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                tile->data = (const uint8_t *) data;
+                tile->length = st.st_size;
+                tile->samples = samples;
+            }
+        }
+    }
+    close(fd);
+
+    return tile;
+}
+
+/** \brief Provides a tile from the cache, mapping it if it is not cached
+*
+* \param [in]   lat     The latitude of the tile's south west corner
+* \param [in]   lng     The longitude of the tile's south west corner
+*
+* \returns      The tile, which stays valid as long as the returned pointer is held, even if it is
+*               evicted from the cache meanwhile
+*/
+std::shared_ptr<ElevationService::Tile> ElevationService::getTile(int lat, int lng)
+{
+    int key = tileKey(lat, lng);
+
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto it = cacheIndex.find(key);
+        if (it != cacheIndex.end())
+        {
+            lru.splice(lru.begin(), lru, it->second);
+            return it->second->second;
+        }
+    }
+
+    std::shared_ptr<Tile> tile = loadTile(lat, lng);
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = cacheIndex.find(key);
+    if (it != cacheIndex.end())
+        return it->second->second;
+
+    lru.emplace_front(key, tile);
+    cacheIndex[key] = lru.begin();
+    while (lru.size() > cacheLimit)
+    {
+        cacheIndex.erase(lru.back().first);
+        lru.pop_back();
+    }
+
+    return tile;
+}
@@ -0,0 +1,308 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#include <string.h>
+#include <cstdlib>
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+#include "frame.h"
+
+/** \brief Constructor; an empty frame
+*/
+Frame::Frame()
+{
+}
+
+/** \brief Constructor; wraps an image without copying it
+*
+* \param [in]   image   The image; 8 bit, with 1, 3 or 4 channels as given by the format. If it does not own
+*                       its data (created over an external buffer), the frame is borrowed
+* \param [in]   format  FRAME_GRAY, FRAME_BGR or FRAME_RGBA
+*
+* The frame is empty if the image does not match the format
+*/
+Frame::Frame(const cv::Mat &image, FrameFormat format)
+{
+    int channels = (format == FRAME_GRAY ? 1 : format == FRAME_BGR ? 3 : format == FRAME_RGBA ? 4 : 0);
+    if (image.empty() || image.depth() != CV_8U || image.channels() != channels)
+        return;
+
+    planes = std::make_shared<Planes>();
+    planes->format = format;
+    planes->width = image.cols;
+    planes->height = image.rows;
+    planes->image = image;
+    planes->borrowed = (image.u == nullptr);
+}
+
+/** \brief Creates a frame over the planes of a YUV_420_888 image, without copying them
+*
+* \param [in]   width           The image width in pixels; must be even
+* \param [in]   height          The image height in pixels; must be even
+* \param [in]   y               The luma plane
+* \param [in]   yRowStride      The distance in bytes between two rows of the luma plane
+* \param [in]   u               The U (Cb) plane
+* \param [in]   v               The V (Cr) plane
+* \param [in]   uvRowStride     The distance in bytes between two rows of the chroma planes
+* \param [in]   uvPixelStride   The distance in bytes between two samples of a chroma row; 2 if the chroma
+*                               planes are interleaved, as most cameras provide them
+*
+* \returns      A borrowed frame, or an empty frame if the geometry is not valid
+*/
+Frame Frame::fromYuv420(int width, int height, const uint8_t *y, int yRowStride, const uint8_t *u,
+                        const uint8_t *v, int uvRowStride, int uvPixelStride)
+{
+    Frame frame;
+    if (width <= 0 || height <= 0 || width % 2 || height % 2 || !y || !u || !v || yRowStride < width ||
+        uvPixelStride < 1 || uvRowStride < (width / 2 - 1) * uvPixelStride + 1)
+        return frame;
+
+    frame.planes = std::make_shared<Planes>();
+    Planes &p = *frame.planes;
+    p.format = FRAME_YUV420;
+    p.width = width;
+    p.height = height;
+    p.borrowed = true;
+    p.y = y;
+    p.u = u;
+    p.v = v;
+    p.yRowStride = yRowStride;
+    p.uvRowStride = uvRowStride;
+    p.uvPixelStride = uvPixelStride;
+
+    p.gray = cv::Mat(height, width, CV_8UC1, (void *) y, (size_t) yRowStride);
+    p.layout = canonicalLayout(p);
+    if (p.layout != NONE)
+        p.yuv = cv::Mat(height * 3 / 2, width, CV_8UC1, (void *) y);
+    return frame;
+}
+
+/** \brief Creates a frame over an NV21 buffer (the Android camera preview default), without copying it
+*
+* \param [in]   data    The luma plane followed by the interleaved V and U samples
+* \param [in]   width   The image width in pixels; must be even
+* \param [in]   height  The image height in pixels; must be even
+*
+* \returns      A borrowed frame, or an empty frame if the geometry is not valid
+*/
+Frame Frame::fromNv21(const uint8_t *data, int width, int height)
+{
+    if (!data)
+        return Frame();
+    const uint8_t *vu = data + (size_t) width * height;
+    return fromYuv420(width, height, data, width, vu + 1, vu, width, 2);
+}
+
+/** \brief Finds whether the YUV planes are already laid out as NV21, NV12 or I420 in one buffer
+*
+* \param [in]   p   The planes
+*
+* \returns      The layout, or NONE if the planes must be compacted before the colour conversion
+*/
+Frame::Layout Frame::canonicalLayout(const Planes &p)
+{
+    const uint8_t *chroma = p.y + (size_t) p.width * p.height;
+    if (p.yRowStride != p.width)
+        return NONE;
+
+    if (p.uvPixelStride == 2 && p.uvRowStride == p.width && std::abs(p.u - p.v) == 1 && std::min(p.u, p.v) == chroma)
+        return (p.v < p.u ? NV21 : NV12);
+
+    if (p.uvPixelStride == 1 && p.uvRowStride == p.width / 2 && p.u == chroma &&
+        p.v == chroma + (size_t) (p.width / 2) * (p.height / 2))
+        return I420;
+
+    return NONE;
+}
+
+/** \brief Copies the YUV planes into one owned buffer, in the NV21 or NV12 layout if the chroma samples are
+* interleaved, and in the I420 layout otherwise
+*
+* \param [in]   p       The planes
+* \param [out]  out     The compact planes, height * 3 / 2 rows of width bytes
+* \param [out]  layout  The layout of out
+*/
+void Frame::compact(const Planes &p, cv::Mat &out, Layout &layout)
+{
+    int w = p.width, h = p.height;
+    out.create(h * 3 / 2, w, CV_8UC1);
+
+    for (int r = 0; r < h; r++)
+        memcpy(out.ptr(r), p.y + (size_t) r * p.yRowStride, w);
+
+    if (p.uvPixelStride == 2 && std::abs(p.u - p.v) == 1)
+    {
+        // The last sample of the later plane ends the row span, so the copy stays within the buffers
+        const uint8_t *first = std::min(p.u, p.v);
+        for (int r = 0; r < h / 2; r++)
+            memcpy(out.ptr(h + r), first + (size_t) r * p.uvRowStride, w);
+        layout = (p.v < p.u ? NV21 : NV12);
+        return;
+    }
+
+    int cw = w / 2, ch = h / 2;
+    uint8_t *dst[2] = {out.ptr(h), out.ptr(h) + (size_t) cw * ch};
+    const uint8_t *src[2] = {p.u, p.v};
+    for (int k = 0; k < 2; k++)
+        for (int r = 0; r < ch; r++)
+        {
+            const uint8_t *row = src[k] + (size_t) r * p.uvRowStride;
+            uint8_t *d = dst[k] + (size_t) r * cw;
+            if (p.uvPixelStride == 1)
+                memcpy(d, row, cw);
+            else
+                for (int c = 0; c < cw; c++)
+                    d[c] = row[c * p.uvPixelStride];
+        }
+    layout = I420;
+}
+
+/** \brief Makes the frame own its data, so it stays valid after the received buffers are released
+*
+* The source buffers of a borrowed frame are copied once, without any conversion; the YUV planes are
+* compacted. The copies of the frame made before share the owned data. A frame which owns its data is
+* left as is
+*/
+void Frame::detach()
+{
+    if (!planes)
+        return;
+
+    Planes &p = *planes;
+    std::lock_guard<std::mutex> lock(p.mutex);
+    if (!p.borrowed)
+        return;
+
+    if (p.format == FRAME_YUV420)
+    {
+        cv::Mat owned;
+        compact(p, owned, p.layout);
+        p.yuv = owned;
+        p.y = owned.ptr(0);
+        p.yRowStride = p.width;
+        const uint8_t *chroma = owned.ptr(p.height);
+        if (p.layout == I420)
+        {
+            p.u = chroma;
+            p.v = chroma + (size_t) (p.width / 2) * (p.height / 2);
+            p.uvRowStride = p.width / 2;
+            p.uvPixelStride = 1;
+        }
+        else
+        {
+            p.u = (p.layout == NV21 ? chroma + 1 : chroma);
+            p.v = (p.layout == NV21 ? chroma : chroma + 1);
+            p.uvRowStride = p.width;
+            p.uvPixelStride = 2;
+        }
+        p.gray = owned.rowRange(0, p.height);
+    }
+    else
+    {
+        // A converted luma plane is owned already
+        p.image = p.image.clone();
+        if (p.format == FRAME_GRAY)
+            p.gray = p.image;
+    }
+    p.borrowed = false;
+}
+
+/** \brief Checks whether the frame holds an image
+*/
+bool Frame::empty() const
+{
+    return !planes;
+}
+
+/** \brief Checks whether the frame is created over buffers it does not own; see detach()
+*/
+bool Frame::borrowed() const
+{
+    return planes && planes->borrowed;
+}
+
+/** \brief Provides the pixel layout the frame is received in
+*/
+FrameFormat Frame::format() const
+{
+    return (planes ? planes->format : FRAME_GRAY);
+}
+
+/** \brief Provides the image size in pixels; zero if the frame is empty
+*/
+cv::Size Frame::size() const
+{
+    return (planes ? cv::Size(planes->width, planes->height) : cv::Size());
+}
+
+/** \brief Provides the image width in pixels
+*/
+int Frame::cols() const
+{
+    return (planes ? planes->width : 0);
+}
+
+/** \brief Provides the image height in pixels
+*/
+int Frame::rows() const
+{
+    return (planes ? planes->height : 0);
+}
+
+/** \brief Provides the luma plane; a view on the source buffer for GRAY and YUV frames, converted on the
+* first call otherwise
+*
+* \returns      An 8 bit single channel image, which must not be modified; empty if the frame is empty
+*/
+const cv::Mat &Frame::gray() const
+{
+    static const cv::Mat none;
+    if (!planes)
+        return none;
+
+    Planes &p = *planes;
+    std::lock_guard<std::mutex> lock(p.mutex);
+    if (p.gray.empty())
+    {
+        if (p.format == FRAME_GRAY)
+            p.gray = p.image;
+        else
+            cv::cvtColor(p.image, p.gray, p.format == FRAME_RGBA ? cv::COLOR_RGBA2GRAY : cv::COLOR_BGR2GRAY);
+    }
+    return p.gray;
+}
+
+/** \brief Provides the BGR image; the source image for BGR frames, converted on the first call otherwise
+*
+* \returns      An 8 bit three channel image, which must not be modified; empty if the frame is empty
+*/
+const cv::Mat &Frame::bgr() const
+{
+    static const cv::Mat none;
+    if (!planes)
+        return none;
+
+    Planes &p = *planes;
+    std::lock_guard<std::mutex> lock(p.mutex);
+    if (p.format == FRAME_BGR)
+        return p.image;
+
+    if (p.bgr.empty())
+    {
+        if (p.format == FRAME_GRAY)
+            cv::cvtColor(p.image, p.bgr, cv::COLOR_GRAY2BGR);
+        else if (p.format == FRAME_RGBA)
+            cv::cvtColor(p.image, p.bgr, cv::COLOR_RGBA2BGR);
+        else
+        {
+            cv::Mat yuv = p.yuv;
+            Layout layout = p.layout;
+            if (layout == NONE)
+                compact(p, yuv, layout);
+            cv::cvtColor(yuv, p.bgr, layout == NV21 ? cv::COLOR_YUV2BGR_NV21 :
+                                     layout == NV12 ? cv::COLOR_YUV2BGR_NV12 : cv::COLOR_YUV2BGR_I420);
+        }
+    }
+    return p.bgr;
+}
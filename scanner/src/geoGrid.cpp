@@ -0,0 +1,203 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#include <math.h>
+#include <algorithm>
+#include "geoGrid.h"
+
+/** \brief Constructor; sets the mesh size
+*
+* \param [in]   cols_   The number of nodes along the image width
+* \param [in]   rows_   The number of nodes along the image height
+*/
+GeoGrid::GeoGrid(int cols_, int rows_)
+{
+    cols = std::max(cols_, 2);
+    rows = std::max(rows_, 2);
+}
+
+/** \brief Sets the image resolution and calculates the image coordinates of the nodes
+*
+* \param [in]   width   The image width in pixels
+* \param [in]   height  The image height in pixels
+*/
+void GeoGrid::configure(int width, int height)
+{
+    if (width == imgWidth && height == imgHeight)
+        return;
+    imgWidth = width;
+    imgHeight = height;
+    valid = false;
+
+    pixelX.resize(cols * rows);
+    pixelY.resize(cols * rows);
+    for (int i = 0; i < rows; i++)
+        for (int j = 0; j < cols; j++)
+        {
+            pixelX[i * cols + j] = (float) j * width / (cols - 1);
+            pixelY[i * cols + j] = (float) i * height / (rows - 1);
+        }
+}
+
+/** \brief Provides the horizontal image coordinates of the nodes, row by row
+*/
+const std::vector<float> &GeoGrid::nodeX() const
+{
+    return pixelX;
+}
+
+/** \brief Provides the vertical image coordinates of the nodes, row by row
+*/
+const std::vector<float> &GeoGrid::nodeY() const
+{
+    return pixelY;
+}
+
+/** \brief Sets the projected nodes of a new image
+*
+* \param [in]   points  The projection of the nodes given by nodeX() and nodeY(), relative to the camera
+* \param [in]   camX    The camera east coordinate in the local frame
+* \param [in]   camY    The camera north coordinate in the local frame
+* \param [in]   time    The time in which the image is captured
+*/
+void GeoGrid::set(const GroundProjector::Points &points, double camX, double camY, double time)
+{
+    size_t n = pixelX.size();
+    groundX.resize(n);
+    groundY.resize(n);
+    ranges.resize(n);
+    show.resize(n);
+    for (size_t k = 0; k < n; k++)
+    {
+        groundX[k] = camX + points.east[k];
+        groundY[k] = camY + points.north[k];
+        ranges[k] = sqrt(points.north[k] * points.north[k] + points.east[k] * points.east[k] + points.down[k] * points.down[k]);
+        show[k] = points.show[k];
+    }
+    stamp = time;
+    valid = (n > 0);
+}
+
+bool GeoGrid::isValid() const
+{
+    return valid;
+}
+
+/** \brief Provides the time in which the image of the current grid is captured
+*/
+double GeoGrid::time() const
+{
+    return stamp;
+}
+
+/** \brief Finds the mesh cell containing an image point
+*
+* \param [in]   x       The horizontal coordinate of the image point
+* \param [in]   y       The vertical coordinate of the image point
+* \param [out]  i       The cell row
+* \param [out]  j       The cell column
+* \param [out]  fy      The vertical position of the point inside the cell, from 0 to 1
+* \param [out]  fx      The horizontal position of the point inside the cell, from 0 to 1
+*/
+inline void GeoGrid::locate(float x, float y, int &i, int &j, double &fy, double &fx) const
+{
+    double u = (double) x * (cols - 1) / imgWidth, v = (double) y * (rows - 1) / imgHeight;
+    j = std::min(std::max((int) u, 0), cols - 2);
+    i = std::min(std::max((int) v, 0), rows - 2);
+    fx = u - j;
+    fy = v - i;
+}
+
+/** \brief Provides the ground location and the slant range of an image point
+*
+* \param [in]   x       The horizontal coordinate of the image point
+* \param [in]   y       The vertical coordinate of the image point
+* \param [out]  X       The east coordinate of the ground point in the local frame
+* \param [out]  Y       The north coordinate of the ground point in the local frame
+* \param [out]  range   The distance from the camera to the ground point in meters
+*
+* \returns      true if the four surrounding nodes are mapped on the ground within the range. Otherwise, the
+*               outputs are interpolated between points on the rays at the maximum distance
+*/
+bool GeoGrid::sample(float x, float y, double &X, double &Y, double &range) const
+{
+    int i, j;
+    double fx, fy;
+    locate(x, y, i, j, fy, fx);
+
+    size_t k00 = (size_t) i * cols + j, k10 = k00 + cols;
+    double w00 = (1 - fx) * (1 - fy), w01 = fx * (1 - fy), w10 = (1 - fx) * fy, w11 = fx * fy;
+    X = w00 * groundX[k00] + w01 * groundX[k00 + 1] + w10 * groundX[k10] + w11 * groundX[k10 + 1];
+    Y = w00 * groundY[k00] + w01 * groundY[k00 + 1] + w10 * groundY[k10] + w11 * groundY[k10 + 1];
+    range = w00 * ranges[k00] + w01 * ranges[k00 + 1] + w10 * ranges[k10] + w11 * ranges[k10 + 1];
+
+    return show[k00] && show[k00 + 1] && show[k10] && show[k10 + 1];
+}
+
+/** \brief Provides the slant range of an image point; the cheap version of sample() for per pixel use
+*
+* \param [in]   x       The horizontal coordinate of the image point
+* \param [in]   y       The vertical coordinate of the image point
+*
+* \returns      The distance from the camera to the ground point in meters
+*/
+double GeoGrid::range(float x, float y) const
+{
+    int i, j;
+    double fx, fy;
+    locate(x, y, i, j, fy, fx);
+
+    size_t k00 = (size_t) i * cols + j, k10 = k00 + cols;
+    return (1 - fy) * ((1 - fx) * ranges[k00] + fx * ranges[k00 + 1]) +
+           fy * ((1 - fx) * ranges[k10] + fx * ranges[k10 + 1]);
+}
+
+/** \brief Calculates the ground area covered by an image box
+*
+* \param [in]   box     The image box
+* \param [out]  area    The area of the ground quadrilateral under the box corners, in square meters
+*
+* \returns      false if any of the box corners is not mapped on the ground within the range
+*/
+bool GeoGrid::footprint(const cv::Rect &box, double &area) const
+{
+    float xs[4] = {(float) box.x, (float) (box.x + box.width), (float) (box.x + box.width), (float) box.x};
+    float ys[4] = {(float) box.y, (float) box.y, (float) (box.y + box.height), (float) (box.y + box.height)};
+
+    double X[4], Y[4], range;
+    bool onGround = true;
+    for (int k = 0; k < 4; k++)
+        onGround = sample(xs[k], ys[k], X[k], Y[k], range) && onGround;
+
+    area = 0;
+    for (int k = 0; k < 4; k++)
+        area += X[k] * Y[(k + 1) % 4] - X[(k + 1) % 4] * Y[k];
+    area = fabs(area) / 2;
+
+    return onGround;
+}
+
+/** \brief Provides the bounding box of the image region which is mapped on the ground within the range
+*
+* \returns      The image box; empty if no node is mapped on the ground
+*/
+cv::Rect GeoGrid::groundRoi() const
+{
+    float minX = imgWidth, minY = imgHeight, maxX = 0, maxY = 0;
+    bool any = false;
+    for (size_t k = 0; k < show.size(); k++)
+    {
+        if (!show[k])
+            continue;
+        minX = std::min(minX, pixelX[k]);
+        minY = std::min(minY, pixelY[k]);
+        maxX = std::max(maxX, pixelX[k]);
+        maxY = std::max(maxY, pixelY[k]);
+        any = true;
+    }
+
+    if (!any)
+        return cv::Rect();
+    return cv::Rect(cv::Point((int) minX, (int) minY), cv::Point((int) ceil(maxX), (int) ceil(maxY)));
+}
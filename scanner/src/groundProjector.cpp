@@ -0,0 +1,123 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#include <math.h>
+#include <algorithm>
+#include "groundProjector.h"
+
+/** \brief Resizes all the result arrays; keeps their capacity
+*/
+void GroundProjector::Points::resize(size_t n)
+{
+    north.resize(n);
+    east.resize(n);
+    down.resize(n);
+    distance.resize(n);
+    show.resize(n);
+}
+
+/** \brief Sets the camera model
+*
+* \param [in]   camera_     The camera model providing the rays; it must outlive the projector
+*/
+void GroundProjector::setCamera(const CameraModel *camera_)
+{
+    camera = camera_;
+}
+
+/** \brief Calculates the unit inertial directions of one lane of image points
+*
+* \param [in]   table   The ray table of the camera
+* \param [in]   x       The horizontal coordinates of all the image points
+* \param [in]   y       The vertical coordinates of all the image points
+* \param [in]   start   The index of the first point of the lane
+* \param [in]   n       The number of all the image points. A last partial lane is padded with its last point
+* \param [in]   camToInertia    The camera (forward, right, down) to inertial (north, east, down) rotation
+* \param [out]  vn      The north components
+* \param [out]  ve      The east components
+* \param [out]  vd      The down components
+*/
+inline void GroundProjector::rayLane(const CameraModel::Rays &table, const float *x, const float *y, size_t start, size_t n,
+                                     const Eigen::Matrix3d &camToInertia, Lane &vn, Lane &ve, Lane &vd) const
+{
+    Lane right, down, forward;
+    for (int k = 0; k < LANES; k++)
+    {
+        size_t i = std::min(start + k, n - 1);
+        table.ray(x[i], y[i], right[k], down[k], forward[k]);
+    }
+
+    const Eigen::Matrix3d &R = camToInertia;
+    vn = R(0,0) * forward + R(0,1) * right + R(0,2) * down;
+    ve = R(1,0) * forward + R(1,1) * right + R(1,2) * down;
+    vd = R(2,0) * forward + R(2,1) * right + R(2,2) * down;
+}
+
+/** \brief Calculates the unit inertial direction of the ray of each image point
+*
+* \param [in]   x       The horizontal coordinates of the image points
+* \param [in]   y       The vertical coordinates of the image points
+* \param [in]   n       The number of the image points
+* \param [in]   camToInertia    The camera (forward, right, down) to inertial (north, east, down) rotation
+* \param [out]  out     The directions are written into the north, east and down arrays. The distance and show
+*                       arrays are only resized
+*/
+void GroundProjector::rays(const float *x, const float *y, size_t n, const Eigen::Matrix3d &camToInertia, Points &out) const
+{
+    out.resize(n);
+
+    // One table for the whole batch, even if the camera is configured again meanwhile
+    std::shared_ptr<const CameraModel::Rays> table = camera->rays();
+    Lane vn, ve, vd;
+    for (size_t s = 0; s < n; s += LANES)
+    {
+        rayLane(*table, x, y, s, n, camToInertia, vn, ve, vd);
+        size_t m = std::min((size_t) LANES, n - s);
+        std::copy_n(vn.data(), m, out.north.data() + s);
+        std::copy_n(ve.data(), m, out.east.data() + s);
+        std::copy_n(vd.data(), m, out.down.data() + s);
+    }
+}
+
+/** \brief Projects image points onto the ground plane
+*
+* \param [in]   x       The horizontal coordinates of the image points
+* \param [in]   y       The vertical coordinates of the image points
+* \param [in]   n       The number of the image points
+* \param [in]   camToInertia    The camera (forward, right, down) to inertial (north, east, down) rotation
+* \param [in]   height  The camera height above the ground plane in meters
+* \param [in]   maxDist The maximum length of the rays in meters
+* \param [out]  out     The ground points relative to the camera. A ray which does not hit the ground within the
+*                       maximum length is scaled to that length and its show flag is 0
+*/
+void GroundProjector::project(const float *x, const float *y, size_t n, const Eigen::Matrix3d &camToInertia,
+                              double height, double maxDist, Points &out) const
+{
+    out.resize(n);
+
+    // One table for the whole batch, even if the camera is configured again meanwhile
+    std::shared_ptr<const CameraModel::Rays> table = camera->rays();
+    Lane vn, ve, vd;
+    for (size_t s = 0; s < n; s += LANES)
+    {
+        rayLane(*table, x, y, s, n, camToInertia, vn, ve, vd);
+
+        // The rays are unit vectors, so the scale factor is the ray length itself
+        Lane factor = fabs(height) * vd.inverse();
+        Eigen::Array<bool, LANES, 1> hit = (vd > 0) && (factor < maxDist);
+        Lane scale = hit.select(factor, Lane::Constant(maxDist));
+        vn *= scale;
+        ve *= scale;
+        vd *= scale;
+        Lane dist = (vn.square() + ve.square()).sqrt();
+
+        size_t m = std::min((size_t) LANES, n - s);
+        std::copy_n(vn.data(), m, out.north.data() + s);
+        std::copy_n(ve.data(), m, out.east.data() + s);
+        std::copy_n(vd.data(), m, out.down.data() + s);
+        std::copy_n(dist.data(), m, out.distance.data() + s);
+        for (size_t k = 0; k < m; k++)
+            out.show[s + k] = hit[k];
+    }
+}
@@ -0,0 +1,75 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#include <math.h>
+#include "Eigen/Core"
+#include "localFrame.h"
+
+/** \brief Anchors the frame, unless it is anchored already
+*
+* \param [in]   lat     The anchor latitude in degrees
+* \param [in]   lng     The anchor longitude in degrees
+*
+* This function may be called from any thread
+*/
+void LocalFrame::setOrigin(double lat, double lng)
+{
+    static const double a = 6378137.0, e2 = 0.00669437999014, D2R = M_PI / 180.0;
+
+    std::lock_guard<std::mutex> lock(anchorMutex);
+    if (set)
+        return;
+
+    double s = sin(lat * D2R);
+    double w = 1 - e2 * s * s;
+    double meridianRadius = a * (1 - e2) / (w * sqrt(w));
+    double primeVerticalRadius = a / sqrt(w);
+
+    lat0 = lat;
+    lng0 = lng;
+    metersPerDegLat = meridianRadius * D2R;
+    metersPerDegLng = primeVerticalRadius * cos(lat * D2R) * D2R;
+    set = true;
+}
+
+bool LocalFrame::isSet() const
+{
+    return set;
+}
+
+/** \brief Converts a geodetic location into the frame
+*
+* \param [in]   lat     Latitude in degrees
+* \param [in]   lng     Longitude in degrees
+* \param [out]  east    East coordinate in meters
+* \param [out]  north   North coordinate in meters
+*/
+void LocalFrame::toLocal(double lat, double lng, double &east, double &north) const
+{
+    double dLng = lng - lng0;
+    if (dLng > 180)
+        dLng -= 360;
+    else if (dLng < -180)
+        dLng += 360;
+
+    east = dLng * metersPerDegLng;
+    north = (lat - lat0) * metersPerDegLat;
+}
+
+/** \brief Converts a batch of points of the frame into geodetic locations
+*
+* \param [in]   east    East coordinates in meters
+* \param [in]   north   North coordinates in meters
+* \param [out]  lat     Latitudes in degrees
+* \param [out]  lng     Longitudes in degrees
+* \param [in]   n       The number of points
+*/
+void LocalFrame::toGeodetic(const double *east, const double *north, double *lat, double *lng, size_t n) const
+{
+    Eigen::Map<const Eigen::ArrayXd> e(east, n), no(north, n);
+    Eigen::Map<Eigen::ArrayXd> la(lat, n), ln(lng, n);
+
+    la = lat0 + no * (1 / metersPerDegLat);
+    ln = lng0 + e * (1 / metersPerDegLng);
+}
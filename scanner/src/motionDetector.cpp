@@ -7,24 +7,56 @@
 
 /** \brief Constructor; sets the required initial parameter(s)
 *
-* \param [in]   hva_    Camera horizontal view angle
+* \param [in]   camera_     The camera model shared with the Scanner, which configures it with the image
+*                           resolution before any detection
 */
-MotionDetector::MotionDetector(float hva_)
+MotionDetector::MotionDetector(const CameraModel *camera_)
 {
-    hva = hva_;
+    camera = camera_;
 }
 
-/** \brief Calculates and sets the camera focal length
+/** \brief Sets the number of bands in which the dense optical flow is calculated
 *
-* \param [out]  w   Image width in pixels
+* \param [in]   bands   The number of horizontal bands the frame is split into, each one a task of the OpenCV
+*                       thread pool. 1 (default) calculates the flow on the whole frame at once
 *
-* This function sets the focal length (f) simply assuming that the camera focal point is exactly placed
-* in front of image center. Usually this assumption is not true. However the little error is negligible
+* The number of threads running the bands is that of the OpenCV pool, which the flow shares with the detector
+* network; the band count only bounds how many of them the flow can use at once. Keep it low enough to leave
+* the detector its own cores when both modes are used together
 */
-void MotionDetector::setFocalLength(int w)
+void MotionDetector::setFlowBands(int bands)
 {
-    fl = (float) (0.5 * w * (1.0 / tan((hva/2.0)*PI/180)));
-    focalLengthSet = true;
+    flowBands = max(1, bands);
+}
+
+/** \brief Suspends the motion detection and releases its buffers
+*
+* The previous frame, background model and motion tracks are dropped. The detection restarts from the
+* next image received while active
+*/
+void MotionDetector::release()
+{
+    active = false;
+    old_frame.release();
+    bgSubtractor.release();
+    tracker.reset();
+}
+
+/** \brief Sets the motion detection method
+*
+* \param [in]   mtd     The desired motion detection method (DENSE_FLOW or BACKGROUND_SUBTRACTION)
+* \param [in]   scale   The scale of the image on which the background model is maintained, in
+*                       BACKGROUND_SUBTRACTION method. 1.0 keeps the original resolution
+*
+* Changing the method restarts the detection from the next received image
+*/
+void MotionDetector::setMethod(MotionMethod mtd, float scale)
+{
+    if (mtd != method || scale != bgScale)
+        active = false;
+
+    method = mtd;
+    bgScale = scale;
 }
 
 /** \brief The main function which detects the moving objects within image
@@ -35,56 +67,74 @@ void MotionDetector::setFocalLength(int w)
 * \param [out]  objects A list of Object instances each including obtained information about a moving object
 * \param [in]   fov     A list of four Object instances each including a GPS location corresponding to one
 * 				        of the camera view corners
+* \param [in]   grid    The georeferencing grid of the image
 *
 * This function can be called whenever the camera image is available AND camera is in a fixed position.
 * It is called with an image synchronized with GPS and IMU data previously. Besides, the camera FOV points
 * must be mapped into the online map. The visual motion detection method is based on dense optical flow
 */
-void MotionDetector::detect(ImageSet &imgSt, cv::Mat &output, std::vector<Object> &objects, const std::vector<Object> &fov, bool actv)
+void MotionDetector::detect(ImageSet &imgSt, cv::Mat &output, std::vector<Object> &objects, const std::vector<Object> &fov, const GeoGrid &grid, bool actv)
 {
     if (!actv) {
-        active = false;
-        output = cv::Mat::zeros(imgSt.image.rows, imgSt.image.cols, CV_8UC3);
+        if (active)
+            release();
+        output = cv::Mat::zeros(imgSt.frame.rows(), imgSt.frame.cols(), CV_8UC3);
         return;
     }
     if (old_frame.empty() || !active)
     {
 //        __android_log_print(ANDROID_LOG_VERBOSE, "md ", "md1");
 
-        cv::cvtColor(imgSt.image, old_frame, cv::COLOR_RGB2GRAY);
-        output = cv::Mat::zeros(imgSt.image.rows, imgSt.image.cols, CV_8UC3);
+        old_frame = imgSt.frame.gray();
+        output = cv::Mat::zeros(imgSt.frame.rows(), imgSt.frame.cols(), CV_8UC3);
 //        __android_log_print(ANDROID_LOG_VERBOSE, "md ", "md2");
 
-        if (!focalLengthSet){
-//            __android_log_print(ANDROID_LOG_VERBOSE, "md ", "md3");
-
-            setFocalLength(imgSt.image.rows);
+        if (method == BACKGROUND_SUBTRACTION)
+        {
+            cv::Mat small, fgMask;
+            cv::resize(old_frame, small, cv::Size(), bgScale, bgScale, cv::INTER_AREA);
+            bgSubtractor = cv::createBackgroundSubtractorMOG2(200, 16, true);
+            bgSubtractor->apply(small, fgMask);
         }
 //        __android_log_print(ANDROID_LOG_VERBOSE, "md ", "md4");
+        tracker.reset();
         old_time = imgSt.time;
         active = true;
         return;
     }
 //    __android_log_print(ANDROID_LOG_VERBOSE, "md ", "md5");
 
-    cv::Mat frame = imgSt.image.clone();
+    // The luma plane is shared with the frame, which is never modified
+    cv::Mat new_frame = imgSt.frame.gray(), flow(old_frame.size(), CV_32FC2);
 
-    cv::Mat new_frame, flow(old_frame.size(), CV_32FC2);
-    cv::cvtColor(frame, new_frame, cv::COLOR_BGR2GRAY);
+    if (method == BACKGROUND_SUBTRACTION)
+    {
+        detectForeground(imgSt, new_frame, output, objects, fov, grid);
+        trackObjects(objects, output, imgSt.time);
+        old_frame = new_frame;
+        old_time = imgSt.time;
+        return;
+    }
 
-    cv::calcOpticalFlowFarneback(old_frame, new_frame, flow,  0.5, 3, 15, 3, 5, 1.2, 0);
-    cv::cvtColor(frame, old_frame, cv::COLOR_RGB2GRAY);
+    calcFlow(old_frame, new_frame, flow);
+    old_frame = new_frame;
 //    __android_log_print(ANDROID_LOG_VERBOSE, "md ", "md6");
 
-    cv::Mat xNormalizationCoeff(old_frame.size(), CV_64FC1), yNormalizationCoeff(old_frame.size(), CV_64FC1);
+    // The pixels which are not mapped on the ground (e.g. above the horizon) get no metric speed
+    cv::Rect roi(0, 0, old_frame.cols, old_frame.rows);
+    if (grid.isValid())
+        roi &= grid.groundRoi();
+    cv::Mat xNormalizationCoeff = cv::Mat::zeros(old_frame.size(), CV_64FC1), yNormalizationCoeff = cv::Mat::zeros(old_frame.size(), CV_64FC1);
+    cv::Mat xRoiCoeff = xNormalizationCoeff(roi), yRoiCoeff = yNormalizationCoeff(roi);
     // TODO: Using aircraft velocity data, this function must be called once every time the camera is fixed to detect motions, not real-time!
 //    __android_log_print(ANDROID_LOG_VERBOSE, "md ", "md7");
 
     double alpha;
-    calcNormCoeffMat(fov, imgSt.lat, imgSt.lng, imgSt.alt, xNormalizationCoeff, yNormalizationCoeff, alpha);
+    calcNormCoeffMat(fov, grid, xRoiCoeff, yRoiCoeff, alpha, roi);
 //    __android_log_print(ANDROID_LOG_VERBOSE, "md ", "md8");
 
-    visualize(flow, xNormalizationCoeff, yNormalizationCoeff, output, imgSt, objects, fov, alpha);
+    visualize(flow, xNormalizationCoeff, yNormalizationCoeff, output, imgSt, objects, fov, alpha, grid);
+    trackObjects(objects, output, imgSt.time);
     old_time = imgSt.time;
 //    __android_log_print(ANDROID_LOG_VERBOSE, "md ", "md9");
 
@@ -93,6 +143,63 @@ void MotionDetector::detect(ImageSet &imgSt, cv::Mat &output, std::vector<Object
 
 }
 
+/** \brief Calculates the dense optical flow between two gray frames, in parallel if desired
+*
+* \param [in]   prev    The previous gray frame
+* \param [in]   next    The current gray frame
+* \param [out]  flow    A two-channel image with each pixel containing horizontal and vertical pixel speed
+*
+* If more than one flow band is set, the frame is split into horizontal bands, each one extended by
+* flowBandOverlap rows on both sides so that the Farneback window and pyramid see enough context near the
+* band borders. The flow of each band is calculated on the OpenCV thread pool, and the overlapping rows of
+* two neighbour bands are blended linearly to avoid visible seams in the motion map
+*/
+void MotionDetector::calcFlow(const cv::Mat &prev, const cv::Mat &next, cv::Mat &flow)
+{
+    int rows = prev.rows;
+    int bands = min(flowBands, rows / (2 * flowBandOverlap));
+
+    if (bands <= 1)
+    {
+        cv::calcOpticalFlowFarneback(prev, next, flow,  0.5, 3, 15, 3, 5, 1.2, 0);
+        return;
+    }
+
+    std::vector<cv::Range> inner(bands), outer(bands);
+    std::vector<cv::Mat> bandFlows(bands);
+    for (int k = 0; k < bands; k++)
+    {
+        inner[k] = cv::Range(k * rows / bands, (k + 1) * rows / bands);
+        outer[k] = cv::Range(max(0, inner[k].start - flowBandOverlap), min(rows, inner[k].end + flowBandOverlap));
+    }
+
+    cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range &range) {
+        for (int k = range.start; k < range.end; k++)
+            cv::calcOpticalFlowFarneback(prev.rowRange(outer[k]), next.rowRange(outer[k]), bandFlows[k],  0.5, 3, 15, 3, 5, 1.2, 0);
+    }, bands);
+
+    flow.create(prev.size(), CV_32FC2);
+    for (int k = 0; k < bands; k++)
+    {
+        // Rows owned by a single band are copied as they are
+        int start = (k == 0 ? 0 : inner[k].start + flowBandOverlap);
+        int end = (k == bands - 1 ? rows : inner[k].end - flowBandOverlap);
+        bandFlows[k].rowRange(start - outer[k].start, end - outer[k].start).copyTo(flow.rowRange(start, end));
+
+        if (k == bands - 1)
+            continue;
+
+        // Rows covered by band k and band k+1 fade from the first one into the second one
+        for (int i = end; i < inner[k].end + flowBandOverlap; i++)
+        {
+            double w = (double) (i - end + 1) / (2 * flowBandOverlap + 1);
+            cv::Mat dst = flow.row(i);
+            cv::addWeighted(bandFlows[k].row(i - outer[k].start), 1.0 - w,
+                            bandFlows[k + 1].row(i - outer[k + 1].start), w, 0, dst);
+        }
+    }
+}
+
 /** \brief Visualizes the metric speeds in a gray image
 *
 * \param [in]   flow                An two-channel image with each pixel representative for horizontal or
@@ -102,6 +209,7 @@ void MotionDetector::detect(ImageSet &imgSt, cv::Mat &output, std::vector<Object
 * \param [in]   yNormalizationCoeff The matrix with each pixel containing the proper coefficient to transform
 *                                   the vertical pixel speed into a metric speed in the same direction
 * \param [in]   output              The output image with visualized moving objects
+* \param [in]   grid                The georeferencing grid of the image
 *
 * This function is called with two generated normalization coefficient matrices for both horizontal and
 * vertical directions. In the output image, the brighter a pixel is, the faster the corresponding point moves
@@ -114,7 +222,8 @@ void MotionDetector::visualize(const cv::Mat &flow,
                                ImageSet &image,
                                std::vector<Object> &objects,
                                const std::vector<Object> &fov,
-                               double alpha)
+                               double alpha,
+                               const GeoGrid &grid)
 {
     cv::Mat flow_parts[2], flow_parts_d[2], /*magnitude,*/ angle;
     cv::split(flow, flow_parts);
@@ -132,7 +241,7 @@ void MotionDetector::visualize(const cv::Mat &flow,
     metricNormalize(output);
 
 //    generateMovingRects(image, output, objects, metricFlowX, metricFlowY, fov, alpha, otpt);    //mm//
-    generateMovingRects(image.image, output, objects, metricFlowX, metricFlowY, fov, alpha);    //mm//
+    generateMovingRects(image.frame, output, objects, metricFlowX, metricFlowY, fov, alpha, grid);    //mm//
 
 //    calcObjectsVelocities(objects);
 }
@@ -175,110 +284,244 @@ double MotionDetector::calcTwoVectorsAngle(double v1_1, double v1_2, double v2_1
 *
 * \param [in]   fov                     A list of four "Object" structure instances each including a GPS
 * 				                        location corresponding to one of the camera view corners
-* \param [in]   lat                     Camera location latitude at the moment in which image is captured
-* \param [in]   lng                     Camera location longitude at the moment in which image is captured
-* \param [in]   alt                     Camera location altitude at the moment in which image is captured
+* \param [in]   grid                    The georeferencing grid of the image, providing the distance from the
+*                                       camera to the ground point of each pixel
 * \param [out]  xNormalizationCoeff     The matrix with each pixel containing the proper coefficient to transform
 *                                       the horizontal pixel speed into a metric speed in the same direction
 * \param [out]  yNormalizationCoeff     The matrix with each pixel containing the proper coefficient to transform
 *                                       the vertical pixel speed into a metric speed in the same direction
+* \param [out]  alpha                   The angle between the near edge of the FOV and its side edges
+* \param [in]   roi                     The image region for which the coefficients are calculated. The output
+*                                       matrices have the size of this region
 *
 * This function is called when the corresponding location for each camera FOV point is determined. It
 * calculates the normalization coefficient matrix, the matrix in which each pixel contains the required
-* value to multiply by the corresponding pixel speed, thus providing the metric speed of that point
+* value to multiply by the corresponding pixel speed, thus providing the metric speed of that point. The
+* ground distance of each pixel is sampled from the georeferencing grid, which is projected exactly
+* (including the terrain, if enabled), rather than interpolated between the FOV corners
 */
-void MotionDetector::calcNormCoeffMat(const std::vector<Object> &fov, double lat, double lng, double alt, cv::Mat &xNormalizationCoeff, cv::Mat &yNormalizationCoeff, double &alpha)
+void MotionDetector::calcNormCoeffMat(const std::vector<Object> &fov, const GeoGrid &grid, cv::Mat &xNormalizationCoeff, cv::Mat &yNormalizationCoeff, double &alpha, const cv::Rect &roi)
 {
-    double x, y;
-    LatLonToUTMXY(lat, lng, 0, x, y);
-
     double v1_1 = fov[0].location.x-fov[1].location.x, v1_2 = fov[0].location.y-fov[1].location.y, v2_1 = fov[2].location.x-fov[1].location.x, v2_2 = fov[2].location.y-fov[1].location.y;
     alpha = (PI/2) - abs(calcTwoVectorsAngle(v1_1, v1_2, v2_1, v2_2));
 //    __android_log_print(ANDROID_LOG_VERBOSE, "--- motion detector c alpha ", "%s", std::to_string(alpha).c_str());
 
-    int rows = old_frame.rows, cols = old_frame.cols;
-    for (int i=0; i<rows; i++) {
-        double rowFirstX = fov[0].location.x + i*(fov[3].location.x - fov[0].location.x)/rows;
-        double rowFirstY = fov[0].location.y + i*(fov[3].location.y - fov[0].location.y)/rows;
-        double rowLastX = fov[1].location.x + i*(fov[2].location.x - fov[1].location.x)/rows;
-        double rowLastY = fov[1].location.y + i*(fov[2].location.y - fov[1].location.y)/rows;
-        for (int j=0; j<cols; j++) {
-            double X = rowFirstX + j*(rowLastX - rowFirstX)/cols;
-            double Y = rowFirstY + j*(rowLastY - rowFirstY)/cols;
-            double h = sqrt(pow(((double)j-((double)cols/2)),2) + pow(((double)i-((double)rows/2)),2) + pow(fl,2));
-            double xCoeff = sqrt(pow(x-X, 2)+pow(y-Y, 2)+pow(alt,2))/h;
-            xNormalizationCoeff.at<double>(i,j) = xCoeff;
-            yNormalizationCoeff.at<double>(i,j) = xCoeff/cos(((double)j/((double)cols/2))*alpha);
+    int cols = old_frame.cols;
+    std::shared_ptr<const CameraModel::Rays> rays = camera->rays();
+    for (int i=roi.y; i<roi.y+roi.height; i++) {
+        for (int j=roi.x; j<roi.x+roi.width; j++) {
+            double right, down, forward;
+            rays->ray((float) j, (float) i, right, down, forward);
+            double h = rays->focalLength() / forward;
+            double xCoeff = grid.range((float) j, (float) i)/h;
+            xNormalizationCoeff.at<double>(i-roi.y,j-roi.x) = xCoeff;
+            yNormalizationCoeff.at<double>(i-roi.y,j-roi.x) = xCoeff/cos(((double)j/((double)cols/2))*alpha);
         }
     }
 }
 
 /** \brief Extracts a list of Object instances from an image of moving objects and highlights each object
 *
-* \param [in]   input       The input image with visualized moving objects
+* \param [in]   frame       The camera frame; its colour image, from which the object pictures are cut, is
+*                           only converted if a moving object is found
 * \param [out]  output      The output image with highlighted moving objects within
 * \param [out]  objects     A list containing data for each detected moving object
+* \param [in]   mfx         The horizontal metric speed of each pixel
+* \param [in]   mfy         The vertical metric speed of each pixel
+* \param [in]   grid        The georeferencing grid of the image, used to reject the blobs off the ground
 *
-* This function is called when the gray image of moving objects is generated
+* This function is called when the gray image of moving objects is generated. The fast pixels are labeled
+* as connected components, which provides the area and bounding box of each blob at once. The metric
+* speeds of each blob are then summed in a single pass over the label image, so the cost of this stage
+* does not depend on the number of blobs. The speed of an object is the mean speed of its own pixels
 */
-void MotionDetector::generateMovingRects(cv::Mat &input,
+void MotionDetector::generateMovingRects(const Frame &frame,
                                          cv::Mat &output,
                                          std::vector<Object> &objects,
                                          const cv::Mat &mfx,
                                          const cv::Mat &mfy,
                                          const std::vector<Object> &fov,
-                                         double alpha)
-//                                         cv::Mat & otpt)                //mm//
+                                         double alpha,
+                                         const GeoGrid &grid)
 {
-    std::vector<std::vector<cv::Point>> contours;
-    std::vector<cv::Vec4i> hierarchy;
-    Mat otpt;                                                     //mm//
+    cv::Mat mask, labels, stats, centroids;
 
-    cv::threshold(output, otpt, (minimumDetectionSpeed/objMaxSpeed)*255.0, 255, THRESH_BINARY);
     output.convertTo(output, CV_8U);
-    otpt.convertTo(otpt, CV_8U);
-    findContours(otpt, contours, hierarchy, cv::RETR_LIST, cv::CHAIN_APPROX_TC89_KCOS, cv::Point(0, 0) );
+    cv::threshold(output, mask, (minimumDetectionSpeed/objMaxSpeed)*255.0, 255, THRESH_BINARY);
+    int n = cv::connectedComponentsWithStats(mask, labels, stats, centroids, 8, CV_32S);
+
+    std::vector<double> xSum(n, 0.0), ySum(n, 0.0);
+    for (int i = 0; i < labels.rows; i++) {
+        const int *label = labels.ptr<int>(i);
+        const double *fx = mfx.ptr<double>(i), *fy = mfy.ptr<double>(i);
+        for (int j = 0; j < labels.cols; j++) {
+            if (label[j] == 0) continue;
+            xSum[label[j]] += fx[j];
+            ySum[label[j]] += fy[j];
+        }
+    }
 
     objects.clear();
-    double area, areaRatio, imArea = output.rows * output.cols;
-    for (auto & contour : contours) {
-        area = cv::contourArea(contour);
-        areaRatio = area / imArea;
+    double imArea = output.rows * output.cols;
+    for (int k = 1; k < n; k++) {
+        int area = stats.at<int>(k, cv::CC_STAT_AREA);
+        double areaRatio = area / imArea;
         if (areaRatio < objectSizeUpLimit && areaRatio > objectSizeLowLimit)
         {
-            Object obj;
-//            __android_log_print(ANDROID_LOG_VERBOSE, "--- motion detector crop ", "1");
-            obj.box = cv::boundingRect(contour);
-            saturateBox(input.cols, input.rows, obj.box);
-//            __android_log_print(ANDROID_LOG_VERBOSE, "--- motion detector crop box.width", "%s", std::to_string(obj.box.width).c_str());
-//            __android_log_print(ANDROID_LOG_VERBOSE, "--- motion detector crop box.height", "%s", std::to_string(obj.box.height).c_str());
-//            __android_log_print(ANDROID_LOG_VERBOSE, "--- motion detector crop box.x", "%s", std::to_string(obj.box.x).c_str());
-//            __android_log_print(ANDROID_LOG_VERBOSE, "--- motion detector crop box.y", "%s", std::to_string(obj.box.y).c_str());
-//            __android_log_print(ANDROID_LOG_VERBOSE, "--- motion detector crop frame.rows", "%s", std::to_string(input.rows).c_str());
-//            __android_log_print(ANDROID_LOG_VERBOSE, "--- motion detector crop frame.cols", "%s", std::to_string(input.cols).c_str());
-
-            cv::Rect rct = scaleRect(obj.box.x, obj.box.y, obj.box.width, obj.box.height, 1.5);
-            saturateBox(input.cols, input.rows, rct);
-            obj.picture = input(rct);
-//            obj.picture = input(obj.box);
-            obj.center = cv::Point((obj.box.x + obj.box.width/2),(obj.box.y + obj.box.height/2));
-
-            double xSpeed = cv::mean(mfx(obj.box))[0];
-            double ySpeed = cv::mean(mfy(obj.box))[0];
-            calcObjectsVelocities(obj, fov, alpha, xSpeed, ySpeed);
-//            __android_log_print(ANDROID_LOG_VERBOSE, "--- motion detector direction", "%s", std::to_string(obj.direction).c_str());
-
-//            __android_log_print(ANDROID_LOG_VERBOSE, "--- motion detector crop ", "3");
-//
-            obj.type = Object::MOVING;
+            cv::Rect box(stats.at<int>(k, cv::CC_STAT_LEFT), stats.at<int>(k, cv::CC_STAT_TOP),
+                         stats.at<int>(k, cv::CC_STAT_WIDTH), stats.at<int>(k, cv::CC_STAT_HEIGHT));
+            if (!onGround(grid, box))
+                continue;
+
+            Object obj = createMovingObject(frame.bgr(), box, fov, alpha, xSum[k] / area, ySum[k] / area);
             objects.push_back(obj);
             rectangle(output, obj.box, cv::Scalar(255,255,0), 3, 1);
-//            rectangle(otpt, obj.box, cv::Scalar(255,255,0), 3, 1);                  //mm//
-//            __android_log_print(ANDROID_LOG_VERBOSE, "--- motion detector crop ", "4");
         }
     }
 }
 
+/** \brief Tells whether an image box may hold a moving object on the ground
+*
+* \param [in]   grid    The georeferencing grid of the image
+* \param [in]   box     The image box of a blob
+*
+* \returns      false if a corner of the box is not mapped on the ground within the range, so its speed cannot
+*               be measured, or if the box covers more ground than any moving object (maxObjectArea); true if
+*               the grid is not available
+*/
+bool MotionDetector::onGround(const GeoGrid &grid, const cv::Rect &box) const
+{
+    if (!grid.isValid())
+        return true;
+
+    double area;
+    return grid.footprint(box, area) && area <= maxObjectArea;
+}
+
+/** \brief Detects the moving objects using a background model and calculates their speed using optical flow
+*
+* \param [in]   imgSt       The ImageSet instance containing camera image along with corresponding GPS location
+* \param [in]   gray        The gray version of the camera image
+* \param [out]  output      A gray image with the foreground blobs highlighted with respect to their speed
+* \param [out]  objects     A list of Object instances each including obtained information about a moving object
+* \param [in]   fov         A list of four Object instances each including a GPS location corresponding to one
+* 				            of the camera view corners
+* \param [in]   grid        The georeferencing grid of the image
+*
+* The background model is updated on a reduced resolution image (bgScale). Each foreground blob within the
+* object size limits is taken back to the original resolution, and the dense optical flow along with the
+* normalization coefficients are calculated only inside its (enlarged) bounding box. The blob speed is the
+* mean metric speed of its foreground pixels
+*/
+void MotionDetector::detectForeground(ImageSet &imgSt, const cv::Mat &gray, cv::Mat &output, std::vector<Object> &objects, const std::vector<Object> &fov, const GeoGrid &grid)
+{
+    cv::Mat small, fgMask, fullMask;
+    cv::resize(gray, small, cv::Size(), bgScale, bgScale, cv::INTER_AREA);
+    bgSubtractor->apply(small, fgMask);
+
+    // MOG2 marks shadows with 127; only the definite foreground is kept
+    cv::threshold(fgMask, fgMask, 200, 255, THRESH_BINARY);
+    cv::morphologyEx(fgMask, fgMask, cv::MORPH_OPEN, cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(3, 3)));
+    cv::resize(fgMask, fullMask, gray.size(), 0, 0, cv::INTER_NEAREST);
+
+    cv::Mat labels, stats, centroids;
+    int n = cv::connectedComponentsWithStats(fgMask, labels, stats, centroids, 8, CV_32S);
+
+    output = cv::Mat::zeros(gray.rows, gray.cols, CV_8U);
+    objects.clear();
+
+    double alpha, dt = imgSt.time - old_time, imArea = small.rows * small.cols;
+    for (int k = 1; k < n; k++) {
+        double areaRatio = stats.at<int>(k, cv::CC_STAT_AREA) / imArea;
+        if (areaRatio >= objectSizeUpLimit || areaRatio <= objectSizeLowLimit)
+            continue;
+
+        cv::Rect sBox(stats.at<int>(k, cv::CC_STAT_LEFT), stats.at<int>(k, cv::CC_STAT_TOP),
+                      stats.at<int>(k, cv::CC_STAT_WIDTH), stats.at<int>(k, cv::CC_STAT_HEIGHT));
+        cv::Rect box((int) (sBox.x / bgScale), (int) (sBox.y / bgScale), (int) (sBox.width / bgScale), (int) (sBox.height / bgScale));
+        saturateBox(gray.cols, gray.rows, box);
+        if (!onGround(grid, box))
+            continue;
+
+        // The flow window needs some context around the blob
+        cv::Rect roi = scaleRect(box.x, box.y, box.width, box.height, 1.5);
+        saturateBox(gray.cols, gray.rows, roi);
+
+        cv::Mat flow, flow_parts[2], metricFlowX, metricFlowY, speed, angle;
+        cv::calcOpticalFlowFarneback(old_frame(roi), gray(roi), flow,  0.5, 3, 15, 3, 5, 1.2, 0);
+        cv::split(flow, flow_parts);
+        flow_parts[0].convertTo(metricFlowX, CV_64F);
+        flow_parts[1].convertTo(metricFlowY, CV_64F);
+
+        cv::Mat xNormalizationCoeff(roi.size(), CV_64FC1), yNormalizationCoeff(roi.size(), CV_64FC1);
+        calcNormCoeffMat(fov, grid, xNormalizationCoeff, yNormalizationCoeff, alpha, roi);
+        metricFlowX = metricFlowX.mul(xNormalizationCoeff) / dt;
+        metricFlowY = metricFlowY.mul(yNormalizationCoeff) / dt;
+
+        cv::Mat blobMask = fullMask(roi);
+        cv::cartToPolar(metricFlowX, metricFlowY, speed, angle, true);
+        metricNormalize(speed);
+        speed.convertTo(speed, CV_8U);
+        speed.copyTo(output(roi), blobMask);
+
+        double xSpeed = cv::mean(metricFlowX, blobMask)[0];
+        double ySpeed = cv::mean(metricFlowY, blobMask)[0];
+        if (sqrt(xSpeed*xSpeed + ySpeed*ySpeed) < minimumDetectionSpeed)
+            continue;
+
+        Object obj = createMovingObject(imgSt.frame.bgr(), box, fov, alpha, xSpeed, ySpeed);
+        objects.push_back(obj);
+        rectangle(output, obj.box, cv::Scalar(255,255,0), 3, 1);
+    }
+}
+
+/** \brief Replaces the moving objects of the current image with the confirmed motion tracks
+*
+* \param [in,out]   objects     At input, the moving objects detected in the current image. At output, the
+*                               tracked moving objects with their ids and smoothed velocities
+* \param [in,out]   output      The image with highlighted moving objects, on which the track ids are written
+* \param [in]       time        The time in which the image is captured
+*/
+void MotionDetector::trackObjects(std::vector<Object> &objects, cv::Mat &output, double time)
+{
+    tracker.update(objects, time);
+
+    for (auto & obj : objects)
+    {
+        obj.direction = (calcTwoVectorsAngle(obj.xSpeed, obj.ySpeed, 1.0, 0.0) + PI/2)*180/PI;
+        putText(output, std::to_string(obj.id), obj.box.tl(), cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(255,255,0), 2);
+    }
+}
+
+/** \brief Generates an Object instance for a moving object
+*
+* \param [in]   input   The camera image in which the object is detected
+* \param [in]   box     The object's bounding box in the image
+* \param [in]   fov     A list of four Object instances each including a GPS location corresponding to one
+* 				        of the camera view corners
+* \param [in]   alpha   The angle between the near edge of the FOV and its side edges
+* \param [in]   xSpeed  The object's horizontal metric speed
+* \param [in]   ySpeed  The object's vertical metric speed
+*
+* \returns      The moving object with its cropped picture, center and velocity set
+*/
+Object MotionDetector::createMovingObject(const cv::Mat &input, const cv::Rect &box, const std::vector<Object> &fov, double alpha, double xSpeed, double ySpeed)
+{
+    Object obj;
+    obj.box = box;
+    saturateBox(input.cols, input.rows, obj.box);
+
+    cv::Rect rct = scaleRect(obj.box.x, obj.box.y, obj.box.width, obj.box.height, 1.5);
+    saturateBox(input.cols, input.rows, rct);
+    obj.picture = input(rct);
+    obj.center = cv::Point((obj.box.x + obj.box.width/2),(obj.box.y + obj.box.height/2));
+
+    calcObjectsVelocities(obj, fov, alpha, xSpeed, ySpeed);
+
+    obj.type = Object::MOVING;
+    return obj;
+}
+
 cv::Rect MotionDetector::scaleRect(int x, int y, int w, int h, float ratio)
 {
     int new_w = w * ratio;
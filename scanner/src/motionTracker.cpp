@@ -0,0 +1,195 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#include <algorithm>
+#include "motionTracker.h"
+
+/** \brief Constructor; sets the track management parameters
+*
+* \param [in]   min_hits    The number of consecutive detections after which a track is confirmed
+* \param [in]   max_misses  The number of consecutive missed images after which a track is deleted
+* \param [in]   gate        The maximum distance (pixels) between a predicted track and a detection to be
+*                           associated together
+*/
+MotionTracker::MotionTracker(int min_hits, int max_misses, float gate)
+{
+    minHits = min_hits;
+    maxMisses = max_misses;
+    gateRadius = gate;
+}
+
+/** \brief Deletes all the tracks
+*
+* This function is called whenever the motion detection restarts, e.g. when the camera is not fixed anymore
+*/
+void MotionTracker::reset()
+{
+    tracks.clear();
+    lastTime = -1;
+}
+
+/** \brief Initializes the filter of a new track with a moving object
+*
+* \param [out]  track   The new track
+* \param [in]   obj     The moving object which starts the track
+*
+* The filter state is [u, v, du, dv, xSpeed, ySpeed]; the center of the object in the image, its pixel
+* velocity and its metric velocity. The measurement is [u, v, xSpeed, ySpeed]
+*/
+void MotionTracker::initTrack(Track &track, const Object &obj)
+{
+    track.kf.init(6, 4, 0, CV_64F);
+
+    cv::setIdentity(track.kf.transitionMatrix);
+    track.kf.measurementMatrix = cv::Mat::zeros(4, 6, CV_64F);
+    track.kf.measurementMatrix.at<double>(0, 0) = 1.0;
+    track.kf.measurementMatrix.at<double>(1, 1) = 1.0;
+    track.kf.measurementMatrix.at<double>(2, 4) = 1.0;
+    track.kf.measurementMatrix.at<double>(3, 5) = 1.0;
+
+    track.kf.measurementNoiseCov = (cv::Mat_<double>(4, 4) << 16, 0, 0, 0,
+                                                              0, 16, 0, 0,
+                                                              0, 0, 0.25, 0,
+                                                              0, 0, 0, 0.25);
+
+    track.kf.statePost = (cv::Mat_<double>(6, 1) << obj.center.x, obj.center.y, 0, 0, obj.xSpeed, obj.ySpeed);
+    track.kf.errorCovPost = cv::Mat::diag((cv::Mat_<double>(6, 1) << 16, 16, 400, 400, 0.25, 0.25));
+
+    track.object = obj;
+}
+
+/** \brief Predicts the track state at the current image
+*
+* \param [in,out]   track   The track to predict
+* \param [in]       dt      The time elapsed since the previous image
+*/
+void MotionTracker::predict(Track &track, double dt)
+{
+    track.kf.transitionMatrix.at<double>(0, 2) = dt;
+    track.kf.transitionMatrix.at<double>(1, 3) = dt;
+
+    // Piecewise white acceleration for the pixel motion, random walk for the metric speed
+    double q = 100.0, qs = 1.0;
+    double dt2 = dt*dt, dt3 = dt2*dt / 2, dt4 = dt2*dt2 / 4;
+    track.kf.processNoiseCov = (cv::Mat_<double>(6, 6) << q*dt4, 0, q*dt3, 0, 0, 0,
+                                                          0, q*dt4, 0, q*dt3, 0, 0,
+                                                          q*dt3, 0, q*dt2, 0, 0, 0,
+                                                          0, q*dt3, 0, q*dt2, 0, 0,
+                                                          0, 0, 0, 0, qs*dt, 0,
+                                                          0, 0, 0, 0, 0, qs*dt);
+
+    cv::Mat state = track.kf.predict();
+
+    // The track box follows the predicted center, so a coasting track is drawn and mapped in place
+    int u = (int) state.at<double>(0), v = (int) state.at<double>(1);
+    track.object.box.x = u - track.object.box.width / 2;
+    track.object.box.y = v - track.object.box.height / 2;
+    track.object.center = cv::Point2f((float) u, (float) v);
+}
+
+/** \brief Corrects the track state with an associated moving object
+*
+* \param [in,out]   track   The track to correct
+* \param [in]       obj     The moving object associated with the track
+*
+* The track takes the object data, with the filtered center and speed
+*/
+void MotionTracker::correct(Track &track, const Object &obj)
+{
+    cv::Mat measurement = (cv::Mat_<double>(4, 1) << obj.center.x, obj.center.y, obj.xSpeed, obj.ySpeed);
+    cv::Mat state = track.kf.correct(measurement);
+
+    // The box keeps the detected size, around the filtered center
+    track.object = obj;
+    float u = (float) state.at<double>(0), v = (float) state.at<double>(1);
+    track.object.center = cv::Point2f(u, v);
+    track.object.box.x = (int) (u - track.object.box.width / 2.0f);
+    track.object.box.y = (int) (v - track.object.box.height / 2.0f);
+    track.object.xSpeed = state.at<double>(4);
+    track.object.ySpeed = state.at<double>(5);
+}
+
+/** \brief Updates the tracks with the moving objects of a new image
+*
+* \param [in,out]   objects     At input, the moving objects detected in the new image. At output, the
+*                               confirmed tracks, each with its id and smoothed speed
+* \param [in]       time        The time in which the image is captured
+*
+* The detections are associated to the predicted tracks greedily, in the order of increasing distance,
+* if the distance is less than the gate radius or half the detection box diagonal. The unassociated
+* detections start new (tentative) tracks. A tentative track is deleted as soon as it is missed, while a
+* confirmed one coasts on its prediction for up to maxMisses images
+*/
+void MotionTracker::update(std::vector<Object> &objects, double time)
+{
+    double dt = (lastTime < 0 ? 0.0 : time - lastTime);
+    lastTime = time;
+
+    for (auto & track : tracks)
+        predict(track, dt);
+
+    struct Pair { double dist; int t, d; };
+    std::vector<Pair> pairs;
+    for (int t = 0; t < tracks.size(); t++)
+    {
+        for (int d = 0; d < objects.size(); d++)
+        {
+            double dx = tracks[t].object.center.x - objects[d].center.x;
+            double dy = tracks[t].object.center.y - objects[d].center.y;
+            double dist = sqrt(dx*dx + dy*dy);
+            double w = objects[d].box.width, h = objects[d].box.height;
+            double gate = std::max((double) gateRadius, 0.5*sqrt(w*w + h*h));
+            if (dist < gate)
+                pairs.push_back({dist, t, d});
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const Pair &a, const Pair &b) { return a.dist < b.dist; });
+
+    std::vector<bool> trackUsed(tracks.size(), false), objectUsed(objects.size(), false);
+    for (auto & pair : pairs)
+    {
+        if (trackUsed[pair.t] || objectUsed[pair.d]) continue;
+        trackUsed[pair.t] = objectUsed[pair.d] = true;
+
+        Track &track = tracks[pair.t];
+        correct(track, objects[pair.d]);
+        track.hits++;
+        track.misses = 0;
+    }
+
+    for (int t = 0; t < tracks.size(); t++)
+    {
+        if (!trackUsed[t])
+        {
+            tracks[t].misses++;
+            tracks[t].hits = 0;
+        }
+    }
+
+    tracks.erase(std::remove_if(tracks.begin(), tracks.end(), [this](const Track &track) {
+        return track.misses > (track.confirmed ? maxMisses : 0);
+    }), tracks.end());
+
+    for (int d = 0; d < objects.size(); d++)
+    {
+        if (objectUsed[d]) continue;
+        Track track;
+        track.id = nextId++;
+        initTrack(track, objects[d]);
+        tracks.push_back(track);
+    }
+
+    objects.clear();
+    for (auto & track : tracks)
+    {
+        bool newlyConfirmed = (!track.confirmed && track.hits >= minHits);
+        track.confirmed = track.confirmed || newlyConfirmed;
+        if (!track.confirmed) continue;
+
+        Object obj = track.object;
+        obj.id = track.id;
+        obj.action = (newlyConfirmed ? Object::ADD : Object::UPDATE);
+        objects.push_back(obj);
+    }
+}
@@ -0,0 +1,111 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#include <math.h>
+#include <algorithm>
+#include "objectIndex.h"
+
+/** \brief Constructor; sets the cell size
+*
+* \param [in]   cellSize    The cell side in meters; the association gate is a good choice
+*/
+ObjectIndex::ObjectIndex(double cellSize)
+{
+    cell = cellSize;
+}
+
+/** \brief Packs the object type and the cell coordinates into a hash key
+*
+* The type takes the top 8 bits and each coordinate 28 bits, enough for ±400000 km with 3 m cells
+*/
+inline uint64_t ObjectIndex::key(int type, int64_t cx, int64_t cy) const
+{
+    static const uint64_t mask = (1ULL << 28) - 1;
+    return ((uint64_t) type << 56) | (((uint64_t) cx & mask) << 28) | ((uint64_t) cy & mask);
+}
+
+inline int64_t ObjectIndex::cellOf(double v) const
+{
+    return (int64_t) floor(v / cell);
+}
+
+void ObjectIndex::clear()
+{
+    cells.clear();
+}
+
+/** \brief Indexes a map object
+*
+* \param [in]   idx     The object index in the map object list
+* \param [in]   type    The object type
+* \param [in]   x       The object east coordinate in the local frame
+* \param [in]   y       The object north coordinate in the local frame
+*/
+void ObjectIndex::insert(int idx, int type, double x, double y)
+{
+    cells[key(type, cellOf(x), cellOf(y))].push_back(idx);
+}
+
+/** \brief Drops a map object from the index
+*
+* \param [in]   idx     The object index in the map object list
+* \param [in]   type    The object type
+* \param [in]   x       The east coordinate the object is indexed with
+* \param [in]   y       The north coordinate the object is indexed with
+*/
+void ObjectIndex::remove(int idx, int type, double x, double y)
+{
+    auto it = cells.find(key(type, cellOf(x), cellOf(y)));
+    if (it == cells.end())
+        return;
+
+    std::vector<int> &members = it->second;
+    auto pos = std::find(members.begin(), members.end(), idx);
+    if (pos != members.end())
+    {
+        *pos = members.back();
+        members.pop_back();
+    }
+    if (members.empty())
+        cells.erase(it);
+}
+
+/** \brief Relocates a map object; nothing is done if it stays in the same cell
+*
+* \param [in]   idx     The object index in the map object list
+* \param [in]   type    The object type
+* \param [in]   x0      The east coordinate the object is indexed with
+* \param [in]   y0      The north coordinate the object is indexed with
+* \param [in]   x1      The new east coordinate
+* \param [in]   y1      The new north coordinate
+*/
+void ObjectIndex::move(int idx, int type, double x0, double y0, double x1, double y1)
+{
+    if (cellOf(x0) == cellOf(x1) && cellOf(y0) == cellOf(y1))
+        return;
+    remove(idx, type, x0, y0);
+    insert(idx, type, x1, y1);
+}
+
+/** \brief Provides the objects of a type in the cells overlapping a square around a point
+*
+* \param [in]   type    The object type
+* \param [in]   x       The east coordinate of the point
+* \param [in]   y       The north coordinate of the point
+* \param [in]   radius  The half side of the square in meters
+* \param [out]  out     The indices of the objects; a superset of those within the radius
+*/
+void ObjectIndex::query(int type, double x, double y, double radius, std::vector<int> &out) const
+{
+    out.clear();
+    int64_t x0 = cellOf(x - radius), x1 = cellOf(x + radius);
+    int64_t y0 = cellOf(y - radius), y1 = cellOf(y + radius);
+    for (int64_t cx = x0; cx <= x1; cx++)
+        for (int64_t cy = y0; cy <= y1; cy++)
+        {
+            auto it = cells.find(key(type, cx, cy));
+            if (it != cells.end())
+                out.insert(out.end(), it->second.begin(), it->second.end());
+        }
+}
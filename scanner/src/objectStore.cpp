@@ -0,0 +1,223 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#include <math.h>
+#include <algorithm>
+#include "objectStore.h"
+
+/** \brief Constructor; sets the association gate and the ageing parameters
+*
+* \param [in]   gate_       The maximum distance in meters between a detection and the map object it updates
+* \param [in]   maxAge_     The time in seconds after which an object not seen again is evicted; 0 to
+*                           keep the objects until the store is full
+* \param [in]   capacity_   The maximum number of map objects
+*/
+ObjectStore::ObjectStore(double gate_, double maxAge_, size_t capacity_) : index(gate_)
+{
+    gate = gate_;
+    maxAge = maxAge_;
+    capacity = std::max(capacity_, (size_t) 1);
+}
+
+/** \brief Sets the ageing parameters; applied from the next update
+*
+* \param [in]   maxAge_     The time in seconds after which an object not seen again is evicted; 0 to
+*                           keep the objects until the store is full
+* \param [in]   capacity_   The maximum number of map objects
+*/
+void ObjectStore::setAgeing(double maxAge_, size_t capacity_)
+{
+    maxAge = maxAge_;
+    capacity = std::max(capacity_, (size_t) 1);
+}
+
+inline int64_t ObjectStore::trackKey(const Object &object)
+{
+    return ((int64_t) object.type << 32) | (uint32_t) object.id;
+}
+
+/** \brief Provides a free slot, reusing the ones of evicted objects first
+*/
+int ObjectStore::allocate()
+{
+    if (!freeSlots.empty())
+    {
+        int k = freeSlots.back();
+        freeSlots.pop_back();
+        return k;
+    }
+    slots.emplace_back();
+    lastSeen.push_back(0);
+    used.push_back(0);
+    return (int) slots.size() - 1;
+}
+
+/** \brief Evicts a map object and outputs its REMOVE action
+*
+* \param [in]       k       The object slot
+* \param [in,out]   output  The list of map changes
+*/
+void ObjectStore::evict(int k, std::vector<Object> &output)
+{
+    Object &object = slots[k];
+    if (object.id >= 0)
+        tracked.erase(trackKey(object));
+    else
+        index.remove(k, object.type, object.location.x, object.location.y);
+
+    output.push_back(object);
+    output.back().action = Object::REMOVE;
+    output.back().lastIdx = k;
+    output.back().picture = cv::Mat();
+
+    object = Object();
+    used[k] = 0;
+    freeSlots.push_back(k);
+    count--;
+}
+
+/** \brief Associates the mapped objects of an image with the map objects and provides the map changes
+*
+* \param [in,out]   objects     The mapped objects of the last image as input; the map changes as output
+* \param [in]       time        The time in which the image is captured, in seconds
+*
+* Objects with a track id (moving objects) are matched to the map object with the same type and id.
+* Others are matched to the nearest untracked map object of the same type within the association gate,
+* looked up in the spatial index; the pairs are assigned greedily, in the order of increasing distance,
+* so each map object is updated by one object at most. Unmatched objects are added to the map
+*/
+void ObjectStore::update(std::vector<Object> &objects, double time)
+{
+    std::vector<Object> output;
+
+    // Ageing
+    if (maxAge > 0)
+    {
+        for (int k = 0; k < slots.size(); k++)
+            if (used[k] && time - lastSeen[k] > maxAge)
+                evict(k, output);
+    }
+
+    // Gated nearest neighbour assignment of the untracked objects
+    struct Candidate
+    {
+        double dist;
+        int object, slot;
+    };
+    std::vector<Candidate> candidates;
+    std::vector<int> neighbours;
+
+    for (int i = 0; i < objects.size(); i++)
+    {
+        const Object &object = objects[i];
+        if (object.id >= 0)
+            continue;
+
+        index.query(object.type, object.location.x, object.location.y, gate, neighbours);
+        for (int k : neighbours)
+        {
+            double dx = slots[k].location.x - object.location.x, dy = slots[k].location.y - object.location.y;
+            double dist = sqrt(dx * dx + dy * dy);
+            if (dist < gate)
+                candidates.push_back({dist, i, k});
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate &a, const Candidate &b) { return a.dist < b.dist; });
+
+    std::vector<int> match(objects.size(), -1), matchedSlots;
+    for (const Candidate &c : candidates)
+    {
+        if (match[c.object] >= 0 ||
+            std::find(matchedSlots.begin(), matchedSlots.end(), c.slot) != matchedSlots.end())
+            continue;
+        match[c.object] = c.slot;
+        matchedSlots.push_back(c.slot);
+    }
+
+    // Updates and additions
+    size_t firstChange = output.size();
+    for (int i = 0; i < objects.size(); i++)
+    {
+        Object &object = objects[i];
+        int k = match[i];
+        Object::ObjectAction action = Object::UPDATE;
+        if (object.id >= 0)
+        {
+            auto it = tracked.find(trackKey(object));
+            k = (it == tracked.end() ? -1 : it->second);
+        }
+
+        if (k >= 0)
+        {
+            if (object.id < 0)
+                index.move(k, object.type, slots[k].location.x, slots[k].location.y,
+                           object.location.x, object.location.y);
+        }
+        else
+        {
+            k = allocate();
+            used[k] = 1;
+            count++;
+            if (object.id >= 0)
+                tracked[trackKey(object)] = k;
+            else
+                index.insert(k, object.type, object.location.x, object.location.y);
+            action = Object::ADD;
+        }
+
+        slots[k] = object;
+        slots[k].action = action;
+        slots[k].lastIdx = k;
+        lastSeen[k] = time;
+
+        // An object updated twice in one image is output once, with its last state
+        auto out = std::find_if(output.begin() + firstChange, output.end(),
+                                [k](const Object &o) { return o.lastIdx == k; });
+        if (out == output.end())
+            output.push_back(slots[k]);
+        else
+        {
+            action = out->action;
+            *out = slots[k];
+            out->action = action;
+        }
+    }
+
+    // Capacity; the objects seen in this image are kept
+    while (count > capacity)
+    {
+        int oldest = -1;
+        for (int k = 0; k < slots.size(); k++)
+            if (used[k] && lastSeen[k] < time && (oldest < 0 || lastSeen[k] < lastSeen[oldest]))
+                oldest = k;
+        if (oldest < 0)
+            break;
+        evict(oldest, output);
+    }
+    std::stable_partition(output.begin(), output.end(),
+                          [](const Object &o) { return o.action == Object::REMOVE; });
+
+    objects.swap(output);
+}
+
+/** \brief Provides the number of map objects
+*/
+size_t ObjectStore::size() const
+{
+    return count;
+}
+
+/** \brief Drops all the map objects, without outputting their REMOVE actions
+*/
+void ObjectStore::clear()
+{
+    slots.clear();
+    lastSeen.clear();
+    used.clear();
+    freeSlots.clear();
+    tracked.clear();
+    index.clear();
+    count = 0;
+}
@@ -0,0 +1,161 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#include <string.h>
+#include <algorithm>
+#include "outlineDelta.h"
+
+/** \brief Constructor; sets the keyframe period
+*
+* \param [in]   keyframeInterval_   The number of versions after which a keyframe is sent anyway
+*/
+OutlineDelta::OutlineDelta(int keyframeInterval_)
+{
+    keyframeInterval = std::max(keyframeInterval_, 1);
+}
+
+/** \brief Groups the swept area outline vertices into rings
+*
+* \param [in]   objects     The objects; the vertices of type Object::SWEPT are taken, ring by ring (see
+*                           Sweeper::outline()), the others are skipped
+* \param [out]  rings       The rings
+*/
+void OutlineDelta::toRings(const std::vector<Object> &objects, std::vector<Ring> &rings)
+{
+    rings.clear();
+    for (const Object &obj : objects)
+    {
+        if (obj.type != Object::SWEPT)
+            continue;
+        if (rings.empty() || rings.back().region != obj.id || rings.back().ring != obj.lastIdx)
+        {
+            rings.emplace_back();
+            rings.back().region = obj.id;
+            rings.back().ring = obj.lastIdx;
+        }
+        rings.back().lat.push_back(obj.location.lat);
+        rings.back().lng.push_back(obj.location.lng);
+    }
+}
+
+template <typename T>
+inline void OutlineDelta::put(std::vector<uint8_t> &buffer, T value)
+{
+    size_t n = buffer.size();
+    buffer.resize(n + sizeof(T));
+    memcpy(buffer.data() + n, &value, sizeof(T));
+}
+
+inline void OutlineDelta::putVertex(std::vector<uint8_t> &buffer, double lat, double lng) const
+{
+    put(buffer, (float) (lat - originLat));
+    put(buffer, (float) (lng - originLng));
+}
+
+/** \brief Encodes a new state as the changes from the state acknowledged by the UI
+*
+* \param [in]   objects     The FOV corners (Object::FOV) and the swept area outline (Object::SWEPT), in
+*                           geodetic coordinates, as given by Scanner::calcFov()
+* \param [in]   acked       The last version applied by the UI, 0 if none
+* \param [out]  buffer      The encoded state; see the class description
+*
+* \returns      The version of the encoded state
+*/
+uint32_t OutlineDelta::encode(const std::vector<Object> &objects, uint32_t acked, std::vector<uint8_t> &buffer)
+{
+    // The last sent state becomes the base once it is acknowledged; any other version means a lost state
+    if (acked != 0 && acked == sentVersion)
+    {
+        base.swap(sent);
+        baseVersion = sentVersion;
+    }
+    bool keyframe = (acked == 0 || acked != baseVersion || ++sinceKeyframe >= keyframeInterval);
+    if (keyframe)
+    {
+        base.clear();
+        baseVersion = 0;
+        sinceKeyframe = 0;
+    }
+
+    toRings(objects, current);
+
+    originLat = originLng = 0;
+    for (const Object &obj : objects)
+        if (obj.type == Object::FOV || obj.type == Object::SWEPT)
+        {
+            originLat = obj.location.lat;
+            originLng = obj.location.lng;
+            break;
+        }
+
+    buffer.clear();
+    put(buffer, ++lastVersion);
+    put(buffer, baseVersion);
+    put(buffer, originLat);
+    put(buffer, originLng);
+
+    size_t countAt = buffer.size();
+    put(buffer, (uint32_t) 0);
+    uint32_t fovCount = 0;
+    for (const Object &obj : objects)
+        if (obj.type == Object::FOV)
+        {
+            putVertex(buffer, obj.location.lat, obj.location.lng);
+            fovCount++;
+        }
+    memcpy(buffer.data() + countAt, &fovCount, sizeof(fovCount));
+
+    put(buffer, (uint32_t) current.size());
+    countAt = buffer.size();
+    put(buffer, (uint32_t) 0);
+    uint32_t changed = 0;
+    for (size_t k = 0; k < current.size(); k++)
+    {
+        const Ring &now = current[k];
+        static const Ring none;
+        const Ring &old = (k < base.size() ? base[k] : none);
+
+        size_t nNew = now.lat.size(), nOld = old.lat.size(), n = std::min(nNew, nOld);
+        bool relabeled = (now.region != old.region || now.ring != old.ring);
+        size_t prefix = 0, suffix = 0;
+        while (prefix < n && now.lat[prefix] == old.lat[prefix] && now.lng[prefix] == old.lng[prefix])
+            prefix++;
+        while (suffix < n - prefix && now.lat[nNew - 1 - suffix] == old.lat[nOld - 1 - suffix] &&
+               now.lng[nNew - 1 - suffix] == old.lng[nOld - 1 - suffix])
+            suffix++;
+        if (!relabeled && prefix == nNew && nNew == nOld)
+            continue;
+
+        put(buffer, (uint32_t) k);
+        put(buffer, (int32_t) now.region);
+        put(buffer, (int32_t) now.ring);
+        put(buffer, (uint32_t) prefix);
+        put(buffer, (uint32_t) (nOld - prefix - suffix));
+        put(buffer, (uint32_t) (nNew - prefix - suffix));
+        for (size_t i = prefix; i < nNew - suffix; i++)
+            putVertex(buffer, now.lat[i], now.lng[i]);
+        changed++;
+    }
+    memcpy(buffer.data() + countAt, &changed, sizeof(changed));
+
+    sent.swap(current);
+    sentVersion = lastVersion;
+    return lastVersion;
+}
+
+/** \brief Provides the version of the last encoded state
+*/
+uint32_t OutlineDelta::version() const
+{
+    return lastVersion;
+}
+
+/** \brief Forces a keyframe with the next call of encode()
+*/
+void OutlineDelta::reset()
+{
+    base.clear();
+    sent.clear();
+    baseVersion = sentVersion = 0;
+}
@@ -0,0 +1,128 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#include <string.h>
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+#include "resultPacker.h"
+
+/** \brief Constructor; sets the atlas geometry
+*
+* \param [in]   thumbSize_      The maximum side of a picture in the atlas, in pixels
+* \param [in]   atlasWidth_     The atlas width in pixels
+*/
+ResultPacker::ResultPacker(int thumbSize_, int atlasWidth_)
+{
+    thumbSize = std::max(thumbSize_, 8);
+    atlasWidth = std::max(atlasWidth_, thumbSize);
+}
+
+/** \brief Packs the object pictures into the atlas, row by row
+*
+* \param [in]   objects     The objects; the ones without picture, or beyond the maximum atlas height, get an
+*                           empty rectangle
+*/
+void ResultPacker::buildAtlas(const std::vector<Object> &objects)
+{
+    rects.assign(objects.size(), cv::Rect());
+
+    int x = 0, y = 0, rowHeight = 0;
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        const cv::Mat &picture = objects[i].picture;
+        if (picture.empty())
+            continue;
+
+        double scale = std::min(1.0, (double) thumbSize / std::max(picture.cols, picture.rows));
+        int w = std::max((int) (picture.cols * scale), 1), h = std::max((int) (picture.rows * scale), 1);
+        if (x + w > atlasWidth)
+        {
+            x = 0;
+            y += rowHeight;
+            rowHeight = 0;
+        }
+        if (y + h > maxAtlasHeight)
+            break;
+        rects[i] = cv::Rect(x, y, w, h);
+        x += w;
+        rowHeight = std::max(rowHeight, h);
+    }
+
+    int height = y + rowHeight;
+    if (height == 0)
+    {
+        atlasImage.release();
+        return;
+    }
+    atlasImage.create(height, atlasWidth, CV_8UC4);
+    atlasImage.setTo(cv::Scalar::all(0));
+
+    cv::Mat scaled;
+    for (size_t i = 0; i < objects.size(); i++)
+    {
+        if (rects[i].width == 0)
+            continue;
+        const cv::Mat &picture = objects[i].picture;
+        cv::resize(picture, scaled, rects[i].size(), 0, 0, cv::INTER_AREA);
+        cv::Mat roi = atlasImage(rects[i]);
+        if (scaled.channels() == 1)
+            cv::cvtColor(scaled, roi, cv::COLOR_GRAY2RGBA);
+        else if (scaled.channels() == 3)
+            cv::cvtColor(scaled, roi, cv::COLOR_BGR2RGBA);
+        else
+            cv::cvtColor(scaled, roi, cv::COLOR_BGRA2RGBA);
+    }
+}
+
+/** \brief Packs the objects into a buffer
+*
+* \param [in]   objects     The objects
+* \param [out]  buffer      The buffer; see the class description for the layout
+* \param [in]   capacity    The buffer size in bytes
+* \param [in]   withAtlas   If true, the object pictures are packed into the atlas and their rectangles are set
+*
+* \returns      The number of records written, fewer than the objects if the buffer is too small
+*/
+size_t ResultPacker::pack(const std::vector<Object> &objects, uint8_t *buffer, size_t capacity, bool withAtlas)
+{
+    if (capacity < HEADER_SIZE)
+        return 0;
+
+    if (withAtlas)
+        buildAtlas(objects);
+    else
+    {
+        rects.assign(objects.size(), cv::Rect());
+        atlasImage.release();
+    }
+
+    size_t count = std::min(objects.size(), (capacity - HEADER_SIZE) / RECORD_SIZE);
+    uint32_t header[4] = {(uint32_t) count, (uint32_t) RECORD_SIZE, (uint32_t) atlasImage.cols, (uint32_t) atlasImage.rows};
+    memcpy(buffer, header, sizeof(header));
+
+    uint8_t *record = buffer + HEADER_SIZE;
+    for (size_t i = 0; i < count; i++, record += RECORD_SIZE)
+    {
+        const Object &obj = objects[i];
+        double location[3] = {obj.location.lat, obj.location.lng, obj.location.alt};
+        float measures[2] = {(float) obj.distance, (float) obj.direction};
+        int32_t fields[4] = {(int32_t) obj.type, (int32_t) obj.action, (int32_t) obj.lastIdx, (int32_t) obj.id};
+        int16_t rect[4] = {(int16_t) rects[i].x, (int16_t) rects[i].y, (int16_t) rects[i].width, (int16_t) rects[i].height};
+        float speed[2] = {(float) obj.xSpeed, (float) obj.ySpeed};
+
+        memcpy(record, location, sizeof(location));
+        memcpy(record + 24, measures, sizeof(measures));
+        memcpy(record + 32, fields, sizeof(fields));
+        memcpy(record + 48, rect, sizeof(rect));
+        memcpy(record + 56, speed, sizeof(speed));
+    }
+    return count;
+}
+
+/** \brief Provides the RGBA pictures atlas built by the last pack() call; empty if there is no picture
+*/
+const cv::Mat &ResultPacker::atlas() const
+{
+    return atlasImage;
+}
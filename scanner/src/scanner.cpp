@@ -2,6 +2,7 @@
 // Created by a on 6/7/2021.
 //
 
+#include <thread>
 #include "scanner.h"
 #include "sweeper.h"
 
@@ -46,12 +47,17 @@ Scanner::Scanner(std::string assetsDir, std::string logsDir, DetectionMethod dm,
         logger = new Logger(logsDir, false, false, logFolder);
 
     sweeper = new SweeperGeometry::Sweeper();
-    motionDetector = new MotionDetector(hva_);
+    sweepWorker = new SweeperGeometry::SweepWorker(sweeper);
+    camera.setViewAngle(hva_);
+    projector.setCamera(&camera);
+    motionDetector = new MotionDetector(&camera);
+    // One band per half of the cores, so the detector network keeps its own while both modes run
+    motionDetector->setFlowBands(std::max(1, (int) std::thread::hardware_concurrency() / 2));
+    velocityEstimator = new VelocityEstimator();
 
     assets_dir = assetsDir;
-//    FloodUtils::setdir(assetsDir.c_str());
-//    Grid<NasaGridSquare>::cache_limit = 20;
-//    grid = new Grid<NasaGridSquare>();
+    elevation = new ElevationService(assetsDir, 20);
+    terrain = new TerrainRaycaster(8.0);
 
 }
 
@@ -59,19 +65,13 @@ Scanner::Scanner(std::string assetsDir, std::string logsDir, DetectionMethod dm,
 *
 * \param [out]  imgSt   An ImageSet instance containing first camera image synchronized with IMU and GPS data
 *
-* This function sets the focal length (f) and x-axis and y-axis optical center of camera (cx and cy respectively)
-* simply assuming that the camera focal point is exactly placed in front of image center. Usually this assumption
-* is not true. However the little error is negligible
+* This function configures the camera model shared by all the modules with the image resolution and the
+* horizontal view angle, so its pixel ray table is built once
 */
 void Scanner::setInitialInfo(ImageSet &imgSt)
 {
-    int width = imgSt.image.size().width;
-    int height = imgSt.image.size().height;
-
-    // TODO: Set the true cx, cy and f based on camera params instead of this simplification
-    f = (float) (0.5 * width * (1.0 / tan((hva/2.0)*PI/180)));
-    cx = (float) width/2;
-    cy = (float) height/2;
+    camera.setViewAngle(hva);
+    camera.configure(imgSt.frame.cols(), imgSt.frame.rows());
 
     setReferenceLoc(imgSt.lat, imgSt.lng, false);
 }
@@ -108,8 +108,9 @@ bool Scanner::scan(ImageSet &imgSt, Mat &detections_img, Mat &movings_img, std::
         setInitialInfo(imgSt);
         initialInfoSet = true;
     }
+    updateGeoGrid(imgSt);
 
-    motionDetector->detect(imgSt, movings_img, moving_objects, fovPoses, true);
+    motionDetector->detect(imgSt, movings_img, moving_objects, fovPoses, geoGrid, true);
 
 //    detector->detect(imgSt.image, objects);
 //    detector->drawDetections(detections_img, objects);
@@ -124,24 +125,30 @@ bool Scanner::scan(ImageSet &imgSt, Mat &detections_img, Mat &movings_img, std::
 //        __android_log_print(ANDROID_LOG_VERBOSE, "android_scanner----", "object height: %s", std::to_string(obj.picture.rows).c_str());
 //    }
 
-    associate(objects);
+    objectStore.update(objects, imgSt.time);
+    toGeodetic(objects);
     return true;
 }
 
 /** \brief The main function which detects motion and objects, and maps them into the online map
 *
-* \param [out]  objects     std::vector<Objects>; A list containing last location, last picture,
-*                           and some other data for each detected object
-* \param [out]  detections  cv::Mat; An image with detected objects highlighted within
+* \param [out]  objects     std::vector<Objects>; The changes of the online map since the previous call: the
+*                           objects added, updated or removed, with last location, last picture, and some
+*                           other data. Object::lastIdx is the stable id of each map object
+* \param [out]  detections  cv::Mat; A BGR image with detected objects highlighted within. In the motion
+*                           detection modes, it is the camera image itself, which must not be modified
 * \param [out]  movings_img cv::Mat; An image with moving objects highlighted within
-* \param [in]   det_mode    Integer; If 1, the function detects moving objects. Otherwise, objects
-*                           such as persons, car, etc. are detected
+* \param [in]   det_mode    Integer; If 1, the function detects moving objects using dense optical flow.
+*                           If 2, it detects moving objects using background subtraction. Otherwise,
+*                           objects such as persons, car, etc. are detected
+* \param [in]   isFix       Boolean; If true, the camera is in a fixed position and motion detection can
+*                           run. Ignored if the automatic motion gate is on (see setAutoMotionGate())
 *
 * \returns      true if the required data is provided and so the outputs are achieved successfully
 *
 * This function is called with sensor data received and synchronized previously
 */
-bool Scanner::scan(std::vector<Object> &objects, Mat &detections, Mat &movings_img, int det_mode = 0, bool rgba = false, bool isFix = false)
+bool Scanner::scan(std::vector<Object> &objects, Mat &detections, Mat &movings_img, int det_mode = 0, bool isFix = false)
 {
     if (logger->readFromLog)
         return false;
@@ -162,44 +169,209 @@ bool Scanner::scan(std::vector<Object> &objects, Mat &detections, Mat &movings_i
         initialInfoSet = true;
     }
 
-    detections = imgSt.image.clone();
-
-    if (det_mode == 1)
+    if (det_mode == 1 || det_mode == 2)
     {
+        detections = imgSt.frame.bgr();
+        motionDetector->setMethod(det_mode == 2 ? BACKGROUND_SUBTRACTION : DENSE_FLOW);
+        velocityEstimator->reset();
 //        __android_log_print(ANDROID_LOG_VERBOSE, "scan nn1 fov size:", "%s", std::to_string(fovPoses.size()).c_str());
-        motionDetector->detect(imgSt, movings_img, objects, fovPoses, isFix);
+        bool fixed = (autoMotionGate ? logger->isStationary() : isFix);
+        // Only the motion detection samples the grid, and only while the camera is fixed
+        if (fixed)
+            updateGeoGrid(imgSt);
+        motionDetector->detect(imgSt, movings_img, objects, fovPoses, geoGrid, fixed);
 //        __android_log_print(ANDROID_LOG_VERBOSE, "scan ", "nn2");
     }
     else
         {
 //            __android_log_print(ANDROID_LOG_VERBOSE, "scan ", "nn3");
-            if (rgba) {
-            Mat img;
-            cvtColor(imgSt.image, img, COLOR_RGBA2BGR);
-            cvtColor(detections, detections, COLOR_RGBA2BGR);
-            detector->detect(img, objects);
-        }
-        else {
-//                __android_log_print(ANDROID_LOG_VERBOSE, "scan ", "nn4");
-                detector->detect(imgSt.image, objects);
-            }
+        Mat img = imgSt.frame.bgr();
+        detections = img.clone();
+        detector->detect(img, objects);
+
+        if (detectionVelocity)
+            estimateVelocities(objects, imgSt);
+        else
+            velocityEstimator->reset();
 
         detector->drawDetections(detections, objects);
 //            __android_log_print(ANDROID_LOG_VERBOSE, "scan ", "nn5");
 
-        movings_img = cv::Mat::zeros(imgSt.image.rows, imgSt.image.cols, CV_8UC3);
+        movings_img = cv::Mat::zeros(imgSt.frame.rows(), imgSt.frame.cols(), CV_8UC3);
 //            __android_log_print(ANDROID_LOG_VERBOSE, "scan ", "nn6");
 
         }
 
     camToMap(objects, imgSt);
 
-    associate(objects);
+    objectStore.update(objects, imgSt.time);
+    toGeodetic(objects);
 //    __android_log_print(ANDROID_LOG_VERBOSE, "scan ", "nn7");
 
     return true;
 }
 
+/** \brief Turns the automatic motion gate on or off
+*
+* \param [in]   enable  If true, motion detection runs only while the logger finds the camera stationary,
+*                       regardless of the isFix flag given to scan(). It is suspended, and its buffers
+*                       released, as soon as the camera moves
+*/
+void Scanner::setAutoMotionGate(bool enable)
+{
+    autoMotionGate = enable;
+}
+
+/** \brief Turns the velocity estimation of detected objects on or off
+*
+* \param [in]   enable  If true, the speed and direction of persons, cars, etc. are estimated in the
+*                       object detection mode, using sparse optical flow inside their bounding boxes
+*/
+void Scanner::setDetectionVelocity(bool enable)
+{
+    // The estimator itself is only touched by scan(), which resets it once disabled
+    detectionVelocity = enable;
+}
+
+/** \brief Sets the radial lens distortion of the camera
+*
+* \param [in]   k1      The second order radial distortion coefficient
+* \param [in]   k2      The fourth order radial distortion coefficient
+*
+* The pixel rays used by all the modules are then calculated from the undistorted image points
+*/
+void Scanner::setLensDistortion(double k1, double k2)
+{
+    camera.setDistortion(k1, k2);
+}
+
+/** \brief Sets how long the map objects are kept
+*
+* \param [in]   maxAge      The time in seconds after which an object not seen again is removed from the map;
+*                           0 to keep the objects until the map is full
+* \param [in]   capacity    The maximum number of map objects; the ones seen least recently are removed first
+*/
+void Scanner::setObjectAgeing(double maxAge, int capacity)
+{
+    objectStore.setAgeing(maxAge, (size_t) std::max(capacity, 1));
+}
+
+/** \brief Sets when the FOV and the swept area are recalculated as the orientation is updated
+*
+* \param [in]   shift       The predicted footprint shift in meters beyond which the FOV is recalculated; 2 m by
+*                           default
+* \param [in]   angle       The camera rotation in degrees beyond which the FOV is recalculated; 2° by default
+* \param [in]   minInterval The minimum time in seconds between two calculations; 1 s by default, as each FOV
+*                           output in full (see calcFov()) is marshalled again. A caller of the delta output
+*                           (see OutlineDelta) may lower it, e.g. to 0.1 s
+* \param [in]   keepalive   The time in seconds after which the FOV is recalculated anyway, e.g. while hovering;
+*                           10 s by default, 0 to never recalculate an unchanged FOV
+*/
+void Scanner::setFovPolicy(double shift, double angle, double minInterval, double keepalive)
+{
+    fovShift = shift;
+    fovAngle = angle * PI / 180;
+    fovDelay = minInterval;
+    fovKeepalive = keepalive;
+}
+
+/** \brief Sets the mission area for the coverage statistics
+*
+* \param [in]   boundary    The boundary vertices of the mission area, by their GPS latitude and longitude; the
+*                           local frame is anchored at the first vertex if it is not anchored yet
+*/
+void Scanner::setMissionBoundary(const std::vector<Location> &boundary)
+{
+    std::vector<double> missionX(boundary.size()), missionY(boundary.size());
+    for (size_t k = 0; k < boundary.size(); k++)
+    {
+        frame.setOrigin(boundary[k].lat, boundary[k].lng);
+        frame.toLocal(boundary[k].lat, boundary[k].lng, missionX[k], missionY[k]);
+    }
+    sweepWorker->setMission(missionX, missionY);
+}
+
+/** \brief Provides the coverage statistics of the area swept so far
+*
+* \param [out]  stats   The swept area, the mission coverage and the revisit histogram, as of the latest
+*                       sweeped area published by the sweep worker
+*/
+void Scanner::getCoverageStats(SweeperGeometry::CoverageStats &stats) const
+{
+    stats = sweepWorker->snapshot()->stats;
+}
+
+/** \brief Provides the outline of the mission area not swept yet
+*
+* \param [out]  gaps    The outline vertices of the unswept regions, of type Object::GAP; see Sweeper::gaps()
+*/
+void Scanner::getCoverageGaps(std::vector<Object> &gaps)
+{
+    sweepWorker->gaps(gaps);
+    toGeodetic(gaps);
+}
+
+/** \brief Finds the unswept point of the mission nearest to a location, e.g. the drone's current location
+*
+* \param [in]   from    The location, by its GPS latitude and longitude
+* \param [out]  gap     The nearest unswept point, by its GPS latitude and longitude
+*
+* \returns      false if the mission is fully swept or not set
+*/
+bool Scanner::nearestGap(const Location &from, Location &gap) const
+{
+    if (!frame.isSet())
+        return false;
+
+    double x, y;
+    frame.toLocal(from.lat, from.lng, x, y);
+    if (!sweepWorker->nearestGap(x, y, gap))
+        return false;
+    frame.toGeodetic(&gap.x, &gap.y, &gap.lat, &gap.lng, 1);
+    return true;
+}
+
+/** \brief Provides the revisit data of the swept cell of a location
+*
+* \param [in]   at          The location, by its GPS latitude and longitude
+* \param [in]   now         The current time in seconds, in the clock of the fields of view
+* \param [out]  visits      The number of visits of the cell; 0 if it is never seen
+* \param [out]  sinceSeen   The time in seconds since the cell was last seen; -1 if it is never seen
+*
+* \returns      false if the local frame is not set yet, i.e. nothing is swept
+*/
+bool Scanner::getCellRevisit(const Location &at, double now, int &visits, double &sinceSeen) const
+{
+    if (!frame.isSet())
+        return false;
+
+    double x, y;
+    frame.toLocal(at.lat, at.lng, x, y);
+    visits = sweepWorker->visits(x, y);
+    sinceSeen = sweepWorker->timeSinceSeen(x, y, now);
+    return true;
+}
+
+/** \brief Turns the terrain intersection mode on or off
+*
+* \param [in]   enable  If true, the map location of each image point is where its ray hits the terrain given
+*                       by the DEM tiles. Otherwise, it is where the ray hits a flat ground plane. The flat
+*                       plane is used anyway where the DEM is not available
+*/
+void Scanner::setTerrainIntersection(bool enable)
+{
+    terrainIntersection = enable;
+}
+
+/** \brief Tells whether the camera is currently in a fixed position
+*
+* \returns      true if the recent IMU and GPS data show a stationary camera
+*/
+bool Scanner::isStationary()
+{
+    return logger->isStationary();
+}
+
 /** \brief Calculates the corresponding map location for a couple of bounding boxes (within image) given at input
 *
 * \param [in,out]   objects     A list containing which contains the related bounding box in image for each
@@ -225,6 +397,61 @@ void Scanner::camToMap(std::vector<Object> &objects, const ImageSet& is)
     calcDistances(objects);
 }
 
+/** \brief Estimates the metric velocity of the detected objects
+*
+* \param [in,out]   objects     The objects detected in the image. Their xSpeed (east), ySpeed (north) and
+*                               direction (relative to the drone heading, like the moving objects) are set
+* \param [in]       imgSt       An ImageSet instance containing the image in which objects are detected along
+*                               with corresponding IMU and GPS data
+*
+* The displacement of each object within the image is estimated by velocityEstimator. Then the object's
+* current image point is mapped with the current camera pose, and its previous image point with the
+* previous camera pose, so the camera motion between the two images does not appear in the velocity
+*/
+void Scanner::estimateVelocities(std::vector<Object> &objects, const ImageSet &imgSt)
+{
+    const Mat &gray = imgSt.frame.gray();
+
+    std::vector<Point2f> shifts;
+    std::vector<bool> valid;
+    bool hasPrevious = velocityEstimator->estimate(gray, objects, shifts, valid);
+
+    ImageSet prevSt = lastVelocitySet;
+    lastVelocitySet = imgSt;
+    double dt = imgSt.time - prevSt.time;
+    if (!hasPrevious || dt <= 0)
+        return;
+
+    std::vector<Object> current, previous;
+    std::vector<int> idxs;
+    for (int k = 0; k < objects.size(); k++)
+    {
+        if (!valid[k]) continue;
+        Object obj;
+        obj.center = Point2f(objects[k].box.x + float(objects[k].box.width)/2, objects[k].box.y + float(objects[k].box.height)/2);
+        current.push_back(obj);
+        obj.center -= shifts[k];
+        previous.push_back(obj);
+        idxs.push_back(k);
+    }
+
+    if (idxs.empty())
+        return;
+
+    imageToMap(imgSt.roll, imgSt.pitch, imgSt.azimuth, imgSt.lat, imgSt.lng, imgSt.alt, current);
+    imageToMap(prevSt.roll, prevSt.pitch, prevSt.azimuth, prevSt.lat, prevSt.lng, prevSt.alt, previous);
+
+    for (int i = 0; i < idxs.size(); i++)
+    {
+        if (!current[i].show || !previous[i].show) continue;
+
+        Object &obj = objects[idxs[i]];
+        obj.xSpeed = (current[i].location.x - previous[i].location.x) / dt;
+        obj.ySpeed = (current[i].location.y - previous[i].location.y) / dt;
+        obj.direction = (atan2(obj.xSpeed, obj.ySpeed) - imgSt.azimuth)*180/PI;
+    }
+}
+
 /** \brief Calculates the distance from each of input objects to a reference point
 *
 * \param [in,out]   objects     A list containing which contains the related bounding box in image for each
@@ -237,10 +464,11 @@ void Scanner::camToMap(std::vector<Object> &objects, const ImageSet& is)
 */
 void Scanner::calcDistances(std::vector<Object> &objects)
 {
-    double refX, refY;
+    double refX = firstLocation.x, refY = firstLocation.y;
 
-    refX = (userLocation.zone != 0 ? userLocation.x : firstLocation.x);
-    refY = (userLocation.zone != 0 ? userLocation.y : firstLocation.y);
+    // The user location may be received before the local frame is anchored
+    if (userLocationSet && frame.isSet())
+        frame.toLocal(userLocation.lat, userLocation.lng, refX, refY);
 
     for (auto &object : objects) {
         object.distance = sqrt(
@@ -268,109 +496,6 @@ void Scanner::eulerToRotationMat(double roll, double pitch, double azimuth, Eige
     output = dcm_body_to_inertia;
 }
 
-/** \brief Converts a given GPS location to a UTM location
-*
-* \param [in]  lat  GPS latitude
-* \param [in]  lng  GPS longitude
-* \param [out] x    UTM x coordinate
-* \param [out] y    UTM y coordinate
-*/
-void Scanner::gpsToUtm(double lat, double lng, double &x, double &y)
-{
-    zone = LatLonToUTMXY(lat, lng, 0, x, y);
-    isSouth = (lat < 0);
-}
-
-/** \brief Scales a unit direction vector in such a way that it ends on the ground or on a maximum length
-*
-* \param [in]  v        The input direction vector that is to be scaled
-* \param [in]  output   The output scaled vector
-* \param [out] z        The altitude of the camera
-*
-*/
-bool Scanner::scaleVector(Eigen::VectorXd v, Eigen::VectorXd &output, double z)
-{
-    if (v[2] > 0)
-    {
-        double factor = fabs(z) / fabs(v[2]);
-        if ((factor*v).norm() < max_dist)
-        {
-            output = factor*v;
-            return true;
-        }
-    }
-    output = max_dist * v;
-    return false;
-}
-
-/** \brief Calculates a 3D direction vector that starts at the camera focal point and ends at a given image point
-*
-* \param [in]  x    The horizontal coordinate of the image point
-* \param [in]  y    The vertical coordinate of the image point
-* \param [out] z    The output 3D direction vector
-*
-* This function is called when the camera focal length (f) and x-axis and y-axis optical center (cx and cy
-* respectively) are predetermined. The function scales the direction vector to touch the ground if its
-* length is less than a maximum length (the parameter max_dist). Otherwise, it scales the direction vector
-* into the maximum length
-*/
-void Scanner::calcDirVec(float x, float y, Eigen::VectorXd &z)
-{
-    Eigen::VectorXd w(3);
-
-    w<<(double) (x-cx),
-       (double) (y-cy),
-       (double) f;
-
-    z = w*(1/w.norm());
-}
-
-/** \brief Modifies and updates the Object list of the UI online map
-*
-* \param [in,out]   objects     The list of last detected objects
-*
-* This function is called when the object detection and mapping procedure is completed. The function decides
-* for each object whether it should be added, remained or updated in the UI online map
-*/
-void Scanner::associate(std::vector<Object> &objects)
-{
-    for (int k = 0; k < objectPoses.size(); k++)
-    {
-        if(objectPoses[k].action == Object::UPDATE || objectPoses[k].action == Object::ADD)
-            objectPoses[k].action = Object::REMAIN;
-    }
-
-    std::vector<Object> newObjs;
-
-    for(auto & object : objects)
-    {
-        bool found = false;
-        for (int k = 0; k < objectPoses.size(); k++)
-        {
-            if(objectPoses[k].type != object.type) continue;
-
-            double dist = sqrt(((objectPoses[k].location.x-object.location.x)*(objectPoses[k].location.x-object.location.x))+
-                    ((objectPoses[k].location.y-object.location.y)*(objectPoses[k].location.y-object.location.y)));
-            if (dist < 3)
-            {
-                objectPoses[k] = object;
-                objectPoses[k].action = Object::UPDATE;
-                objectPoses[k].lastIdx = k;
-                found = true;
-            }
-        }
-        if (!found)
-        {
-            newObjs.push_back(object);
-            newObjs.at(newObjs.size()-1).action = Object::ADD;
-        }
-    }
-
-    objectPoses.insert(objectPoses.end(), newObjs.begin(), newObjs.end());
-    objects = objectPoses;
-}
-
-
 /** \brief It maps the calculated camera FOV into the online map and updates the swept area
 *
 * \param [out]  objects     std::vector<Objects>; A list containing the location for points representing
@@ -378,24 +503,47 @@ void Scanner::associate(std::vector<Object> &objects)
 *
 * \returns      true if the required data is provided and so the outputs are achieved successfully
 *
-* This function is called with camera info prepared previously
+* This function is called with camera info prepared previously. The FOV is recalculated only if its footprint
+* is predicted to change (see fovChanged() and setFovPolicy()); otherwise the last FOV is output again only if
+* the sweep worker published a newer swept area since, and nothing at all is output while the drone hovers.
+* The FOV is queued to the sweep worker and the swept area outline is the latest one it published, so the call
+* never waits for the swept area update
 */
 // TODO: fov calculation is not necessary when on the ground or in horizontal fov case
 bool Scanner::calcFov(std::vector<Object> &objects)
 {
-    if(logger->readFromLog)
+    // The camera rays are only known once the first image is scanned
+    if(logger->readFromLog || !camera.isConfigured())
         return false;
 
     ImuSet imuSt;
     if (!logger->getImuSet(imuSt) || abs(imuSt.time-lastFovTime)<fovDelay) {
         return false;
     }
+
+    if (!fovChanged(imuSt))
+    {
+        // The same FOV, but the sweep worker may have published a newer swept area since the last output
+        std::shared_ptr<const SweeperGeometry::SweepSnapshot> swept = sweepWorker->snapshot();
+        if (swept->version == sweptVersion || fovPoses.empty())
+            return false;
+        sweptVersion = swept->version;
+        objects = fovPoses;
+        objects.insert(objects.end(), swept->outline.begin(), swept->outline.end());
+        toGeodetic(objects);
+        return true;
+    }
     lastFovTime = imuSt.time;
+    lastFovSet = imuSt;
+
+    double speed, course;
+    if (logger->getGroundVelocity(speed, course))
+        elevation->prefetch(imuSt.lat, imuSt.lng, course, speed, prefetchHorizon);
 
     std::vector<bool> sps;
     int w, h;
-    w = logger->img.image.size().width;
-    h = logger->img.image.size().height;
+    w = logger->img.frame.cols();
+    h = logger->img.frame.rows();
 
     std::vector<Point2f> points{{0, 0}, {(float)w, 0}, {(float)w, (float)h}, { 0, (float)h }};
     for (auto & point : points)
@@ -412,22 +560,56 @@ bool Scanner::calcFov(std::vector<Object> &objects)
     fovPoses.clear();
     fovPoses = objects;
 
-    std::vector<Object> swept_area;
+    frame.toLocal(imuSt.lat, imuSt.lng, lastFovX, lastFovY);
+    fovRange = 0;
+    for (auto & obj : objects)
+        fovRange = std::max(fovRange, hypot(obj.location.x - lastFovX, obj.location.y - lastFovY));
 
-    sweeper->update(objects, swept_area);
+    sweepWorker->submit(objects, imuSt.time);
 
-    objects.insert(objects.end(), swept_area.begin(), swept_area.end());
+    std::shared_ptr<const SweeperGeometry::SweepSnapshot> swept = sweepWorker->snapshot();
+    sweptVersion = swept->version;
+    objects.insert(objects.end(), swept->outline.begin(), swept->outline.end());
+    toGeodetic(objects);
 
     return true;
 }
 
+/** \brief Tells whether the FOV footprint is predicted to change enough since the last calculated one
+*
+* \param [in]   imuSt   The current orientation and location
+*
+* \returns      true if the footprint is predicted to move by more than fovShift meters, or to rotate by more
+*               than fovAngle, or if the last FOV is calculated more than fovKeepalive seconds ago
+*
+* The footprint shift is predicted from the camera motion alone: its horizontal and vertical displacement,
+* plus the farthest FOV corner distance times the largest change of the Euler angles. So no point is projected
+* while the drone hovers
+*/
+bool Scanner::fovChanged(const ImuSet &imuSt)
+{
+    if (lastFovTime < 0 || fovPoses.empty() || !frame.isSet())
+        return true;
+    if (fovKeepalive > 0 && imuSt.time - lastFovTime >= fovKeepalive)
+        return true;
+
+    double x, y;
+    frame.toLocal(imuSt.lat, imuSt.lng, x, y);
+    double dAngle = std::max({fabs(remainder(imuSt.roll - lastFovSet.roll, 2 * PI)),
+                              fabs(remainder(imuSt.pitch - lastFovSet.pitch, 2 * PI)),
+                              fabs(remainder(imuSt.azimuth - lastFovSet.azimuth, 2 * PI))});
+    double shift = hypot(x - lastFovX, y - lastFovY) + fabs(imuSt.alt - lastFovSet.alt) + fovRange * dAngle;
+
+    return shift > fovShift || dAngle > fovAngle;
+}
+
 bool Scanner::calcFov(std::vector<Object> &objects, ImageSet &imgSt)
 {
-    if (!logger->readFromLog)
+    if (!logger->readFromLog || !camera.isConfigured())
         return false;
 
-    int w = imgSt.image.size().width;
-    int h = imgSt.image.size().height;
+    int w = imgSt.frame.cols();
+    int h = imgSt.frame.rows();
     std::vector<bool> sps;
     std::vector<Point2f> points{{0, 0}, {(float)w, 0}, {(float)w, (float)h}, { 0, (float)h }};
     for (auto & point : points)
@@ -444,53 +626,63 @@ bool Scanner::calcFov(std::vector<Object> &objects, ImageSet &imgSt)
     fovPoses.clear();
     fovPoses = objects;
 
-    std::vector<Object> swept_area;
-    sweeper->update(objects, swept_area);
-    objects.insert(objects.end(), swept_area.begin(), swept_area.end());
+    // The log is replayed frame by frame, so the sweeped area of each frame is waited for
+    sweepWorker->submit(objects, imgSt.time);
+    sweepWorker->flush();
+
+    std::shared_ptr<const SweeperGeometry::SweepSnapshot> swept = sweepWorker->snapshot();
+    objects.insert(objects.end(), swept->outline.begin(), swept->outline.end());
+    toGeodetic(objects);
 
     return true;
 }
 
+/** \brief Provides the terrain elevation at the location of an ImuSet instance
+*
+* \param [in]   imuSt   The ImuSet instance containing the location
+*
+* \returns      The terrain elevation in meters, or -32768 if it is not available
+*/
 double Scanner::elev(ImuSet &imuSt)
 {
-    FloodUtils::setdir(assets_dir.c_str());
-    Grid<NasaGridSquare>::cache_limit = 20;
-    grid = new Grid<NasaGridSquare>();
-
-    return (double) grid->height((float)imuSt.lng,(float)imuSt.lat);
+    return elevation->height(imuSt.lat, imuSt.lng);
 }
 
+/** \brief Provides the terrain elevation at the drone's last location
+*
+* \returns      The terrain elevation in meters, 0 if no location is received yet, or -32768 if it is
+*               not available
+*/
 double Scanner::elev()
 {
-    FloodUtils::setdir(assets_dir.c_str());
-    Grid<NasaGridSquare>::cache_limit = 20;
-    grid = new Grid<NasaGridSquare>();
-
     ImuSet imuSt;
     if (!logger->getImuSet(imuSt)) {
         return 0.0;
     }
 
-    return (double) grid->height((float)imuSt.lng,(float)imuSt.lat);
+    return elevation->height(imuSt.lat, imuSt.lng);
 }
 
+/** \brief Calculates the terrain elevation difference between a location and the drone's initial location
+*
+* \param [in]   newLat  The location latitude
+* \param [in]   newLon  The location longitude
+* \param [out]  diff    The elevation difference in meters; 0 if it is not available or not used
+*
+* \returns      false if the elevation of either location is not available
+*/
 bool Scanner::elevDiff(double newLat, double newLon, double &diff)
 {
-    FloodUtils::setdir(assets_dir.c_str());
-    Grid<NasaGridSquare>::cache_limit = 20;
-    grid = new Grid<NasaGridSquare>();
-
     if (!useElev or !initialInfoSet){
         diff = 0;
         return true;
     }
 
-    double newElev = (double) grid->height((float)newLon,(float)newLat);
-    double initElev = (double) grid->height((float)firstLocation.lng,(float)firstLocation.lat);
+    double lats[2] = {newLat, firstLocation.lat}, lngs[2] = {newLon, firstLocation.lng}, elevs[2];
+    elevation->heights(lats, lngs, elevs, 2);
+    double newElev = elevs[0], initElev = elevs[1];
 
-//    __android_log_print(ANDROID_LOG_VERBOSE, "imageToMap", " %f %f %f %f %f %f", (float)newLon,(float)newLat, (float)firstLocation.lng,(float)firstLocation.lat, (float)newElev, (float)initElev );
-
-    if (newElev == -32768 || initElev == -32768) {
+    if (newElev == ElevationService::NO_DATA || initElev == ElevationService::NO_DATA) {
         diff = 0;
         return false;
     }
@@ -501,6 +693,78 @@ bool Scanner::elevDiff(double newLat, double newLon, double &diff)
     }
 }
 
+/** \brief Projects image points onto the ground
+*
+* \param [in]   roll        Camera roll angle at the moment in which image is captured
+* \param [in]   pitch       Camera pitch angle at the moment in which image is captured
+* \param [in]   azimuth     Camera azimuth angle at the moment in which image is captured
+* \param [in]   lat         Camera location latitude at the moment in which image is captured
+* \param [in]   lng         Camera location longitude at the moment in which image is captured
+* \param [in]   alt         Camera location altitude at the moment in which image is captured
+* \param [in]   xs          The horizontal coordinates of the image points
+* \param [in]   ys          The vertical coordinates of the image points
+* \param [in]   n           The number of the image points
+* \param [out]  pos         The camera position in the local frame: north, east and the negated height
+* \param [out]  projected   The ground points relative to the camera
+*
+* The function is called from both the scan and the FOV threads, so it keeps no state of its own: the
+* caller owns the output arrays. In the terrain
+* intersection mode (see setTerrainIntersection()), each ray is cast through the DEM starting from the camera
+* absolute elevation, i.e. the drone's initial location elevation plus its altitude. If the DEM is not
+* available, or its grid around the drone is still being built, the rays are intersected with a flat plane as
+* usual
+*/
+void Scanner::projectPoints(double roll, double pitch, double azimuth, double lat, double lng, double alt,
+                            const float *xs, const float *ys, size_t n, Eigen::Vector3d &pos,
+                            GroundProjector::Points &projected)
+{
+    double x, y;
+    Eigen::Matrix3d camToInertia;
+
+    frame.setOrigin(lat, lng);
+    frame.toLocal(lat, lng, x, y);
+    double diff = 0;
+    bool res = elevDiff(lat,lng,diff);
+    pos << y, x, -(alt+diff);
+
+    double initElev = ElevationService::NO_DATA, north = 0, east = 0;
+    std::shared_ptr<const TerrainRaycaster::Grid> grid;
+    if (terrainIntersection && initialInfoSet)
+        grid = terrain->update(*elevation, lat, lng, max_dist);
+    bool onTerrain = (grid != nullptr);
+    if (onTerrain)
+    {
+        elevation->heights(&firstLocation.lat, &firstLocation.lng, &initElev, 1);
+        onTerrain = (initElev != ElevationService::NO_DATA);
+    }
+    if (onTerrain)
+    {
+        grid->toLocal(lat, lng, north, east);
+        pos[2] = -alt;
+    }
+
+    eulerToRotationMat(roll, pitch, azimuth, camToInertia);
+
+    if (onTerrain)
+    {
+        projector.rays(xs, ys, n, camToInertia, projected);
+        Eigen::Vector3d origin(north, east, initElev + alt);
+        for (size_t i = 0; i < n; i++)
+        {
+            double t;
+            bool hit = grid->cast(origin, Eigen::Vector3d(projected.north[i], projected.east[i], -projected.down[i]), max_dist, t);
+            double scale = (hit ? t : (double) max_dist);
+            projected.north[i] *= scale;
+            projected.east[i] *= scale;
+            projected.down[i] *= scale;
+            projected.distance[i] = hypot(projected.north[i], projected.east[i]);
+            projected.show[i] = hit;
+        }
+    }
+    else
+        projector.project(xs, ys, n, camToInertia, pos[2], max_dist, projected);
+}
+
 /** \brief converts image points into map points
 *
 * \param [in]       roll        Camera roll angle at the moment in which image is captured
@@ -515,53 +779,88 @@ bool Scanner::elevDiff(double newLat, double newLon, double &diff)
 * Given a set of points in image coordinates along with camera orientation and location at the moment in
 * which image is captures, this function assigns a location on map to each given point. This function can
 * be called for image points referring to various objects such as camera FOV corners, swept areas, detected
-* objects centers and moving objects centers
+* objects centers and moving objects centers. The locations are set in the local frame (x east, y north);
+* their latitude and longitude are calculated later, by toGeodetic()
 */
 void Scanner::imageToMap(double roll, double pitch, double azimuth, double lat, double lng, double alt, std::vector<Object> &objects)
 {
-    double x, y;
-    Eigen::VectorXd pos(3);
-    Eigen::Matrix3d camToInertia;
-
-    gpsToUtm(lat, lng, x, y);
-    double diff = 0;
-    bool res = elevDiff(lat,lng,diff);
-    pos << y, x, -(alt+diff);
+    // Reused from call to call by each of the scan and FOV threads
+    static thread_local std::vector<float> pixelX, pixelY;
+    static thread_local GroundProjector::Points projected;
+
+    size_t n = objects.size();
+    pixelX.resize(n);
+    pixelY.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        pixelX[i] = objects[i].center.x;
+        pixelY[i] = objects[i].center.y;
+    }
 
-    eulerToRotationMat(roll, pitch, azimuth, camToInertia);
+    Eigen::Vector3d pos;
+    projectPoints(roll, pitch, azimuth, lat, lng, alt, pixelX.data(), pixelY.data(), n, pos, projected);
 
-    for (auto & object : objects)
+    for (size_t i = 0; i < n; i++)
     {
-        Eigen::VectorXd w_cam(3), w_(3), v(3), p(3), scaled_v(3);
-        calcDirVec(object.center.x, object.center.y, w_);
-        w_cam << w_[2], w_[0], w_[1];
-        v = camToInertia * w_cam;
+        objects[i].show = projected.show[i];
+        objects[i].location.x = projected.east[i] + pos[1];
+        objects[i].location.y = projected.north[i] + pos[0];
+        objects[i].location.alt = -(projected.down[i] + pos[2]);
+    }
+}
 
-        object.show = scaleVector(v, scaled_v, pos[2]);
+/** \brief Projects the georeferencing grid of an image
+*
+* \param [in]   imgSt   An ImageSet instance containing the image along with corresponding IMU and GPS data
+*
+* This function is called once per scanned image, before any module which needs the ground location of
+* image points (e.g. the motion normalization) runs. It is skipped when no such module runs on the image
+*/
+void Scanner::updateGeoGrid(const ImageSet &imgSt)
+{
+    if (!camera.isConfigured())
+        return;
 
-        object.location.x = (scaled_v[1] + pos[1]);
-        object.location.y = scaled_v[0] + pos[0];
-        object.location.alt = -(scaled_v[2] + pos[2]);
-    }
+    geoGrid.configure(imgSt.frame.cols(), imgSt.frame.rows());
+    const std::vector<float> &xs = geoGrid.nodeX(), &ys = geoGrid.nodeY();
 
-    utmToGps(objects);
+    Eigen::Vector3d pos;
+    projectPoints(imgSt.roll, imgSt.pitch, imgSt.azimuth, imgSt.lat, imgSt.lng, imgSt.alt, xs.data(), ys.data(), xs.size(), pos, gridPoints);
+    geoGrid.set(gridPoints, pos[1], pos[0], imgSt.time);
+}
+
+/** \brief Provides the georeferencing grid of the last scanned image
+*/
+const GeoGrid &Scanner::getGeoGrid() const
+{
+    return geoGrid;
 }
 
-/** \brief Converts a given UTM location to a GPS location
+/** \brief Calculates the geodetic location of a list of objects located in the local frame
 *
-* \param [out]  lat  GPS latitude
-* \param [out]  lng  GPS longitude
-* \param [in]   x    UTM x coordinate
-* \param [in]   y    UTM y coordinate
+* \param [in,out]   objs    The objects; the latitude and longitude of each are set from its x (east) and
+*                           y (north) coordinates
+*
+* This function is called only on the lists returned to the UI, so the map geometry stays in meters and the
+* conversion is done once per output, for the whole list at once. It is called from the scan, FOV and query
+* threads, so the batch is kept in local arrays
 */
-void Scanner::utmToGps(std::vector<Object> &objs)
+void Scanner::toGeodetic(std::vector<Object> &objs)
 {
-    for (auto & obj : objs)
+    size_t n = objs.size();
+    std::vector<double> batchEast(n), batchNorth(n), batchLat(n), batchLng(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        batchEast[i] = objs[i].location.x;
+        batchNorth[i] = objs[i].location.y;
+    }
+
+    frame.toGeodetic(batchEast.data(), batchNorth.data(), batchLat.data(), batchLng.data(), n);
+
+    for (size_t i = 0; i < n; i++)
     {
-        double lat=0, lon=0;
-        UTMXYToLatLon (obj.location.x, obj.location.y, zone, isSouth, lat, lon);
-        obj.location.lat = lat*180/PI;
-        obj.location.lng = lon*180/PI;
+        objs[i].location.lat = batchLat[i];
+        objs[i].location.lng = batchLng[i];
     }
 }
 
@@ -570,15 +869,20 @@ void Scanner::utmToGps(std::vector<Object> &objs)
 * \param [in]     lat       The latitude to set
 * \param [in]     lng       The longitude to set
 * \param [in]     isUserLoc If true, function sets the input latitude and longitude as user's location.
-*                           If false, it sets the input as drone's initial location
+*                           If false, it sets the input as drone's initial location, which anchors the local
+*                           frame unless a location is already mapped before the first image
 */
 void Scanner::setReferenceLoc(double lat, double lng, bool isUserLoc)
 {
-    if (isUserLoc)
-        userLocation.zone = LatLonToUTMXY(lat, lng, 0, userLocation.x, userLocation.y);
+    if (isUserLoc) {
+        userLocation.lat = lat;
+        userLocation.lng = lng;
+        userLocationSet = true;
+    }
     else {
         firstLocation.lat = lat;
-        firstLocation.zone = zone;
-        firstLocation.zone = LatLonToUTMXY(lat, lng, 0, firstLocation.x, firstLocation.y);
+        firstLocation.lng = lng;
+        frame.setOrigin(lat, lng);
+        frame.toLocal(lat, lng, firstLocation.x, firstLocation.y);
     }
 }
@@ -0,0 +1,142 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#include "stationarityDetector.h"
+
+/** \brief Constructor; sets the detection parameters
+*
+* \param [in]   window          The length of the sliding time window, in seconds
+* \param [in]   maxAngleStd     The maximum standard deviation of roll, pitch and azimuth, in radians
+* \param [in]   maxPositionStd  The maximum standard deviation of the position along each axis, in meters
+* \param [in]   timeout         The time in seconds without orientation or location after which the camera
+*                               is considered moving
+*/
+StationarityDetector::StationarityDetector(double window_, double maxAngleStd_, double maxPositionStd_, double timeout_)
+{
+    window = window_;
+    maxAngleStd = maxAngleStd_;
+    maxPositionStd = maxPositionStd_;
+    timeout = timeout_;
+}
+
+/** \brief Adds a new orientation to the sliding window
+*
+* \param [in]   roll    Roll angle in radians
+* \param [in]   pitch   Pitch angle in radians
+* \param [in]   azimuth Azimuth angle in radians
+* \param [in]   time    The exact time instant in which the orientation is received
+*
+* The azimuth is unwrapped with respect to the previous sample, so a camera looking north does not
+* show a huge deviation when the azimuth jumps between -PI and PI
+*/
+void StationarityDetector::addOrientation(double roll, double pitch, double azimuth, double time)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    double unwrapped = azimuth;
+    if (!orientations.empty())
+    {
+        double d = azimuth - lastRawAzimuth;
+        d = atan2(sin(d), cos(d));
+        unwrapped = orientations.back().c + d;
+    }
+    lastRawAzimuth = azimuth;
+
+    push(orientations, {time, roll, pitch, unwrapped});
+    evaluate();
+}
+
+/** \brief Adds a new location to the sliding window
+*
+* \param [in]   lat     Latitude in degrees
+* \param [in]   lng     Longitude in degrees
+* \param [in]   alt     Altitude in meters
+* \param [in]   time    The exact time instant in which the location is received
+*
+* The location is kept in meters with respect to the first received location, using a local
+* equirectangular approximation which is accurate enough for the small distances involved
+*/
+void StationarityDetector::addLocation(double lat, double lng, double alt, double time)
+{
+    static const double R = 6378137.0, D2R = 3.14159265358979 / 180.0;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (locations.empty())
+    {
+        locRefLat = lat;
+        locRefLng = lng;
+    }
+
+    double north = (lat - locRefLat) * D2R * R;
+    double east = (lng - locRefLng) * D2R * R * cos(locRefLat * D2R);
+
+    push(locations, {time, east, north, alt});
+    evaluate();
+}
+
+/** \brief Provides the last decision
+*
+* \param [in]   now     The current time, on the clock of the sensor data
+*
+* \returns      true if the camera is considered to be in a fixed position, and both sensors have sent data
+*               within the timeout
+*/
+bool StationarityDetector::isStationary(double now) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!stationary || orientations.empty() || locations.empty())
+        return false;
+
+    return now - orientations.back().time <= timeout && now - locations.back().time <= timeout;
+}
+
+void StationarityDetector::push(std::deque<Sample> &samples, const Sample &sample)
+{
+    samples.push_back(sample);
+    while (samples.front().time < sample.time - window)
+        samples.pop_front();
+}
+
+bool StationarityDetector::windowFull(const std::deque<Sample> &samples, size_t minSamples) const
+{
+    return samples.size() >= minSamples && samples.back().time - samples.front().time >= 0.8 * window;
+}
+
+double StationarityDetector::stdDev(const std::deque<Sample> &samples, double Sample::*field)
+{
+    double sum = 0, sumSq = 0, ref = samples.front().*field;
+    for (auto & s : samples)
+    {
+        double v = s.*field - ref;
+        sum += v;
+        sumSq += v*v;
+    }
+    double n = samples.size(), mean = sum / n;
+    return sqrt(fmax(0.0, sumSq / n - mean*mean));
+}
+
+/** \brief Updates the decision with the samples inside the window; called with the mutex held
+*
+* The camera is considered moving as long as either window is not filled, e.g. right after the sensor data
+* is resumed
+*/
+void StationarityDetector::evaluate()
+{
+    if (!windowFull(orientations, 5) || !windowFull(locations, 3))
+    {
+        stationary = false;
+        return;
+    }
+
+    double factor = (stationary ? hysteresis : 1.0);
+    double angleLimit = maxAngleStd * factor, positionLimit = maxPositionStd * factor;
+
+    stationary = stdDev(orientations, &Sample::a) < angleLimit &&
+                 stdDev(orientations, &Sample::b) < angleLimit &&
+                 stdDev(orientations, &Sample::c) < angleLimit &&
+                 stdDev(locations, &Sample::a) < positionLimit &&
+                 stdDev(locations, &Sample::b) < positionLimit &&
+                 stdDev(locations, &Sample::c) < positionLimit;
+}
@@ -0,0 +1,189 @@
+
+#include "sweepWorker.h"
+
+using namespace SweeperGeometry;
+
+/** \brief Constructor; the worker thread is started with the first field of view
+*
+* \param [in]   sweeper_    The Sweeper which the worker maintains; not to be used directly afterwards
+*/
+SweepWorker::SweepWorker(Sweeper *sweeper_)
+{
+    sweeper = sweeper_;
+    published = std::make_shared<const SweepSnapshot>();
+}
+
+/** \brief Destructor; stops the worker thread, dropping the fields of view not merged yet
+*/
+SweepWorker::~SweepWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopWorker = true;
+    }
+    queueCond.notify_one();
+    // Releases the threads waiting in flush()
+    idleCond.notify_all();
+    if (worker.joinable())
+        worker.join();
+}
+
+/** \brief Queues a field of view; returns at once
+*
+* \param [in]   fov     The field of view corners in the local frame
+* \param [in]   time    The time in which the field of view is seen, in seconds
+*/
+void SweepWorker::submit(const std::vector<Object> &fov, double time)
+{
+    if (fov.empty())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        pending.push_back(fov);
+        pendingTimes.push_back(time);
+        if (!worker.joinable())
+            worker = std::thread(&SweepWorker::workLoop, this);
+    }
+    queueCond.notify_one();
+}
+
+/** \brief Provides the latest published sweeped area; never waits for a merge in progress
+*/
+std::shared_ptr<const SweepSnapshot> SweepWorker::snapshot() const
+{
+    return std::atomic_load(&published);
+}
+
+/** \brief Waits until all the queued fields of view are merged, and publishes their outline if the outline
+* interval skipped it
+*/
+void SweepWorker::flush()
+{
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        idleCond.wait(lock, [this] { return (pending.empty() && !busy) || stopWorker; });
+        if (stopWorker)
+            return;
+    }
+    publish(std::atomic_load(&published)->time, true);
+}
+
+/** \brief Sets how often the outline is traced again
+*
+* \param [in]   interval    The minimum time between two traced outlines, in seconds of the fields of view
+*                           time; 1 s by default. The outline is traced once per batch if 0
+*/
+void SweepWorker::setOutlineInterval(double interval)
+{
+    std::lock_guard<std::mutex> lock(sweeperMutex);
+    outlineInterval = interval;
+}
+
+/** \brief Sets the mission boundary of the Sweeper; see Sweeper::setMission()
+*
+* A snapshot with the new mission statistics is published at once; the outline is not traced again
+*/
+void SweepWorker::setMission(const std::vector<double> &xs, const std::vector<double> &ys)
+{
+    {
+        std::lock_guard<std::mutex> lock(sweeperMutex);
+        sweeper->setMission(xs, ys);
+    }
+    publish(std::atomic_load(&published)->time, false);
+}
+
+/** \brief Provides the outline of the mission area not sweeped yet; see Sweeper::gaps()
+*/
+void SweepWorker::gaps(std::vector<Object> &output)
+{
+    std::lock_guard<std::mutex> lock(sweeperMutex);
+    sweeper->gaps(output);
+}
+
+/** \brief Finds the unsweeped point of the mission nearest to a location; see Sweeper::nearestGap()
+*/
+bool SweepWorker::nearestGap(double x, double y, Location &gap)
+{
+    std::lock_guard<std::mutex> lock(sweeperMutex);
+    return sweeper->nearestGap(x, y, gap);
+}
+
+/** \brief Provides the visit count of the cell of a point; see CoverageGrid::visits()
+*/
+int SweepWorker::visits(double x, double y)
+{
+    std::lock_guard<std::mutex> lock(sweeperMutex);
+    return sweeper->getCoverage().visits(x, y);
+}
+
+/** \brief Provides the time since the cell of a point was last seen; see CoverageGrid::timeSinceSeen()
+*/
+double SweepWorker::timeSinceSeen(double x, double y, double now)
+{
+    std::lock_guard<std::mutex> lock(sweeperMutex);
+    return sweeper->getCoverage().timeSinceSeen(x, y, now);
+}
+
+/** \brief The worker thread loop; merges the queued fields of view batch by batch and publishes the results
+*/
+void SweepWorker::workLoop()
+{
+    std::vector<std::vector<Object>> batch;
+    std::vector<double> times;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            busy = false;
+            idleCond.notify_all();
+            queueCond.wait(lock, [this] { return !pending.empty() || stopWorker; });
+            if (stopWorker)
+                return;
+            batch.swap(pending);
+            times.swap(pendingTimes);
+            pending.clear();
+            pendingTimes.clear();
+            busy = true;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(sweeperMutex);
+            sweeper->update(batch, times);
+        }
+        publish(times.back(), false);
+    }
+}
+
+/** \brief Publishes a new snapshot with the current statistics
+*
+* \param [in]   time    The time of the last field of view merged
+* \param [in]   force   If true, the outline is traced whatever the outline interval
+*
+* The outline is traced again only if the interval since the last traced outline has elapsed (or force is
+* set) and the swept area has changed since; otherwise the previous outline is carried over. The snapshots
+* are built and swapped under the Sweeper mutex, so a publish from another thread (see setMission()) never
+* replaces a newer outline with an older one
+*/
+void SweepWorker::publish(double time, bool force)
+{
+    std::shared_ptr<SweepSnapshot> next = std::make_shared<SweepSnapshot>();
+    std::lock_guard<std::mutex> lock(sweeperMutex);
+    std::shared_ptr<const SweepSnapshot> last = std::atomic_load(&published);
+    bool due = force || lastOutlineTime < 0 || time - lastOutlineTime >= outlineInterval;
+    if (due && sweeper->isDirty())
+    {
+        sweeper->outline(next->outline);
+        next->version = last->version + 1;
+        lastOutlineTime = time;
+    }
+    else
+    {
+        next->outline = last->outline;
+        next->version = last->version;
+    }
+    sweeper->getCoverage().getStats(next->stats);
+    next->time = time;
+    std::atomic_store(&published, std::shared_ptr<const SweepSnapshot>(next));
+}
@@ -1,122 +1,407 @@
 
 
 #include <iostream>
+#include <algorithm>
 
 #include "sweeper.h"
 
 using namespace std;
 using namespace SweeperGeometry;
 
-/** \brief updates the sweeped polygon. merges a new field of view polygon with the sweeped area polygon.
+/** \brief updates the sweeped area with a new field of view and provides its outline
 *
 * \param [in]     fov_loc     The new field of view of the camera.
 *
-* \param [out]    output      The updated sweeped area. The result of the merge of new fov with last sweeped area.
+* \param [out]    output      The updated sweeped area outline; see outline().
 *
-* This function makes use of Boost library geometrical algorithms to merge polygons.
+* \param [in]     time        The time in which the field of view is seen, in seconds.
 */
 
-void Sweeper::update(std::vector<Object> & fov_loc, std::vector<Object> & output) {
+void Sweeper::update(std::vector<Object> & fov_loc, std::vector<Object> & output, double time) {
 
-    polygon new_poly;
+    update(fov_loc, time);
+    outline(output);
+}
+
+/** \brief updates the sweeped area with a new field of view.
+*
+* \param [in]     fov_loc     The new field of view of the camera.
+*
+* \param [in]     time        The time in which the field of view is seen, in seconds.
+*
+* The field of view is scan converted into the coverage grid, at a cost which depends on its footprint
+* only; the coverage statistics are updated on the way. In the POLYGON_UNION mode, it is also merged with
+* the sweeped area polygon using Boost library geometrical algorithms. The geometry is kept in meters, in
+* the Scanner's local frame (location x east, y north).
+*/
+
+void Sweeper::update(std::vector<Object> & fov_loc, double time) {
+
+    if (fov_loc.empty())
+        return;
+
+    fill(fov_loc, time);
+
+    if (mode == RASTER)
+        return;
+
+    multi_polygon new_poly;
+    new_poly.emplace_back();
+    toPolygon(fov_loc, new_poly.front());
+    merge(new_poly);
+}
+
+/** \brief updates the sweeped area with a batch of fields of view.
+*
+* \param [in]     fovs        The fields of view of the camera, in the order they are seen.
+*
+* \param [in]     times       The time in which each field of view is seen, in seconds.
+*
+* Like update() with each field of view, except that in the POLYGON_UNION mode the fields of view are first
+* merged together, then with the sweeped area at once: the cost of the union with the whole sweeped area,
+* which grows with the mission length, is paid once per batch instead of once per field of view.
+*/
+
+void Sweeper::update(std::vector<std::vector<Object>> & fovs, const std::vector<double> & times) {
+
+    multi_polygon batch, merged;
+
+    for (size_t k = 0; k < fovs.size() && k < times.size(); k++) {
+        if (fovs[k].empty())
+            continue;
+
+        fill(fovs[k], times[k]);
+
+        if (mode == RASTER)
+            continue;
+
+        polygon new_poly;
+        toPolygon(fovs[k], new_poly);
+        boost::geometry::union_(batch, new_poly, merged);
+        batch.swap(merged);
+        merged.clear();
+    }
+
+    if (!batch.empty())
+        merge(batch);
+}
+
+/** \brief Scan converts a field of view into the coverage grid.
+*
+* \param [in]     fov_loc     The field of view.
+*
+* \param [in]     time        The time in which the field of view is seen, in seconds.
+*/
+
+void Sweeper::fill(const std::vector<Object> & fov_loc, double time) {
+
+    xs.clear();
+    ys.clear();
+    for (auto & obj : fov_loc) {
+        xs.push_back(obj.location.x);
+        ys.push_back(obj.location.y);
+    }
+    grid.fill(xs, ys, time);
+}
+
+/** \brief Converts a field of view into a polygon.
+*
+* \param [in]     fov_loc     The field of view.
+*
+* \param [out]    poly        The polygon.
+*/
+
+void Sweeper::toPolygon(const std::vector<Object> & fov_loc, polygon & poly) {
 
     for (int i = 0; i < fov_loc.size(); i++) {
         Location ver = fov_loc.at(i).location;
-        boost::geometry::append(new_poly, boost::geometry::make<boost2dPoint>(ver.lng, ver.lat));
+        boost::geometry::append(poly, boost::geometry::make<boost2dPoint>(ver.x, ver.y));
     }
     Location last = fov_loc[fov_loc.size() - 1].location;
-    boost::geometry::append(new_poly, boost::geometry::make<boost2dPoint>(last.lng, last.lat));
-    boost::geometry::correct(new_poly);
-
-    if (isFirstPolygon) {
-        sweeped_area = new_poly;
-        isFirstPolygon = false;
-        output = fov_loc;
-        return;
-    }
+    boost::geometry::append(poly, boost::geometry::make<boost2dPoint>(last.x, last.y));
+    boost::geometry::correct(poly);
+}
 
-    std::vector<polygon> out_polygons;
-    boost::geometry::union_(sweeped_area, new_poly, out_polygons);
-    output = std::vector<Object>();
+/** \brief Merges polygons with the sweeped area polygon using Boost library geometrical algorithms.
+*
+* \param [in]     polygons    The polygons, e.g. fields of view.
+*/
 
-    for (int i = 0; i < out_polygons.size(); i++) {
+void Sweeper::merge(const multi_polygon & polygons) {
 
-        if (i != 0) continue;
+    multi_polygon out_polygons;
+    boost::geometry::union_(sweeped_area, polygons, out_polygons);
 
+    merged = true;
+    sweeped_area.clear();
+    for (auto & poly : out_polygons) {
+        simplify(poly);
+        if (poly.outer().size() >= 4)
+            sweeped_area.push_back(poly);
+    }
+}
 
-        polygon temp_poly = out_polygons.at(i);
-        refineLocations(temp_poly);
-        sweeped_area = temp_poly;
+/** \brief Provides the outline of the sweeped area.
+*
+* \param [out]    output      The outline vertices, of type Object::SWEPT. Object::id is the index of the swept
+*                             region (polygon) the vertex belongs to, Object::lastIdx the index of its ring in
+*                             the region: 0 for the outer ring, 1 and more for the holes.
+*
+* In the RASTER mode, the outlines are traced from the coverage grid only if it is changed since the last
+* call, and simplified. Disjoint swept regions are output as separate polygons.
+*/
 
-        for (auto it = boost::begin(boost::geometry::exterior_ring(temp_poly));
-             it != boost::end(boost::geometry::exterior_ring(temp_poly)); ++it) {
-            Location temp_loc;
-            temp_loc.lng = boost::geometry::get<0>(*it);
-            temp_loc.lat = boost::geometry::get<1>(*it);
+void Sweeper::outline(std::vector<Object> & output) {
 
-            output.push_back({.type = Object::SWEPT, .location = temp_loc});
+    if (mode == RASTER) {
+        if (grid.isDirty()) {
+            grid.outline(regions);
+            for (auto & poly : regions)
+                simplify(poly);
         }
     }
+    else {
+        regions.assign(sweeped_area.begin(), sweeped_area.end());
+        merged = false;
+    }
+
+    toObjects(regions, Object::SWEPT, output);
+}
+
+/** \brief Tells whether the sweeped area is changed since the last outline() call.
+*/
+
+bool Sweeper::isDirty() const {
+
+    return (mode == RASTER ? grid.isDirty() : merged);
+}
+
+/** \brief Provides the outline of the mission area not sweeped yet.
+*
+* \param [out]    output      The outline vertices, of type Object::GAP, numbered like in outline(); the holes
+*                             are the sweeped islands inside a gap. Empty if the mission is not set.
+*/
+
+void Sweeper::gaps(std::vector<Object> & output) {
+
+    grid.gaps(gapRegions);
+    for (auto & poly : gapRegions)
+        simplify(poly);
+
+    toObjects(gapRegions, Object::GAP, output);
 }
 
-double Sweeper::dist(double x1, double y1, double x2, double y2)
-{
-    return (x1 - x2)*(x1 - x2) +
-           (y1 - y2)*(y1 - y2);
+/** \brief Finds the unsweeped point of the mission nearest to a location.
+*
+* \param [in]     x           The east coordinate of the location in meters.
+*
+* \param [in]     y           The north coordinate of the location in meters.
+*
+* \param [out]    gap         The nearest unsweeped point, the center of a coverage grid cell.
+*
+* \returns        false if the mission is fully sweeped or not set.
+*/
+
+bool Sweeper::nearestGap(double x, double y, Location & gap) const {
+
+    return grid.nearestGap(x, y, gap.x, gap.y);
 }
 
+/** \brief Sets how the sweeped area outline is accumulated; the area sweeped so far is dropped.
+*
+* \param [in]     mode_       RASTER (the default) or POLYGON_UNION.
+*/
+
+void Sweeper::setMode(SweepMode mode_) {
+
+    mode = mode_;
+    grid.clear();
+    sweeped_area.clear();
+    regions.clear();
+}
+
+/** \brief Sets the cell size of the coverage grid; the area sweeped so far and the mission are dropped.
+*
+* \param [in]     cell        The cell side in meters; 1 m by default.
+*/
+
+void Sweeper::setCellSize(double cell) {
+
+    grid = CoverageGrid(cell);
+    grid.clear();
+    regions.clear();
+}
 
-/** \brief Removes close vertices of sweeped polygon for memory efficiency.
+/** \brief Sets the mission boundary for the coverage statistics.
 *
-* \param [in,out]     points     The polygon that needs to be refined.
+* \param [in]     xs          The east coordinates of the boundary vertices in meters.
 *
-* This function finds distance between polygon vertices and those which are closer than 0.00002 deg
-* in terms of lat & lon, will be removed.
+* \param [in]     ys          The north coordinates of the boundary vertices in meters.
 */
 
-void Sweeper::refineLocations(polygon &points){
+void Sweeper::setMission(const std::vector<double> & xs_, const std::vector<double> & ys_) {
 
-    polygon refined_points;
-    int size = boost::end(boost::geometry::exterior_ring(points)) - boost::begin(boost::geometry::exterior_ring(points));
-    vector<bool> idxs_to_remove(size);
+    grid.setMission(xs_, ys_);
+}
 
-    int i = -1;
-    for(auto it = boost::begin(boost::geometry::exterior_ring(points)); it != boost::end(boost::geometry::exterior_ring(points)) - 1; ++it)
-    {
-        i++;
-        if (idxs_to_remove.at(i)) continue;
+/** \brief Provides the coverage grid, for its statistics and revisit data.
+*/
 
-        double x1 = boost::geometry::get<0>(*it);
-        double y1 = boost::geometry::get<1>(*it);
+const CoverageGrid & Sweeper::getCoverage() const {
 
-        int j = i+1;
-        for(auto it1 = it+1; it1 != boost::end(boost::geometry::exterior_ring(points)) - 1; ++it1)
-        {
-            double x2 = boost::geometry::get<0>(*it1);
-            double y2 = boost::geometry::get<1>(*it1);
+    return grid;
+}
 
-            if (Sweeper::dist(x1, y1, x2, y2) < (double)0.00002 * (double)0.00002)
-            {
-                idxs_to_remove.at(j) = true;
-            }
+/** \brief Sets the tolerance of the outline simplification.
+*
+* \param [in]     tolerance   The maximum distance in meters of a removed vertex to the chord which replaces it
+*                             when it is removed; 1 m by default, 0 to keep all the vertices. The chords are
+*                             measured against the current vertices, not the exact outline, so the deviations of
+*                             successive removals may add up along the outline (see simplifyRing()).
+*/
+
+void Sweeper::setSimplifyTolerance(double tolerance) {
+
+    simplifyTolerance = std::max(tolerance, 0.0);
+}
+
+/** \brief Converts polygons into outline vertices.
+*
+* \param [in]     polygons    The polygons.
+*
+* \param [in]     type        The type of the vertices.
+*
+* \param [out]    output      The vertices of each ring, without the closing one; see outline().
+*/
 
-            j++;
+void Sweeper::toObjects(const std::vector<polygon> & polygons, Object::ObjectType type, std::vector<Object> & output) {
+
+    output.clear();
+
+    for (int p = 0; p < polygons.size(); p++) {
+        for (int r = 0; r <= (int) polygons[p].inners().size(); r++) {
+            const polygon::ring_type & ring = (r == 0 ? polygons[p].outer() : polygons[p].inners()[r - 1]);
+
+            for (int k = 0; k + 1 < (int) ring.size(); k++) {
+                Object obj;
+                obj.type = type;
+                obj.id = p;
+                obj.lastIdx = r;
+                obj.location.x = boost::geometry::get<0>(ring[k]);
+                obj.location.y = boost::geometry::get<1>(ring[k]);
+                output.push_back(obj);
+            }
         }
+    }
+}
+
+/** \brief Simplifies the rings of a polygon for memory efficiency.
+*
+* \param [in,out]     poly     The polygon that needs to be simplified.
+*
+* The outer ring and the holes are simplified on their own; holes which collapse are removed.
+*/
+
+void Sweeper::simplify(polygon &poly){
+
+    if (simplifyTolerance <= 0)
+        return;
+
+    simplifyRing(poly.outer());
+
+    auto & inners = poly.inners();
+    inners.erase(std::remove_if(inners.begin(), inners.end(),
+                                [this](polygon::ring_type & ring) { return !simplifyRing(ring); }),
+                 inners.end());
+}
+
 
+/** \brief Simplifies a closed ring with the Visvalingam-Whyatt algorithm.
+*
+* \param [in,out]     ring     The closed ring (its last vertex repeats the first one).
+*
+* \returns            false if the ring collapses to less than three vertices; it is then left unchanged
+*
+* The vertices are removed one at a time, always the least significant one first, as long as it is closer
+* than simplifyTolerance meters to the chord of its two current neighbours. The vertices are kept in a min
+* heap by that distance, and only the two neighbours of a removed vertex are updated (the stale heap entries
+* are skipped), so the cost is O(n log n) whatever the shape of the ring. As in the original algorithm, a
+* neighbour never becomes less significant than the vertex just removed, so the vertices go in order.
+*
+* The tolerance bounds each removal, not the distance to the exact ring: a chord may pass farther than the
+* tolerance from the vertices removed before it, typically along gently curved runs.
+*/
+
+bool Sweeper::simplifyRing(polygon::ring_type &ring){
+
+    size_t n = ring.size();
+    if (n < 5)
+        return n >= 4;
+    n--;
+
+    auto x = [&ring](size_t k) { return boost::geometry::get<0>(ring[k]); };
+    auto y = [&ring](size_t k) { return boost::geometry::get<1>(ring[k]); };
+
+    prev.resize(n);
+    next.resize(n);
+    cost.resize(n);
+    for (size_t k = 0; k < n; k++) {
+        prev[k] = (k + n - 1) % n;
+        next[k] = (k + 1) % n;
+    }
+
+    auto distance = [&](size_t k) {
+        size_t a = prev[k], b = next[k];
+        double dx = x(b) - x(a), dy = y(b) - y(a), len2 = dx * dx + dy * dy;
+        double ex = x(k) - x(a), ey = y(k) - y(a);
+        return (len2 > 0 ? fabs(ex * dy - ey * dx) / sqrt(len2) : sqrt(ex * ex + ey * ey));
+    };
+
+    typedef std::pair<double, size_t> Entry;
+    heap.clear();
+    for (size_t k = 0; k < n; k++) {
+        cost[k] = distance(k);
+        heap.push_back({cost[k], k});
     }
+    auto later = [](const Entry &a, const Entry &b) { return a.first > b.first; };
+    std::make_heap(heap.begin(), heap.end(), later);
 
-    i = -1;
-    for(auto it = boost::begin(boost::geometry::exterior_ring(points)); it != boost::end(boost::geometry::exterior_ring(points)); ++it)
-    {
-        i++;
-        if (idxs_to_remove.at(i))
+    keep.assign(n, 1);
+    size_t kept = n;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), later);
+        Entry top = heap.back();
+        heap.pop_back();
+        size_t k = top.second;
+        if (!keep[k] || top.first != cost[k])
             continue;
-        else{
-            double x = boost::geometry::get<0>(*it);
-            double y = boost::geometry::get<1>(*it);
-            boost::geometry::append( refined_points, boost::geometry::make<boost2dPoint>(x, y) );
+        if (top.first >= simplifyTolerance)
+            break;
+        if (kept == 3) {
+            kept = 0;
+            break;
+        }
+
+        keep[k] = 0;
+        kept--;
+        size_t a = prev[k], b = next[k];
+        next[a] = b;
+        prev[b] = a;
+        for (size_t m : {a, b}) {
+            cost[m] = std::max(distance(m), top.first);
+            heap.push_back({cost[m], m});
+            std::push_heap(heap.begin(), heap.end(), later);
         }
     }
 
-    points = refined_points;
-}
\ No newline at end of file
+    if (kept < 3)
+        return false;
+
+    polygon::ring_type simplified;
+    for (size_t k = 0; k < n; k++)
+        if (keep[k])
+            simplified.push_back(ring[k]);
+    simplified.push_back(simplified.front());
+    ring.swap(simplified);
+    return true;
+}
@@ -0,0 +1,356 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#include <math.h>
+#include <algorithm>
+#include "terrainRaycaster.h"
+
+static const double EARTH_R = 6378137.0, D2R = 3.14159265358979 / 180.0;
+
+/** \brief Constructor; sets the grid resolution
+*
+* \param [in]   cell    The grid cell size in meters. A value close to the DEM post spacing is enough, since
+*                       the surface is interpolated bilinearly between the posts anyway
+*/
+TerrainRaycaster::TerrainRaycaster(double cell)
+{
+    cellSize = cell;
+}
+
+/** \brief Destructor; stops the builder thread
+*/
+TerrainRaycaster::~TerrainRaycaster()
+{
+    {
+        std::lock_guard<std::mutex> lock(buildMutex);
+        stopBuilder = true;
+    }
+    buildCond.notify_one();
+    if (builder.joinable())
+        builder.join();
+}
+
+/** \brief Provides the height grid which covers all the rays cast from a drone location
+*
+* \param [in]   elevation   The elevation service providing the DEM
+* \param [in]   lat         The drone latitude in degrees
+* \param [in]   lng         The drone longitude in degrees
+* \param [in]   range       The maximum length of the rays in meters
+*
+* \returns      The grid; null if the DEM is not available around the drone, or if the grid covering the
+*               rays is not built yet, in which case no ray can be cast
+*
+* If the circle of the rays is not inside the current grid anymore, a new grid centered on the drone is
+* requested from the builder thread and the function returns at once. A newer request replaces an older one
+* which is not handled yet. The grid is made large enough (at least 1.5 times the range on each side) so
+* that it is not resampled on each update while the drone flies
+*/
+std::shared_ptr<const TerrainRaycaster::Grid> TerrainRaycaster::update(ElevationService &elevation, double lat, double lng, double range)
+{
+    std::shared_ptr<const Grid> grid = std::atomic_load(&current);
+    if (grid && grid->covers(lat, lng, range))
+        return (grid->valid ? grid : nullptr);
+
+    {
+        std::lock_guard<std::mutex> lock(buildMutex);
+        buildElevation = &elevation;
+        buildLat = lat;
+        buildLng = lng;
+        buildRange = range;
+        buildPending = true;
+        if (!builder.joinable())
+            builder = std::thread(&TerrainRaycaster::buildLoop, this);
+    }
+    buildCond.notify_one();
+    return nullptr;
+}
+
+/** \brief The builder thread loop; builds the requested grids and publishes them
+*/
+void TerrainRaycaster::buildLoop()
+{
+    while (true)
+    {
+        ElevationService *elevation;
+        double lat, lng, range;
+        {
+            std::unique_lock<std::mutex> lock(buildMutex);
+            buildCond.wait(lock, [this] { return buildPending || stopBuilder; });
+            if (stopBuilder)
+                return;
+            elevation = buildElevation;
+            lat = buildLat;
+            lng = buildLng;
+            range = buildRange;
+            buildPending = false;
+        }
+
+        // The grid published by an earlier request may already cover this one
+        std::shared_ptr<const Grid> grid = std::atomic_load(&current);
+        if (grid && grid->covers(lat, lng, range))
+            continue;
+
+        std::atomic_store(&current, build(*elevation, lat, lng, range));
+    }
+}
+
+/** \brief Samples a new height grid and builds its maximum heights pyramid
+*
+* \param [in]   elevation   The elevation service providing the DEM
+* \param [in]   lat         The grid center latitude in degrees
+* \param [in]   lng         The grid center longitude in degrees
+* \param [in]   range       The maximum length of the rays in meters
+*
+* \returns      The grid; not valid if the DEM is not available around the center
+*/
+std::shared_ptr<const TerrainRaycaster::Grid> TerrainRaycaster::build(ElevationService &elevation, double lat, double lng, double range) const
+{
+    std::shared_ptr<Grid> grid = std::make_shared<Grid>();
+    Grid &g = *grid;
+
+    g.cellSize = cellSize;
+    g.range = range;
+    g.size = 2;
+    while (g.size * cellSize / 2 < 1.5 * range + cellSize)
+        g.size *= 2;
+    g.half = g.size * cellSize / 2;
+    g.centerLat = lat;
+    g.centerLng = lng;
+
+    int size = g.size, nodes = size + 1;
+    double degPerMeter = 1 / (EARTH_R * D2R);
+    double cosLat = std::max(cos(lat * D2R), 0.01);
+    std::vector<double> lats(nodes * nodes), lngs(nodes * nodes), elevs(nodes * nodes);
+    for (int i = 0; i < nodes; i++)
+        for (int j = 0; j < nodes; j++)
+        {
+            lats[i * nodes + j] = lat + (-g.half + i * cellSize) * degPerMeter;
+            lngs[i * nodes + j] = lng + (-g.half + j * cellSize) * degPerMeter / cosLat;
+        }
+    elevation.heights(lats.data(), lngs.data(), elevs.data(), elevs.size());
+
+    std::vector<float> &heights = g.heights;
+    heights.resize(elevs.size());
+    for (size_t k = 0; k < elevs.size(); k++)
+    {
+        if (elevs[k] == ElevationService::NO_DATA)
+        {
+            heights.clear();
+            return grid;
+        }
+        heights[k] = (float) elevs[k];
+    }
+
+    // The bilinear surface of a cell is bounded by its four posts
+    g.cellMin.resize(size * size);
+    g.maxLevels.assign(1, std::vector<float>(size * size));
+    for (int i = 0; i < size; i++)
+        for (int j = 0; j < size; j++)
+        {
+            float h00 = heights[i * nodes + j], h01 = heights[i * nodes + j + 1];
+            float h10 = heights[(i + 1) * nodes + j], h11 = heights[(i + 1) * nodes + j + 1];
+            g.cellMin[i * size + j] = std::min(std::min(h00, h01), std::min(h10, h11));
+            g.maxLevels[0][i * size + j] = std::max(std::max(h00, h01), std::max(h10, h11));
+        }
+
+    for (int w = size / 2; w >= 1; w /= 2)
+    {
+        const std::vector<float> &finer = g.maxLevels.back();
+        std::vector<float> level(w * w);
+        for (int i = 0; i < w; i++)
+            for (int j = 0; j < w; j++)
+                level[i * w + j] = std::max(std::max(finer[2*i * 2*w + 2*j], finer[2*i * 2*w + 2*j + 1]),
+                                            std::max(finer[(2*i + 1) * 2*w + 2*j], finer[(2*i + 1) * 2*w + 2*j + 1]));
+        g.maxLevels.push_back(level);
+    }
+
+    g.valid = true;
+    return grid;
+}
+
+/** \brief Checks whether all the rays cast from a drone location stay inside the grid
+*
+* \param [in]   lat     The drone latitude in degrees
+* \param [in]   lng     The drone longitude in degrees
+* \param [in]   range_  The maximum length of the rays in meters
+*/
+bool TerrainRaycaster::Grid::covers(double lat, double lng, double range_) const
+{
+    if (range_ != range)
+        return false;
+
+    double north, east;
+    toLocal(lat, lng, north, east);
+    return fabs(north) + range <= half && fabs(east) + range <= half;
+}
+
+/** \brief Converts a location into the grid frame
+*
+* \param [in]   lat     Latitude in degrees
+* \param [in]   lng     Longitude in degrees
+* \param [out]  north   The north offset from the grid center in meters
+* \param [out]  east    The east offset from the grid center in meters
+*/
+void TerrainRaycaster::Grid::toLocal(double lat, double lng, double &north, double &east) const
+{
+    north = (lat - centerLat) * D2R * EARTH_R;
+    east = (lng - centerLng) * D2R * EARTH_R * cos(centerLat * D2R);
+}
+
+/** \brief Intersects a ray with the terrain
+*
+* \param [in]   origin  The ray origin in the grid frame: north and east offsets and the absolute elevation
+*                       (above sea level), all in meters
+* \param [in]   dir     The unit ray direction in the grid frame (north, east, up)
+* \param [in]   maxDist The maximum length of the ray in meters
+* \param [out]  t       The distance from the origin to the hit point in meters
+*
+* \returns      false if the ray does not hit the terrain within the maximum length, if the DEM is not
+*               available or if the origin is under the terrain
+*/
+bool TerrainRaycaster::Grid::cast(const Eigen::Vector3d &origin, const Eigen::Vector3d &dir, double maxDist, double &t) const
+{
+    if (!valid)
+        return false;
+
+    // Clip the ray to the grid
+    double tEnter = 0, tLeave = maxDist;
+    for (int k = 0; k < 2; k++)
+    {
+        if (fabs(dir[k]) < 1e-12)
+        {
+            if (origin[k] < -half || origin[k] > half)
+                return false;
+            continue;
+        }
+        double t1 = (-half - origin[k]) / dir[k], t2 = (half - origin[k]) / dir[k];
+        tEnter = std::max(tEnter, std::min(t1, t2));
+        tLeave = std::min(tLeave, std::max(t1, t2));
+    }
+    if (tEnter >= tLeave)
+        return false;
+
+    Eigen::Vector3d start = origin + tEnter * dir;
+    if (start[2] < surface(start[0], start[1]))
+        return false;
+
+    const double eps = 1e-6 * cellSize;
+    int top = (int) maxLevels.size() - 1;
+    double tCur = tEnter;
+    while (tCur < tLeave)
+    {
+        Eigen::Vector3d p = origin + tCur * dir;
+        int i = std::min(std::max((int) floor((p[0] + half) / cellSize), 0), size - 1);
+        int j = std::min(std::max((int) floor((p[1] + half) / cellSize), 0), size - 1);
+
+        // Skip the coarsest cell over which the ray passes entirely
+        bool skipped = false;
+        for (int l = top; l >= 0 && !skipped; l--)
+        {
+            int ci = i >> l, cj = j >> l;
+            double tExit = std::min(cellExit(origin, dir, l, ci, cj), tLeave);
+            double lowest = std::min(p[2], origin[2] + tExit * dir[2]);
+            if (lowest > maxLevels[l][ci * (size >> l) + cj])
+            {
+                tCur = tExit + eps;
+                skipped = true;
+            }
+        }
+        if (skipped)
+            continue;
+
+        double tExit = std::min(cellExit(origin, dir, 0, i, j), tLeave);
+        bool certain = origin[2] + tExit * dir[2] < cellMin[i * size + j];
+        if (refine(origin, dir, tCur, tExit, certain, t))
+            return true;
+        tCur = tExit + eps;
+    }
+
+    return false;
+}
+
+/** \brief Provides the bilinear terrain elevation at a point of the grid frame
+*/
+double TerrainRaycaster::Grid::surface(double north, double east) const
+{
+    int nodes = size + 1;
+    double x = (north + half) / cellSize, y = (east + half) / cellSize;
+    int i = std::min(std::max((int) floor(x), 0), size - 1);
+    int j = std::min(std::max((int) floor(y), 0), size - 1);
+    double fx = x - i, fy = y - j;
+
+    return (1 - fx) * ((1 - fy) * heights[i * nodes + j] + fy * heights[i * nodes + j + 1]) +
+           fx * ((1 - fy) * heights[(i + 1) * nodes + j] + fy * heights[(i + 1) * nodes + j + 1]);
+}
+
+/** \brief Calculates the distance along a ray at which it leaves a pyramid cell
+*
+* \param [in]   origin  The ray origin
+* \param [in]   dir     The ray direction
+* \param [in]   level   The pyramid level
+* \param [in]   ci      The cell index along the north axis, at the given level
+* \param [in]   cj      The cell index along the east axis, at the given level
+*/
+double TerrainRaycaster::Grid::cellExit(const Eigen::Vector3d &origin, const Eigen::Vector3d &dir, int level, int ci, int cj) const
+{
+    double span = cellSize * (1 << level);
+    double lower[2] = {-half + ci * span, -half + cj * span};
+    double tExit = INFINITY;
+
+    for (int k = 0; k < 2; k++)
+    {
+        if (dir[k] > 1e-12)
+            tExit = std::min(tExit, (lower[k] + span - origin[k]) / dir[k]);
+        else if (dir[k] < -1e-12)
+            tExit = std::min(tExit, (lower[k] - origin[k]) / dir[k]);
+    }
+
+    return tExit;
+}
+
+/** \brief Looks for the first crossing of a ray segment with the bilinear surface of a finest cell
+*
+* \param [in]   origin  The ray origin
+* \param [in]   dir     The ray direction
+* \param [in]   t0      The distance at which the ray enters the cell
+* \param [in]   t1      The distance at which the ray leaves the cell
+* \param [in]   certain true if the segment is known to end under the surface
+* \param [out]  t       The distance of the crossing
+*
+* The height of the ray above a bilinear surface is quadratic along the segment, so it may cross the
+* surface twice; the segment is sampled at a few points to find the first crossing, which is then
+* refined by bisection
+*/
+bool TerrainRaycaster::Grid::refine(const Eigen::Vector3d &origin, const Eigen::Vector3d &dir, double t0, double t1, bool certain, double &t) const
+{
+    auto above = [&](double s) {
+        Eigen::Vector3d p = origin + s * dir;
+        return p[2] - surface(p[0], p[1]);
+    };
+
+    const int steps = (certain ? 1 : 4);
+    double a = t0;
+    for (int k = 1; k <= steps; k++)
+    {
+        double b = t0 + (t1 - t0) * k / steps;
+        if (above(b) > 0)
+        {
+            a = b;
+            continue;
+        }
+
+        for (int n = 0; n < 20; n++)
+        {
+            double m = (a + b) / 2;
+            if (above(m) > 0)
+                a = m;
+            else
+                b = m;
+        }
+        t = (a + b) / 2;
+        return true;
+    }
+
+    return false;
+}
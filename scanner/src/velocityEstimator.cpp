@@ -0,0 +1,83 @@
+//
+// Created by a on 6/7/2021.
+//
+
+#include <algorithm>
+#include "velocityEstimator.h"
+
+/** \brief Estimates the displacement of each object since the previous image
+*
+* \param [in]   gray        The current gray image
+* \param [in]   objects     The objects detected in the current image, each with its bounding box
+* \param [out]  shifts      The displacement (pixels) of each object from the previous image to the current one
+* \param [out]  valid       For each object, true if enough features are tracked to trust its displacement
+*
+* \returns      true if a previous image exists and so the displacements are estimated
+*
+* The current image is kept as the previous image for the next call
+*/
+bool VelocityEstimator::estimate(const cv::Mat &gray, const std::vector<Object> &objects, std::vector<cv::Point2f> &shifts, std::vector<bool> &valid)
+{
+    shifts.assign(objects.size(), cv::Point2f(0, 0));
+    valid.assign(objects.size(), false);
+
+    if (prevGray.empty() || prevGray.size() != gray.size())
+    {
+        gray.copyTo(prevGray);
+        return false;
+    }
+
+    std::vector<cv::Point2f> points;
+    std::vector<int> owners;
+    cv::Rect frame(0, 0, gray.cols, gray.rows);
+    for (int k = 0; k < objects.size(); k++)
+    {
+        cv::Rect box = objects[k].box & frame;
+        if (box.width < 8 || box.height < 8) continue;
+
+        std::vector<cv::Point2f> corners;
+        cv::goodFeaturesToTrack(gray(box), corners, maxCorners, 0.01, 3);
+        for (auto & corner : corners)
+        {
+            points.push_back(corner + cv::Point2f((float) box.x, (float) box.y));
+            owners.push_back(k);
+        }
+    }
+
+    if (!points.empty())
+    {
+        std::vector<cv::Point2f> prevPoints;
+        std::vector<uchar> status;
+        std::vector<float> err;
+        cv::calcOpticalFlowPyrLK(gray, prevGray, points, prevPoints, status, err, cv::Size(15, 15), 2);
+
+        std::vector<std::vector<float>> dx(objects.size()), dy(objects.size());
+        for (int i = 0; i < points.size(); i++)
+        {
+            if (!status[i]) continue;
+            dx[owners[i]].push_back(points[i].x - prevPoints[i].x);
+            dy[owners[i]].push_back(points[i].y - prevPoints[i].y);
+        }
+
+        // The median ignores the background features caught inside the box
+        for (int k = 0; k < objects.size(); k++)
+        {
+            if (dx[k].size() < minTracked) continue;
+            size_t m = dx[k].size() / 2;
+            std::nth_element(dx[k].begin(), dx[k].begin() + m, dx[k].end());
+            std::nth_element(dy[k].begin(), dy[k].begin() + m, dy[k].end());
+            shifts[k] = cv::Point2f(dx[k][m], dy[k][m]);
+            valid[k] = true;
+        }
+    }
+
+    gray.copyTo(prevGray);
+    return true;
+}
+
+/** \brief Drops the previous image, e.g. when the detection mode changes
+*/
+void VelocityEstimator::reset()
+{
+    prevGray.release();
+}
@@ -0,0 +1,180 @@
+//
+// Host-side test of the Frame ingestion: the YUV_420_888 planes are laid out as the Android cameras provide
+// them (compact, interleaved, planar, with row padding or with a pixel stride), over synthetic buffers, and
+// the luma and BGR planes of the frame are compared with the conversion of the same samples in I420
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <opencv2/imgproc.hpp>
+#include "frame.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { if (!(cond)) { printf("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+static const int W = 64, H = 48;
+
+/** \brief Compares the pixels of two images of the same type, whatever their row strides
+*/
+static bool same(const cv::Mat &a, const cv::Mat &b)
+{
+    if (a.rows != b.rows || a.cols != b.cols || a.type() != b.type())
+        return false;
+    for (int r = 0; r < a.rows; r++)
+        if (memcmp(a.ptr(r), b.ptr(r), a.cols * a.elemSize()))
+            return false;
+    return true;
+}
+
+/**
+  * \struct Planes
+  * \brief The YUV planes of the reference image, copied into a buffer with a given layout
+ */
+struct Planes
+{
+    std::vector<uint8_t> buffer;
+    const uint8_t *y = nullptr, *u = nullptr, *v = nullptr;
+    int yRowStride = 0, uvRowStride = 0, uvPixelStride = 0;
+};
+
+/** \brief Lays the reference I420 samples out in one buffer
+*
+* \param [in]   ref             The reference image, in the I420 layout
+* \param [in]   yPad            The padding in bytes at the end of each luma row
+* \param [in]   uvPad           The padding in bytes at the end of each chroma row
+* \param [in]   uvPixelStride   1 for planar chroma, 2 for interleaved chroma; more for strided samples
+* \param [in]   vFirst          If interleaved, true for the V samples first (NV21), false for U first (NV12)
+*
+* \returns      The planes; the chroma rows of the interleaved planes end at the last sample of the later plane,
+*               as in an Android Image
+*/
+static Planes layOut(const cv::Mat &ref, int yPad, int uvPad, int uvPixelStride, bool vFirst)
+{
+    Planes p;
+    int cw = W / 2, ch = H / 2;
+    p.yRowStride = W + yPad;
+    p.uvPixelStride = uvPixelStride;
+    bool interleaved = (uvPixelStride == 2);
+    p.uvRowStride = (interleaved ? W : (cw - 1) * uvPixelStride + 1) + uvPad;
+
+    size_t ySize = (size_t) p.yRowStride * H, uvSize = (size_t) p.uvRowStride * ch;
+    p.buffer.assign(ySize + (interleaved ? uvSize : 2 * uvSize), 0xEE);
+
+    uint8_t *y = p.buffer.data(), *chroma = y + ySize;
+    uint8_t *u = (interleaved ? chroma + vFirst : chroma), *v = (interleaved ? chroma + !vFirst : chroma + uvSize);
+    for (int r = 0; r < H; r++)
+        memcpy(y + (size_t) r * p.yRowStride, ref.ptr(r), W);
+
+    const uint8_t *refU = ref.ptr(H), *refV = refU + (size_t) cw * ch;
+    for (int r = 0; r < ch; r++)
+        for (int c = 0; c < cw; c++)
+        {
+            u[(size_t) r * p.uvRowStride + c * uvPixelStride] = refU[r * cw + c];
+            v[(size_t) r * p.uvRowStride + c * uvPixelStride] = refV[r * cw + c];
+        }
+
+    p.y = y;
+    p.u = u;
+    p.v = v;
+    return p;
+}
+
+/** \brief Checks a frame over a layout of the reference samples, before and after it is detached
+*/
+static void checkLayout(const char *name, const cv::Mat &ref, const cv::Mat &refBgr, Planes p, bool zeroCopyGray)
+{
+    printf("%s\n", name);
+    Frame frame = Frame::fromYuv420(W, H, p.y, p.yRowStride, p.u, p.v, p.uvRowStride, p.uvPixelStride);
+    CHECK(!frame.empty());
+    CHECK(frame.borrowed());
+    CHECK(frame.format() == FRAME_YUV420);
+    CHECK(frame.size() == cv::Size(W, H));
+
+    const cv::Mat &gray = frame.gray();
+    CHECK(same(gray, ref.rowRange(0, H)));
+    if (zeroCopyGray)
+        CHECK(gray.data == p.y);
+    CHECK(same(frame.bgr(), refBgr));
+
+    // A detached copy keeps its planes once the source buffer is gone
+    Frame kept = frame;
+    Frame fresh = Frame::fromYuv420(W, H, p.y, p.yRowStride, p.u, p.v, p.uvRowStride, p.uvPixelStride);
+    kept.detach();
+    fresh.detach();
+    std::fill(p.buffer.begin(), p.buffer.end(), 0);
+    CHECK(!kept.borrowed());
+    CHECK(!fresh.borrowed());
+    CHECK(same(kept.gray(), ref.rowRange(0, H)));
+    CHECK(same(fresh.gray(), ref.rowRange(0, H)));
+    CHECK(same(fresh.bgr(), refBgr));
+}
+
+int main()
+{
+    // Different U and V samples, so that a swapped or misplaced chroma plane shows in the BGR image
+    cv::Mat ref(H * 3 / 2, W, CV_8UC1);
+    for (int r = 0; r < H; r++)
+        for (int c = 0; c < W; c++)
+            ref.at<uint8_t>(r, c) = (uint8_t) (16 + (r * 7 + c * 3) % 220);
+    uint8_t *refU = ref.ptr(H), *refV = refU + (W / 2) * (H / 2);
+    for (int k = 0; k < (W / 2) * (H / 2); k++)
+    {
+        refU[k] = (uint8_t) (64 + (k * 5) % 128);
+        refV[k] = (uint8_t) (192 - (k * 3) % 128);
+    }
+
+    cv::Mat refBgr;
+    cv::cvtColor(ref, refBgr, cv::COLOR_YUV2BGR_I420);
+
+    checkLayout("compact I420", ref, refBgr, layOut(ref, 0, 0, 1, false), true);
+    checkLayout("compact NV21", ref, refBgr, layOut(ref, 0, 0, 2, true), true);
+    checkLayout("compact NV12", ref, refBgr, layOut(ref, 0, 0, 2, false), true);
+    checkLayout("padded NV21", ref, refBgr, layOut(ref, 32, 32, 2, true), true);
+    checkLayout("padded planar", ref, refBgr, layOut(ref, 16, 8, 1, false), true);
+    checkLayout("strided chroma", ref, refBgr, layOut(ref, 0, 4, 3, false), true);
+
+    // An NV21 preview buffer
+    Planes nv21 = layOut(ref, 0, 0, 2, true);
+    Frame preview = Frame::fromNv21(nv21.buffer.data(), W, H);
+    CHECK(same(preview.gray(), ref.rowRange(0, H)));
+    CHECK(same(preview.bgr(), refBgr));
+
+    // Invalid geometries
+    CHECK(Frame::fromYuv420(W - 1, H, nv21.y, W, nv21.u, nv21.v, W, 2).empty());
+    CHECK(Frame::fromYuv420(W, H, nv21.y, W - 2, nv21.u, nv21.v, W, 2).empty());
+    CHECK(Frame::fromYuv420(W, H, nv21.y, W, nullptr, nv21.v, W, 2).empty());
+    CHECK(Frame::fromNv21(nullptr, W, H).empty());
+
+    // Frames over cv::Mat images; a Mat over an external buffer is borrowed
+    cv::Mat bgr = refBgr.clone(), rgba, gray;
+    cv::cvtColor(bgr, rgba, cv::COLOR_BGR2RGBA);
+    cv::cvtColor(bgr, gray, cv::COLOR_BGR2GRAY);
+
+    Frame bgrFrame(bgr, FRAME_BGR);
+    CHECK(!bgrFrame.borrowed());
+    CHECK(bgrFrame.bgr().data == bgr.data);
+    CHECK(same(bgrFrame.gray(), gray));
+
+    std::vector<uint8_t> external(rgba.total() * rgba.elemSize());
+    memcpy(external.data(), rgba.data, external.size());
+    Frame rgbaFrame(cv::Mat(H, W, CV_8UC4, external.data()), FRAME_RGBA);
+    CHECK(rgbaFrame.borrowed());
+    cv::Mat rgbaGray;
+    cv::cvtColor(rgba, rgbaGray, cv::COLOR_RGBA2GRAY);
+    CHECK(same(rgbaFrame.gray(), rgbaGray));
+    rgbaFrame.detach();
+    std::fill(external.begin(), external.end(), 0);
+    cv::Mat rgbaBgr;
+    cv::cvtColor(rgba, rgbaBgr, cv::COLOR_RGBA2BGR);
+    CHECK(same(rgbaFrame.bgr(), rgbaBgr));
+
+    Frame grayFrame(gray, FRAME_GRAY);
+    CHECK(grayFrame.gray().data == gray.data);
+    CHECK(Frame(bgr, FRAME_GRAY).empty());
+
+    printf(failures ? "%d checks failed\n" : "all checks passed\n", failures);
+    return failures ? 1 : 0;
+}